@@ -0,0 +1,275 @@
+#include "arduino/Arduino.h"
+#include "arduino/SPI.h"
+#include "board.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+using namespace std;
+
+SerialClass Serial;
+SPIClass SPI;
+
+static deque<uint8_t> _rxBuffer;
+static double _txFreeUs = 0;
+static uint32_t _spiClock = 4000000;
+
+/**
+ * @brief Sleeps or busy-waits until time targetUs.
+ *
+ * Waits of more than 100 us go through nanosleep; the remainder is spun on the clock so that short delays keep the
+ * resolution of delayMicroseconds() on the Due.
+ *
+ * @param targetUs The board time to wait for, in microseconds.
+ */
+static void waitUntil(double targetUs) {
+	double remaining = targetUs - board_utils::nowUs();
+	if (remaining > 100) {
+		struct timespec ts;
+		double sleepUs = remaining - 50;
+		ts.tv_sec = (time_t) (sleepUs / 1e6);
+		ts.tv_nsec = (long) ((sleepUs - ts.tv_sec * 1e6) * 1000);
+		nanosleep(&ts, 0);
+	}
+	while (board_utils::nowUs() < targetUs) {}
+}
+
+void pinMode(uint32_t pin, uint32_t mode) {
+	(void) pin;
+	(void) mode;
+}
+
+void digitalWrite(uint32_t pin, uint32_t value) {
+	board_utils::pinWritten(pin, value);
+}
+
+int digitalRead(uint32_t pin) {
+	return board_utils::pinRead(pin);
+}
+
+void delay(uint32_t ms) {
+	waitUntil(board_utils::nowUs() + 1000.0 * ms);
+}
+
+void delayMicroseconds(uint32_t us) {
+	waitUntil(board_utils::nowUs() + us);
+}
+
+uint32_t micros(void) {
+	return (uint32_t) (uint64_t) board_utils::nowUs();
+}
+
+uint32_t millis(void) {
+	return (uint32_t) (uint64_t) (board_utils::nowUs() / 1000);
+}
+
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode) {
+	(void) pin;
+	(void) callback;
+	(void) mode;
+}
+
+void detachInterrupt(uint32_t pin) {
+	(void) pin;
+}
+
+void noInterrupts(void) {}
+
+void interrupts(void) {}
+
+/**
+ * @brief Moves the bytes waiting on the pseudo-terminal into the receive buffer without blocking.
+ */
+static void pollReceive(void) {
+	uint8_t chunk[256];
+	ssize_t n;
+	while ((n = ::read(board_utils::serialFd, chunk, sizeof(chunk))) > 0) {
+		_rxBuffer.insert(_rxBuffer.end(), chunk, chunk + n);
+	}
+}
+
+void SerialClass::begin(unsigned long baud) {
+	(void) baud;
+}
+
+int SerialClass::available(void) {
+	pollReceive();
+	return (int) _rxBuffer.size();
+}
+
+int SerialClass::read(void) {
+	if (_rxBuffer.empty()) {pollReceive();}
+	if (_rxBuffer.empty()) {return -1;}
+	uint8_t c = _rxBuffer.front();
+	_rxBuffer.pop_front();
+	return c;
+}
+
+int SerialClass::peek(void) {
+	if (_rxBuffer.empty()) {pollReceive();}
+	return _rxBuffer.empty() ? -1 : _rxBuffer.front();
+}
+
+/**
+ * @brief Waits until the paced transmitter is idle.
+ */
+void SerialClass::flush(void) {
+	if (board_utils::options.baud) {waitUntil(_txFreeUs);}
+}
+
+int SerialClass::availableForWrite(void) {
+	return 128;
+}
+
+/**
+ * @brief Writes bytes to the pseudo-terminal.
+ *
+ * Blocks while the terminal buffer is full, as the Due does when its transmit buffer is full. With a baud rate set,
+ * the bytes are also paced at 10 bits per byte, so that streams run at the speed of the real UART link.
+ *
+ * @param data The bytes to write.
+ * @param size The number of bytes.
+ * @return The number of bytes written.
+ */
+size_t SerialClass::write(const uint8_t* data, size_t size) {
+	if (board_utils::options.baud) {
+		double now = board_utils::nowUs();
+		if (_txFreeUs < now) {_txFreeUs = now;}
+		_txFreeUs += size * 10e6 / board_utils::options.baud;
+		// The Due's transmit buffer holds 128 bytes; wait while the backlog is larger.
+		waitUntil(_txFreeUs - 128 * 10e6 / board_utils::options.baud);
+	}
+
+	size_t written = 0;
+	while (written < size) {
+		ssize_t n = ::write(board_utils::serialFd, data + written, size - written);
+		if (n > 0) {
+			written += n;
+		}
+		else if (n < 0 && errno == EAGAIN) {
+			struct pollfd pfd = {board_utils::serialFd, POLLOUT, 0};
+			poll(&pfd, 1, 100);
+		}
+		else if (n < 0 && errno != EINTR) {
+			break;
+		}
+	}
+	return size;
+}
+
+size_t SerialClass::write(uint8_t value) {
+	return write(&value, 1);
+}
+
+size_t SerialClass::write(const char* text) {
+	return write((const uint8_t*) text, strlen(text));
+}
+
+/**
+ * @brief Prints an unsigned number in the given base, as the Arduino Print class does.
+ *
+ * @param value The number.
+ * @param base The base, 2 to 16.
+ * @return The number of characters written.
+ */
+static size_t printNumber(unsigned long long value, int base) {
+	char digits[65];
+	char* p = digits + sizeof(digits);
+	if (base < 2 || base > 16) {base = 10;}
+	do {
+		*--p = "0123456789ABCDEF"[value % base];
+		value /= base;
+	} while (value);
+	return Serial.write((const uint8_t*) p, digits + sizeof(digits) - p);
+}
+
+size_t SerialClass::print(const char* text) {
+	return write(text);
+}
+
+size_t SerialClass::print(const String& text) {
+	return write(text.c_str());
+}
+
+size_t SerialClass::print(char value) {
+	return write((uint8_t) value);
+}
+
+size_t SerialClass::print(unsigned char value, int base) {
+	return printNumber(value, base);
+}
+
+size_t SerialClass::print(int value, int base) {
+	return print((long long) value, base);
+}
+
+size_t SerialClass::print(unsigned int value, int base) {
+	return printNumber(value, base);
+}
+
+size_t SerialClass::print(long value, int base) {
+	return print((long long) value, base);
+}
+
+size_t SerialClass::print(unsigned long value, int base) {
+	return printNumber(value, base);
+}
+
+/**
+ * @brief Prints a signed number. Negative numbers get a minus sign in base 10 and are printed as their 32-bit two's
+ * complement in other bases, matching the 32-bit long of the Due.
+ */
+size_t SerialClass::print(long long value, int base) {
+	if (base != 10) {return printNumber((uint32_t) value, base);}
+	if (value < 0) {return write('-') + printNumber(-(unsigned long long) value, 10);}
+	return printNumber(value, 10);
+}
+
+size_t SerialClass::print(unsigned long long value, int base) {
+	return printNumber(value, base);
+}
+
+/**
+ * @brief Prints a floating point number with a fixed number of decimals, as the Arduino Print class does.
+ */
+size_t SerialClass::print(double value, int digits) {
+	char text[64];
+	if (isnan(value)) {return write("nan");}
+	if (isinf(value)) {return write("inf");}
+	if (value > 4294967040.0 || value < -4294967040.0) {return write("ovf");}
+	int n = snprintf(text, sizeof(text), "%.*f", digits, value);
+	return write((const uint8_t*) text, n);
+}
+
+size_t SerialClass::println(void) {
+	return write("\r\n");
+}
+
+void SPIClass::begin(void) {}
+
+void SPIClass::end(void) {}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+	_spiClock = settings.clock;
+}
+
+void SPIClass::endTransaction(void) {}
+
+/**
+ * @brief Exchanges one byte with the selected chips of the simulated board.
+ *
+ * With SPI timing on, the call takes the 8 clock periods the byte needs on the bus at the transaction's clock rate.
+ *
+ * @param data The byte to send.
+ * @return The byte received.
+ */
+uint8_t SPIClass::transfer(uint8_t data) {
+	if (board_utils::options.spiTiming && _spiClock) {
+		waitUntil(board_utils::nowUs() + 8e6 / _spiClock);
+	}
+	return board_utils::spiTransfer(data);
+}
@@ -0,0 +1,76 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "WString.h"
+
+// Arduino core API used by the firmware, implemented on Linux by the emulator (see emulator/arduino.cpp). Pins, SPI
+// and the serial port are routed to the simulated board (see emulator/board.h).
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+typedef uint8_t byte;
+
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+uint32_t micros(void);
+uint32_t millis(void);
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode);
+void detachInterrupt(uint32_t pin);
+void noInterrupts(void);
+void interrupts(void);
+#define digitalPinToInterrupt(p) (p)
+
+///
+/// Serial port of the emulated Due, connected to the pseudo-terminal.
+///
+class SerialClass
+{
+public:
+	void begin(unsigned long baud);
+	int available(void);
+	int read(void);
+	int peek(void);
+	void flush(void);
+	int availableForWrite(void);
+	size_t write(uint8_t value);
+	size_t write(const uint8_t* data, size_t size);
+	size_t write(const char* text);
+
+	size_t print(const char* text);
+	size_t print(const String& text);
+	size_t print(char value);
+	size_t print(unsigned char value, int base = DEC);
+	size_t print(int value, int base = DEC);
+	size_t print(unsigned int value, int base = DEC);
+	size_t print(long value, int base = DEC);
+	size_t print(unsigned long value, int base = DEC);
+	size_t print(long long value, int base = DEC);
+	size_t print(unsigned long long value, int base = DEC);
+	size_t print(double value, int digits = 2);
+
+	size_t println(void);
+	template <typename T> size_t println(const T& value) { return print(value) + println(); }
+	template <typename T> size_t println(const T& value, int format) { return print(value, format) + println(); }
+
+	operator bool() { return true; }
+};
+
+extern SerialClass Serial;
+
+#endif // ARDUINO_H
@@ -0,0 +1,37 @@
+#ifndef SPI_H
+#define SPI_H
+#include <stdint.h>
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x02
+#define SPI_MODE1 0x00
+#define SPI_MODE2 0x03
+#define SPI_MODE3 0x01
+
+class SPISettings
+{
+public:
+	SPISettings(void) : clock(4000000) {}
+	SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : clock(clock) { (void) bitOrder; (void) dataMode; }
+	uint32_t clock;
+};
+
+///
+/// SPI bus of the emulated Due. Every byte is exchanged with the simulated chips whose chip
+/// select is low, and takes 8 clock periods of the current transaction when SPI timing is on.
+///
+class SPIClass
+{
+public:
+	void begin(void);
+	void end(void);
+	void beginTransaction(SPISettings settings);
+	void endTransaction(void);
+	uint8_t transfer(uint8_t data);
+};
+
+extern SPIClass SPI;
+
+#endif // SPI_H
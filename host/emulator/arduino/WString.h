@@ -0,0 +1,53 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+#include <stdlib.h>
+#include <string>
+
+///
+/// Subset of the Arduino String class used by the firmware, backed by std::string.
+///
+class String
+{
+public:
+	String(void) {}
+	String(const char* text) : s(text ? text : "") {}
+	String(const std::string& text) : s(text) {}
+	String(char c) : s(1, c) {}
+	String(int value) : s(std::to_string(value)) {}
+	String(long value) : s(std::to_string(value)) {}
+	String(unsigned long value) : s(std::to_string(value)) {}
+
+	String& operator+=(char c) { s += c; return *this; }
+	String& operator+=(const char* text) { s += text; return *this; }
+	String& operator+=(const String& other) { s += other.s; return *this; }
+	String operator+(const String& other) const { return String(s + other.s); }
+	bool operator==(const char* text) const { return s == text; }
+	bool operator!=(const char* text) const { return s != text; }
+	bool operator==(const String& other) const { return s == other.s; }
+	bool operator!=(const String& other) const { return s != other.s; }
+	char operator[](unsigned int i) const { return i < s.size() ? s[i] : 0; }
+
+	long toInt(void) const { return atol(s.c_str()); }
+	float toFloat(void) const { return (float) atof(s.c_str()); }
+	double toDouble(void) const { return atof(s.c_str()); }
+	const char* c_str(void) const { return s.c_str(); }
+	unsigned int length(void) const { return s.size(); }
+	char charAt(unsigned int i) const { return (*this)[i]; }
+	bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+	bool equals(const String& other) const { return s == other.s; }
+	int indexOf(char c) const { std::string::size_type p = s.find(c); return p == std::string::npos ? -1 : (int) p; }
+	String substring(unsigned int from) const { return String(from < s.size() ? s.substr(from) : std::string()); }
+	String substring(unsigned int from, unsigned int to) const {
+		return String(from < s.size() && to > from ? s.substr(from, to - from) : std::string());
+	}
+	void trim(void) {
+		std::string::size_type a = s.find_first_not_of(" \t\r\n");
+		std::string::size_type b = s.find_last_not_of(" \t\r\n");
+		s = (a == std::string::npos) ? std::string() : s.substr(a, b - a + 1);
+	}
+
+private:
+	std::string s;
+};
+
+#endif // WSTRING_H
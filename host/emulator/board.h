@@ -0,0 +1,39 @@
+#ifndef BOARD_H
+#define BOARD_H
+#include <stdint.h>
+using namespace std;
+
+/**
+ * @namespace board_utils
+ * @brief Namespace containing the simulated DAC-ADC board behind the emulated Arduino core.
+ *
+ * The Arduino core of the emulator (arduino.cpp) forwards pin writes, pin reads and SPI bytes here. The board wires the
+ * firmware's pins as on the real hardware: AD5791 SYNC on pins 11, 8, 5 and 2 (DAC 0 to 3), LDAC on pin 50, AD4115 CS
+ * on pin 32 and DOUT/RDY on pin 28. Analog input AINk of the ADC is connected to the output of DAC k % 4, plus a
+ * small amount of noise, so ramps read back what they write.
+ */
+namespace board_utils {
+
+	///
+	/// Emulator options, set from the command line before setup() runs.
+	///
+	struct Options {
+		double conversionUs;
+		double noiseVolts;
+		bool spiTiming;
+		uint32_t baud;
+	};
+
+	extern Options options;
+	///
+	/// Master side of the pseudo-terminal carrying the serial port.
+	///
+	extern int serialFd;
+
+	double nowUs(void);
+	void pinWritten(uint32_t pin, uint32_t value);
+	int pinRead(uint32_t pin);
+	uint8_t spiTransfer(uint8_t data);
+}
+
+#endif // BOARD_H
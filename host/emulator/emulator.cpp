@@ -0,0 +1,235 @@
+#include "arduino/Arduino.h"
+#include "board.h"
+#include "models.h"
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+using namespace std;
+
+void setup(void);
+void loop(void);
+
+namespace board_utils {
+
+Options options = {100, 50e-6, true, 0};
+int serialFd = -1;
+
+static const uint32_t kDacSyncPins[4] = {11, 8, 5, 2};
+static const uint32_t kLdacPin = 50;
+static const uint32_t kAdcSyncPin = 32;
+static const uint32_t kDrdyPin = 28;
+
+static AD5791_MODEL _dacs[4];
+static AD4115_MODEL _adc;
+static uint8_t _pinLevels[128];
+static uint32_t _noiseState = 12345;
+static const chrono::steady_clock::time_point _start = chrono::steady_clock::now();
+
+/**
+ * @brief Returns the board time.
+ *
+ * @return Microseconds since the emulator started.
+ */
+double nowUs(void) {
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - _start).count();
+}
+
+/**
+ * @brief Returns a uniformly distributed noise sample from a linear congruential generator.
+ *
+ * @return A value in [-options.noiseVolts, options.noiseVolts].
+ */
+static double noise(void) {
+	_noiseState = _noiseState * 1664525 + 1013904223;
+	return options.noiseVolts * ((double) (_noiseState >> 8) / 8388608.0 - 1);
+}
+
+/**
+ * @brief Returns the voltage at an AD4115 input: AINk carries the output of DAC k % 4, VINCOM is ground.
+ *
+ * @param pin The input number, 0 to 15, or 16 for VINCOM.
+ * @return The input voltage.
+ */
+static double inputVoltage(uint8_t pin) {
+	return (pin < 16) ? _dacs[pin % 4].voltage() : 0;
+}
+
+/**
+ * @brief Connects the chip models and sets the initial pin levels.
+ *
+ * All pins start high, so the chip selects are inactive until the firmware drives them.
+ */
+static void initialize(void) {
+	memset(_pinLevels, HIGH, sizeof(_pinLevels));
+	_adc.conversionUs = options.conversionUs;
+	_adc.input = [](uint8_t positive, uint8_t negative) {
+		return inputVoltage(positive) - inputVoltage(negative) + noise();
+	};
+}
+
+/**
+ * @brief Handles a digitalWrite() of the firmware.
+ *
+ * Level changes of the SYNC pins frame the AD5791 models, the falling edge of LDAC latches all four DAC outputs, and
+ * the CS pin frames the AD4115 model.
+ *
+ * @param pin The pin number.
+ * @param value The new level.
+ */
+void pinWritten(uint32_t pin, uint32_t value) {
+	if (pin >= sizeof(_pinLevels)) {return;}
+	uint8_t level = value ? HIGH : LOW;
+	uint8_t previous = _pinLevels[pin];
+	_pinLevels[pin] = level;
+	if (level == previous) {return;}
+
+	for (uint8_t d = 0; d < 4; d++) {
+		if (pin == kDacSyncPins[d]) {_dacs[d].select(level == LOW);}
+	}
+	if (pin == kLdacPin && level == LOW) {
+		for (uint8_t d = 0; d < 4; d++) {_dacs[d].ldac();}
+	}
+	if (pin == kAdcSyncPin) {_adc.select(level == LOW);}
+}
+
+/**
+ * @brief Handles a digitalRead() of the firmware.
+ *
+ * @param pin The pin number.
+ * @return DOUT/RDY of the AD4115 for the DRDY pin, otherwise the last level written.
+ */
+int pinRead(uint32_t pin) {
+	if (pin == kDrdyPin) {return _adc.ready(nowUs());}
+	return (pin < sizeof(_pinLevels)) ? _pinLevels[pin] : LOW;
+}
+
+/**
+ * @brief Exchanges one byte with the selected chips.
+ *
+ * While a DAC SYNC pin is low the byte goes to the selected DACs only; the firmware leaves the ADC CS low between
+ * accesses, and the real board keeps the ADC off the bus during DAC frames. Otherwise the byte goes to the ADC if its
+ * CS is low.
+ *
+ * @param data The byte on MOSI.
+ * @return The byte on MISO.
+ */
+uint8_t spiTransfer(uint8_t data) {
+	bool dacSelected = false;
+	uint8_t out = 0;
+	for (uint8_t d = 0; d < 4; d++) {
+		if (_pinLevels[kDacSyncPins[d]] == LOW) {
+			out |= _dacs[d].transfer(data);
+			dacSelected = true;
+		}
+	}
+	if (dacSelected) {return out;}
+	if (_pinLevels[kAdcSyncPin] == LOW) {return _adc.transfer(data, nowUs());}
+	return 0xFF;
+}
+
+/**
+ * @brief Opens a pseudo-terminal for the serial port.
+ *
+ * The slave side is put in raw mode and kept open, so that the master stays usable while no client is connected and
+ * the terminal settings survive clients closing the port.
+ *
+ * @param slavePath Set to the path of the slave device.
+ * @return 0 if successful, 1 otherwise.
+ */
+static uint8_t openTerminal(string& slavePath) {
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {return 1;}
+
+	const char* name = ptsname(master);
+	if (!name) {return 1;}
+	slavePath = name;
+
+	int slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0) {return 1;}
+	struct termios tio;
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+	serialFd = master;
+	return 0;
+}
+
+}
+
+/**
+ * @brief Prints the usage of the emulator.
+ */
+static void usage(void) {
+	fprintf(stderr,
+		"usage: od-emulator [options]\n"
+		"  -l, --link PATH         symlink to the serial pseudo-terminal\n"
+		"      --conversion-us US  AD4115 conversion time per channel (default 100)\n"
+		"      --noise V           peak noise added to the ADC inputs (default 50e-6)\n"
+		"      --baud RATE         pace serial output at RATE baud (default unlimited)\n"
+		"      --no-spi-timing     SPI transfers take no time\n"
+		"Runs the od-dacadc firmware against simulated AD5791 and AD4115 chips. AINk of the ADC\n"
+		"reads the output of DAC k %% 4.\n");
+}
+
+/**
+ * @brief Runs the firmware on the simulated board.
+ *
+ * Opens the serial pseudo-terminal, prints its path (and links it to --link), then runs setup() and loop() forever.
+ * When a loop() pass returns quickly and no input is buffered, the emulator waits up to 1 ms for serial input instead
+ * of spinning, so an idle board does not use a full core.
+ *
+ * @return 1 if the pseudo-terminal cannot be opened, otherwise does not return.
+ */
+int main(int argc, char** argv) {
+	string link;
+
+	for (int a = 1; a < argc; a++) {
+		string arg = argv[a];
+		bool more = a + 1 < argc;
+		if ((arg == "-l" || arg == "--link") && more) {link = argv[++a];}
+		else if (arg == "--conversion-us" && more) {board_utils::options.conversionUs = atof(argv[++a]);}
+		else if (arg == "--noise" && more) {board_utils::options.noiseVolts = atof(argv[++a]);}
+		else if (arg == "--baud" && more) {board_utils::options.baud = strtoul(argv[++a], 0, 10);}
+		else if (arg == "--no-spi-timing") {board_utils::options.spiTiming = false;}
+		else {
+			usage();
+			return (arg == "-h" || arg == "--help") ? 0 : 1;
+		}
+	}
+
+	string slavePath;
+	if (board_utils::openTerminal(slavePath) != 0) {
+		fprintf(stderr, "od-emulator: cannot open a pseudo-terminal: %s\n", strerror(errno));
+		return 1;
+	}
+	if (!link.empty()) {
+		unlink(link.c_str());
+		if (symlink(slavePath.c_str(), link.c_str()) != 0) {
+			fprintf(stderr, "od-emulator: cannot link %s: %s\n", link.c_str(), strerror(errno));
+			return 1;
+		}
+	}
+	printf("%s\n", slavePath.c_str());
+	fflush(stdout);
+
+	board_utils::initialize();
+	setup();
+	for (;;) {
+		double start = board_utils::nowUs();
+		loop();
+		if (board_utils::nowUs() - start < 20 && Serial.available() == 0) {
+			struct pollfd pfd = {board_utils::serialFd, POLLIN, 0};
+			poll(&pfd, 1, 1);
+		}
+	}
+}
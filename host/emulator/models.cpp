@@ -0,0 +1,295 @@
+#include "models.h"
+#include <stdint.h>
+using namespace std;
+
+/**
+ * @brief Changes the level of SYNC.
+ *
+ * A falling edge starts a new frame. On the rising edge a complete 24-bit frame is decoded: bit 23 selects a read, bits
+ * 22 to 20 the register (1 DAC, 2 control, 4 software control) and bits 19 to 0 the data. A read loads the register
+ * into the readback buffer, which is shifted out during the next frame.
+ *
+ * @param low True if SYNC goes low.
+ */
+void AD5791_MODEL::select(bool low) {
+	if (low) {
+		if (!selected) {
+			shift = 0;
+			bits = 0;
+		}
+		selected = true;
+		return;
+	}
+
+	if (selected && bits >= 24) {
+		uint32_t frame = shift & 0xFFFFFF;
+		uint8_t address = (frame >> 20) & 7;
+		uint32_t data = frame & 0xFFFFF;
+
+		if (frame & 0x800000) {
+			uint32_t content = (address == 1) ? dacRegister : (address == 2) ? control : 0;
+			readback = (frame & 0xF00000) | content;
+		}
+		else {
+			readback = 0;
+			if (address == 1) {dacRegister = data;}
+			else if (address == 2) {control = data;}
+			else if (address == 4 && (data & 1)) {ldac();}
+		}
+	}
+	selected = false;
+}
+
+/**
+ * @brief Exchanges one byte while SYNC is low.
+ *
+ * @param data The byte on SDIN.
+ * @return The byte on SDO: the readback buffer, MSB first.
+ */
+uint8_t AD5791_MODEL::transfer(uint8_t data) {
+	uint8_t out = (bits < 24) ? (uint8_t) (readback >> (16 - bits)) : 0;
+	shift = (shift << 8) | data;
+	bits += 8;
+	return out;
+}
+
+/**
+ * @brief Falling edge of LDAC: the DAC register is copied to the output.
+ */
+void AD5791_MODEL::ldac(void) {
+	latched = dacRegister;
+}
+
+/**
+ * @brief Returns the latched output code.
+ *
+ * @return The 20-bit two's complement code.
+ */
+uint32_t AD5791_MODEL::code(void) const {
+	return latched;
+}
+
+/**
+ * @brief Returns the output voltage.
+ *
+ * Uses the +-10 V span of the board: code 0x7FFFF is +10 V and 0x80000 is -10 V. The output stays at 0 V while OPGND
+ * or DACTRI (control bits 2 and 3, both set at power-on) is set.
+ *
+ * @return The output voltage.
+ */
+double AD5791_MODEL::voltage(void) const {
+	if (control & 0x0C) {return 0;}
+	if (latched >= 0x80000) {return -(double) (0x100000 - latched) * 10 / 524288;}
+	return (double) latched * 10 / 524287;
+}
+
+/**
+ * @brief Returns the size of an AD4115 register in bytes.
+ *
+ * @param address The register address.
+ * @return The register size.
+ */
+uint8_t AD4115_MODEL::registerSize(uint8_t address) {
+	if (address == 0x00) {return 1;}
+	if (address == 0x03 || address == 0x04 || address >= 0x30) {return 3;}
+	return 2;
+}
+
+/**
+ * @brief Restores the register values after a serial interface reset.
+ *
+ * After a reset the ADC converts channel 0 (AIN0/AIN1) continuously, as the real part does.
+ */
+void AD4115_MODEL::reset(void) {
+	state = COMMS;
+	adcMode = 0x2000;
+	ifMode = 0;
+	for (uint8_t c = 0; c < 16; c++) {channels[c] = (c == 0) ? 0x8001 : 0x0001;}
+	for (uint8_t s = 0; s < 8; s++) {
+		setups[s] = 0x1320;
+		filters[s] = 0x0500;
+	}
+	mode = 0;
+	resultReady = false;
+	channel = -1;
+}
+
+/**
+ * @brief Returns the next enabled channel of the sequence.
+ *
+ * @param after The last converted channel, -1 to start the sequence.
+ * @return The next enabled channel, wrapping around in continuous mode, or -1 at the end of a single conversion.
+ */
+int8_t AD4115_MODEL::nextChannel(int8_t after) {
+	for (int8_t c = after + 1; c < 16; c++) {
+		if (channels[c] & 0x8000) {return c;}
+	}
+	if (mode == 0) {
+		for (int8_t c = 0; c <= after && c < 16; c++) {
+			if (channels[c] & 0x8000) {return c;}
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Starts converting the enabled channels.
+ *
+ * @param nowUs The current time in microseconds.
+ */
+void AD4115_MODEL::startSequence(double nowUs) {
+	resultReady = false;
+	channel = nextChannel(-1);
+	nextResult = nowUs + conversionUs;
+}
+
+/**
+ * @brief Completes the conversions that are due at time nowUs.
+ *
+ * Each completed conversion overwrites the data register with the code of its channel's input and pulls DOUT/RDY low.
+ * A single conversion stops after the last enabled channel; continuous conversion wraps around. After a long idle
+ * period only the latest result is computed.
+ *
+ * @param nowUs The current time in microseconds.
+ */
+void AD4115_MODEL::advance(double nowUs) {
+	if (channel >= 0 && nowUs - nextResult > 1000 * conversionUs) {
+		nextResult = nowUs - conversionUs;
+	}
+
+	while (channel >= 0 && nowUs >= nextResult) {
+		uint16_t config = channels[channel];
+		double volts = input ? input((config >> 5) & 0x1F, config & 0x1F) : 0;
+		double decimal = (volts / 25 + 1) * 8388608;
+		data = (decimal < 0) ? 0 : (decimal > 16777215) ? 16777215 : (uint32_t) decimal;
+		resultReady = true;
+
+		int8_t next = nextChannel(channel);
+		if (mode == 1 && next < 0) {
+			mode = 2;
+			channel = -1;
+			break;
+		}
+		channel = next;
+		nextResult += conversionUs;
+	}
+}
+
+/**
+ * @brief Reads a register.
+ *
+ * Reading the data register consumes the result, so DOUT/RDY goes high until the next conversion completes.
+ *
+ * @param address The register address.
+ * @return The register value.
+ */
+uint32_t AD4115_MODEL::readRegister(uint8_t address) {
+	if (address == 0x00) {return (resultReady ? 0x00 : 0x80) | (channel >= 0 ? channel : 0);}
+	if (address == 0x01) {return adcMode;}
+	if (address == 0x02) {return ifMode;}
+	if (address == 0x04) {
+		resultReady = false;
+		return data;
+	}
+	if (address == 0x07) {return 0x38D0;}
+	if (address >= 0x10 && address < 0x20) {return channels[address - 0x10];}
+	if (address >= 0x20 && address < 0x28) {return setups[address - 0x20];}
+	if (address >= 0x28 && address < 0x30) {return filters[address - 0x28];}
+	return 0;
+}
+
+/**
+ * @brief Writes a register.
+ *
+ * Writing the ADC mode register with mode 0 (continuous) or 1 (single) starts a conversion sequence; modes 2 and above
+ * stop converting.
+ *
+ * @param address The register address.
+ * @param value The register value.
+ * @param nowUs The current time in microseconds.
+ */
+void AD4115_MODEL::writeRegister(uint8_t address, uint32_t value, double nowUs) {
+	if (address == 0x01) {
+		adcMode = value;
+		mode = (value >> 4) & 7;
+		if (mode <= 1) {startSequence(nowUs);}
+		else {channel = -1;}
+	}
+	else if (address == 0x02) {ifMode = value;}
+	else if (address >= 0x10 && address < 0x20) {channels[address - 0x10] = value;}
+	else if (address >= 0x20 && address < 0x28) {setups[address - 0x20] = value;}
+	else if (address >= 0x28 && address < 0x30) {filters[address - 0x28] = value;}
+}
+
+/**
+ * @brief Changes the level of CS. Raising CS returns the interface to the communications register.
+ *
+ * @param low True if CS goes low.
+ */
+void AD4115_MODEL::select(bool low) {
+	if (!low) {state = COMMS;}
+}
+
+/**
+ * @brief Exchanges one byte while CS is low.
+ *
+ * The first byte of every access is the communications register: bit 7 must be 0, bit 6 selects a read and bits 5 to
+ * 0 the register. The register bytes follow, MSB first. Eight consecutive 0xFF bytes reset the part.
+ *
+ * @param data The byte on DIN.
+ * @param nowUs The current time in microseconds.
+ * @return The byte on DOUT.
+ */
+uint8_t AD4115_MODEL::transfer(uint8_t data, double nowUs) {
+	advance(nowUs);
+
+	if (state == READ) {
+		uint8_t out = (uint8_t) (value >> (8 * (size - 1 - count)));
+		if (++count == size) {state = COMMS;}
+		return out;
+	}
+
+	if (state == WRITE) {
+		value = (value << 8) | data;
+		if (++count == size) {
+			writeRegister(address, value, nowUs);
+			state = COMMS;
+		}
+		return 0;
+	}
+
+	if (data == 0xFF) {
+		if (++ones >= 8) {
+			reset();
+			startSequence(nowUs);
+			ones = 0;
+		}
+		return 0xFF;
+	}
+	ones = 0;
+	if (data & 0x80) {return 0;}
+
+	address = data & 0x3F;
+	size = registerSize(address);
+	count = 0;
+	value = 0;
+	if (data & 0x40) {
+		value = readRegister(address);
+		state = READ;
+	}
+	else {
+		state = WRITE;
+	}
+	return 0;
+}
+
+/**
+ * @brief Returns the level of DOUT/RDY.
+ *
+ * @param nowUs The current time in microseconds.
+ * @return 0 if a conversion result is ready to be read, 1 otherwise.
+ */
+int AD4115_MODEL::ready(double nowUs) {
+	advance(nowUs);
+	return resultReady ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#ifndef MODELS_H
+#define MODELS_H
+#include <stdint.h>
+#include <functional>
+using namespace std;
+
+///
+/// Behavioural model of one AD5791 on the SPI bus: a 24-bit input shift register that is
+/// decoded on the rising edge of SYNC, the DAC, control and readback registers, and the
+/// output latch updated on the falling edge of LDAC.
+///
+class AD5791_MODEL
+{
+public:
+	void select(bool low);
+	uint8_t transfer(uint8_t data);
+	void ldac(void);
+	///
+	/// Output voltage: 0 while the output is clamped to ground or tri-stated (the
+	/// power-on state until the control register is written).
+	///
+	double voltage(void) const;
+	uint32_t code(void) const;
+
+private:
+	uint32_t shift = 0;
+	uint8_t bits = 0;
+	uint32_t readback = 0;
+	uint32_t dacRegister = 0;
+	uint32_t control = 0x0C;
+	uint32_t latched = 0;
+	bool selected = false;
+};
+
+///
+/// Behavioural model of the AD4115: the communications register protocol, the register
+/// file, single and continuous conversion of the enabled channels in ascending order, and
+/// DOUT/RDY, which goes low when a result is ready and high when it has been read.
+/// Conversion results are computed from the analog input function when they complete.
+///
+class AD4115_MODEL
+{
+public:
+	///
+	/// Voltage at an analog input pair, in volts.
+	///
+	function<double(uint8_t positive, uint8_t negative)> input;
+	double conversionUs = 100;
+
+	void select(bool low);
+	uint8_t transfer(uint8_t data, double nowUs);
+	///
+	/// Level of DOUT/RDY at time nowUs: 0 when a result is ready.
+	///
+	int ready(double nowUs);
+
+private:
+	enum State : uint8_t { COMMS, WRITE, READ };
+
+	State state = COMMS;
+	uint8_t address = 0;
+	uint8_t size = 0;
+	uint8_t count = 0;
+	uint32_t value = 0;
+	uint8_t ones = 0;
+
+	uint16_t adcMode = 0x2000;
+	uint16_t ifMode = 0;
+	uint16_t channels[16] = {0x8001};
+	uint16_t setups[8] = {0};
+	uint16_t filters[8] = {0};
+	uint32_t data = 0;
+
+	uint8_t mode = 2;
+	bool resultReady = false;
+	int8_t channel = -1;
+	double nextResult = 0;
+
+	static uint8_t registerSize(uint8_t address);
+	uint32_t readRegister(uint8_t address);
+	void writeRegister(uint8_t address, uint32_t value, double nowUs);
+	void startSequence(double nowUs);
+	int8_t nextChannel(int8_t after);
+	void advance(double nowUs);
+	void reset(void);
+};
+
+#endif // MODELS_H
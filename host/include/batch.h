@@ -0,0 +1,58 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+using namespace std;
+
+///
+/// Builder of a binary batch frame (BATCH_BIN): a list of DAC writes, LDAC updates, ADC scans
+/// and delays that the board runs back to back after a single command line. Every operation
+/// is one opcode byte followed by its arguments MSB first; see the firmware's include/batch.h.
+///
+class BATCH_FRAME
+{
+public:
+	enum Opcode : uint8_t { DAC_CODE = 0x01, LDAC = 0x02, ADC_SCAN = 0x03, DELAY_US = 0x04 };
+
+	///
+	/// Longest frame the board accepts.
+	///
+	static const size_t kMaxBytes = 256;
+
+	///
+	/// Loads a 20-bit code into a DAC register; the output changes at the next ldac().
+	///
+	BATCH_FRAME& dacCode(uint8_t channel, uint32_t code);
+	///
+	/// As dacCode(), with the code of a voltage as AD5791::voltageToCode computes it (+-10 V).
+	///
+	BATCH_FRAME& dacVoltage(uint8_t channel, double voltage);
+	///
+	/// Updates every DAC output at once.
+	///
+	BATCH_FRAME& ldac(void);
+	///
+	/// Converts the enabled ADC channels; the reply carries 3 bytes per enabled channel.
+	///
+	BATCH_FRAME& adcScan(void);
+	BATCH_FRAME& delayUs(uint32_t us);
+
+	///
+	/// Number of ADC scans, to size the reply.
+	///
+	size_t scans(void) const;
+	const vector<uint8_t>& bytes(void) const;
+	void clear(void);
+
+	///
+	/// DAC code of a voltage, as AD5791::voltageToCode: two's complement, 10 V full scale.
+	///
+	static uint32_t voltageToCode(double voltage);
+
+private:
+	vector<uint8_t> frame;
+	size_t scanCount = 0;
+};
+
+#endif // BATCH_H
@@ -0,0 +1,144 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "port.h"
+#include "decoder.h"
+#include "batch.h"
+using namespace std;
+
+///
+/// Asynchronous client of the od-dacadc firmware. Commands are written by a writer thread
+/// as soon as the flow-control window allows, without waiting for earlier replies, and a
+/// reader thread decodes the replies in order and completes their futures or callbacks.
+///
+class CLIENT
+{
+public:
+	typedef function<void(Reply&)> Callback;
+
+	///
+	/// Command bytes allowed on the board before their replies complete. The Due's UART
+	/// receive buffer holds 128 bytes; commands beyond it would be dropped.
+	///
+	static const size_t kWindowBytes = 96;
+
+	///
+	/// Opens the port and starts the threads.
+	/// \returns 0 if successful, 1 if the port cannot be opened.
+	///
+	uint8_t open(const string& path, uint32_t baud);
+	///
+	/// Stops the threads and fails every pending request with the error "closed".
+	///
+	void close(void);
+
+	///
+	/// Queues a command line (without line ending). The reply is decoded by 'decoder'.
+	/// An exclusive request is sent only when nothing else is in flight, and nothing
+	/// is sent after it until its reply is complete. Queued requests are sent in order of
+	/// priority, highest first, and in order of submission within a priority.
+	///
+	future<Reply> request(const string& command, unique_ptr<DECODER> decoder, bool exclusive = false, int priority = 0);
+	void request(const string& command, unique_ptr<DECODER> decoder, Callback callback, bool exclusive = false,
+	             int priority = 0);
+	///
+	/// As request(), with payload bytes written right after the command line in the same
+	/// write, e.g. the frame of a BATCH_BIN. Such a request is exclusive by default, so that
+	/// the board reads the payload as soon as it arrives.
+	///
+	future<Reply> request(const string& command, const vector<uint8_t>& payload, unique_ptr<DECODER> decoder,
+	                      bool exclusive = true, int priority = 0);
+	void request(const string& command, const vector<uint8_t>& payload, unique_ptr<DECODER> decoder, Callback callback,
+	             bool exclusive = true, int priority = 0);
+	///
+	/// Queues a command with the decoder chosen by decoder_utils::forCommand.
+	///
+	future<Reply> send(const string& command);
+	///
+	/// Uploads a waveform table (AWG_LOAD): codes holds nPoints points of one 20-bit code
+	/// per channel of channelMask, in ascending channel order.
+	///
+	future<Reply> awgLoad(uint8_t channelMask, const vector<uint32_t>& codes);
+	///
+	/// Runs a binary batch frame (BATCH_BIN) in one round trip. The reply's codes hold the
+	/// enabled ADC channels of every scan of the frame.
+	///
+	future<Reply> batch(const BATCH_FRAME& frame);
+	///
+	/// Uploads a sequencer program (SEQ_LOAD), e.g. assembled by sequence_utils::assemble.
+	///
+	future<Reply> sequenceLoad(const vector<uint8_t>& program);
+
+	///
+	/// Reply shape settings used by send(): enabled ADC channels, raw buffered ramps and ramps
+	/// waiting for a sync edge. send() keeps syncedRamps up to date from the RAMP_SYNC it sends.
+	///
+	uint8_t adcChannels = 1;
+	bool binaryRamps = false;
+	bool syncedRamps = false;
+	///
+	/// Prefix every command of send(), awgLoad(), batch() and sequenceLoad() with a request ID ("#17,"), so that the
+	/// board frames each reply with ACK and DONE events whatever its number of lines.
+	///
+	bool requestIds = false;
+
+	size_t pending(void);
+	///
+	/// False once the client is closed or the port has hung up.
+	///
+	bool isOpen(void);
+	///
+	/// Writes bytes to the board outside the request queue. Only safe while an exclusive
+	/// request is in flight, e.g. to send the table of an AWG_LOAD after AWG_READY.
+	///
+	void write(const uint8_t* data, size_t size);
+
+	CLIENT(void) = default;
+	CLIENT(const CLIENT&) = delete;
+	CLIENT& operator=(const CLIENT&) = delete;
+	~CLIENT();
+
+private:
+	struct Request {
+		string bytes;
+		unique_ptr<DECODER> decoder;
+		Callback callback;
+		shared_ptr<promise<Reply> > result;
+		bool exclusive;
+		int priority;
+		Reply reply;
+		chrono::steady_clock::time_point sent;
+	};
+
+	PORT port;
+	mutex lock;
+	mutex writeLock;
+	condition_variable changed;
+	deque<unique_ptr<Request> > queued;
+	deque<unique_ptr<Request> > inFlight;
+	size_t inFlightBytes = 0;
+	atomic<uint32_t> nextId{1};
+	bool running = false;
+	thread reader;
+	thread writer;
+
+	void enqueue(unique_ptr<Request> request);
+	bool canSend(const Request& request);
+	void writeLoop(void);
+	void readLoop(void);
+	void complete(unique_ptr<Request> request);
+	future<Reply> framed(string command, const vector<uint8_t>& frame);
+};
+
+#endif // CLIENT_H
@@ -0,0 +1,73 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+#include "client.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+///
+/// Code streams of several boards merged by step index: row r holds the codes of step r of
+/// every board, board by board and channel by channel within a board.
+///
+struct MergedStream {
+	vector<string> columns;
+	vector<uint32_t> codes;
+
+	size_t rows(void) const { return columns.empty() ? 0 : codes.size() / columns.size(); }
+};
+
+///
+/// Drives several boards at once, each through its own CLIENT (and its I/O threads), so that
+/// experiments can use more DAC and ADC channels than one board has. Ramps are started
+/// together, on a shared sync line when one is wired (see RAMP_SYNC in the firmware).
+///
+class COORDINATOR
+{
+public:
+	///
+	/// Opens a board. Boards are numbered in the order they are added.
+	/// \returns 0 if successful, 1 if the port cannot be opened.
+	///
+	uint8_t addBoard(const string& path, uint32_t baud, uint8_t adcChannels, bool binary);
+	size_t boards(void) const;
+	CLIENT& board(size_t index);
+	void close(void);
+
+	///
+	/// Sends the same command to every board at once and returns the replies in board order.
+	///
+	vector<Reply> broadcast(const string& command);
+	///
+	/// Wires the ramps of all boards to a shared sync line on 'pin': board 'leader' produces
+	/// the start edge, the others wait for it up to timeoutMs. pin -1 goes back to software
+	/// start. \returns 0 if every board accepted the configuration.
+	///
+	uint8_t setSync(int8_t pin, uint8_t edge, uint32_t timeoutMs, size_t leader);
+	///
+	/// Starts one ramp command per board (a single command is sent to all) and returns the
+	/// replies in board order. With a sync line, the followers are started first and the
+	/// leader once every follower reported SYNC_ARMED; if they are not all armed within
+	/// armTimeoutMs, the followers are aborted and the leader is not started. Without a sync
+	/// line, the commands are written to all boards back to back.
+	///
+	vector<Reply> start(const vector<string>& commands, uint32_t armTimeoutMs = 5000);
+	///
+	/// Merges the code streams of start() replies by step index, keeping the steps that every
+	/// board delivered.
+	///
+	MergedStream merge(const vector<Reply>& replies);
+
+	COORDINATOR(void) = default;
+	COORDINATOR(const COORDINATOR&) = delete;
+	COORDINATOR& operator=(const COORDINATOR&) = delete;
+
+private:
+	vector<unique_ptr<CLIENT> > clients;
+	int8_t syncPin = -1;
+	size_t syncLeader = 0;
+};
+
+#endif // COORDINATOR_H
@@ -0,0 +1,151 @@
+#ifndef DECODER_H
+#define DECODER_H
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+///
+/// Decoded reply of one command. Text lines are stored without line endings; raw
+/// 24-bit ADC codes and the voltages of legacy streams are stored in order of arrival.
+///
+struct Reply {
+	string command;
+	vector<string> lines;
+	vector<uint32_t> codes;
+	vector<double> voltages;
+	string error;
+	double latencyUs = 0;
+	///
+	/// Commands sent with a request ID: the ID, the time from queueing to the board's ACK
+	/// event, and the run time the board reported in its DONE event.
+	///
+	string id;
+	double ackUs = 0;
+	double deviceUs = 0;
+
+	bool ok(void) const { return error.empty(); }
+};
+
+///
+/// Consumes the bytes of one reply. The firmware has no common reply framing, so every
+/// command is paired with a decoder that knows where its reply ends.
+///
+class DECODER
+{
+public:
+	virtual ~DECODER() = default;
+	///
+	/// Consumes bytes of this reply from data and returns how many were used. Must stop
+	/// consuming as soon as the reply is complete; the rest belongs to the next reply.
+	///
+	virtual size_t feed(const uint8_t* data, size_t size, Reply& reply) = 0;
+	virtual bool done(void) const = 0;
+	///
+	/// Bytes the client must send to the board now (e.g. a table after AWG_READY).
+	///
+	virtual vector<uint8_t> takeOutgoing(void) { return vector<uint8_t>(); }
+};
+
+/**
+ * @namespace decoder_utils
+ * @brief Namespace containing the reply decoders of the firmware commands.
+ *
+ * Every factory returns a decoder for one reply shape. Decoders that know the size of their data reserve it up front,
+ * so the background reader writes samples into preallocated storage.
+ */
+namespace decoder_utils {
+
+	///
+	/// A fixed number of text lines.
+	///
+	unique_ptr<DECODER> lines(size_t count);
+	///
+	/// Text lines up to and including the first one starting with one of endPrefixes.
+	///
+	unique_ptr<DECODER> until(vector<string> endPrefixes);
+	///
+	/// Text lines up to the first one starting with one of endPrefixes, then 'trailing' more lines.
+	/// Used for replies whose last line has no marker (CONFIG_CHANNEL ends with the state of channel 15).
+	///
+	unique_ptr<DECODER> until(vector<string> endPrefixes, size_t trailing);
+	///
+	/// 'bytes' raw bytes, decoded as 3-byte codes MSB first, then text lines until one of endPrefixes.
+	/// Used for pipelined and timed buffered ramps.
+	///
+	unique_ptr<DECODER> binary(size_t bytes, vector<string> endPrefixes);
+	///
+	/// Text lines until a line starting with beginPrefix whose first field is the sample count n,
+	/// then 3 * n raw bytes, then text lines until one of endPrefixes. A line matching an end
+	/// prefix before the begin line ends the reply (e.g. TRIG_TIMEOUT).
+	///
+	unique_ptr<DECODER> counted(string beginPrefix, vector<string> endPrefixes);
+	///
+	/// 'records' records of the legacy buffered ramp stream written by AD4115::bufferRampFullReading
+	/// (three raw bytes each followed by "_\r\n", then the voltage with six decimals), with any text
+	/// lines in between, then text lines until one of endPrefixes.
+	///
+	unique_ptr<DECODER> legacyRamp(size_t records, vector<string> endPrefixes);
+	///
+	/// Any number of legacy ramp records, with text lines in between, up to one of endPrefixes.
+	/// Used for ramps whose point count is not known from the command (SLEW_RAMP, PATH_RUN).
+	///
+	unique_ptr<DECODER> legacyRamp(vector<string> endPrefixes);
+	///
+	/// Reply of ADAPTIVE_RAMP: ADAPTIVE_BEGIN,dacChannels,adcChannels, records of a 0x01 byte and
+	/// the 3-byte DAC and ADC codes of a point (stored in order in codes), a 0x00 byte, then text
+	/// lines up to ADAPTIVE_DONE. INVALID ADAPTIVE RAMP ends the reply.
+	///
+	unique_ptr<DECODER> adaptive(void);
+	///
+	/// Reply of RASTER: RASTER_BEGIN,lines,points,adcChannels, one frame per line of a 7-byte
+	/// header and the 3-byte codes of its points (the codes are stored, the headers skipped), then
+	/// text lines up to RASTER_DONE. INVALID RASTER AXES ends the reply.
+	///
+	unique_ptr<DECODER> raster(void);
+	///
+	/// Text lines until readyPrefix, after which 'payload' is sent to the board, then text lines
+	/// until one of endPrefixes. Used for AWG_LOAD.
+	///
+	unique_ptr<DECODER> upload(string readyPrefix, vector<uint8_t> payload, vector<string> endPrefixes);
+
+	///
+	/// Reply of a ramp started on a shared sync line (RAMP_SYNC): text lines up to SYNC_ARMED,
+	/// when onArmed is called, then the status byte ('+' starts the ramp, whose reply is decoded
+	/// by 'ramp'; after '!' the reply ends on the SYNC TIMEOUT line with the error "sync timeout").
+	///
+	unique_ptr<DECODER> synced(unique_ptr<DECODER> ramp, function<void()> onArmed);
+	///
+	/// Reply of a command sent with request ID 'id' ("#id,COMMAND,..."): lines up to the
+	/// "@id,ACK" event, the raw samples decoded by 'stream' if not null, then lines up to the
+	/// "@id,DONE,elapsed_us" event.
+	///
+	unique_ptr<DECODER> tagged(const string& id, unique_ptr<DECODER> stream);
+	///
+	/// The reply decoded by 'reply', with every consumed byte also passed to 'sink' as it
+	/// arrives (on the client's reader thread). Used to forward replies unchanged.
+	///
+	unique_ptr<DECODER> relayed(unique_ptr<DECODER> reply, function<void(const uint8_t*, size_t)> sink);
+
+	///
+	/// Reply shape of a command line, chosen from the command name and its arguments.
+	/// channels is the number of enabled ADC channels; binary selects the raw format of
+	/// buffered ramps (RAMP_PIPELINE or RAMP_TIMED enabled); sync wraps RAMP and BUFFER_RAMP
+	/// in synced() (RAMP_SYNC with a pin set). exclusive is set for commands that must not
+	/// have other commands queued behind them on the board. A line starting with a request
+	/// ID gets the tagged() decoder, and a batch of commands separated by ';' reads up to
+	/// BATCH_DONE.
+	///
+	unique_ptr<DECODER> forCommand(const string& line, uint8_t channels, bool binary, bool sync, bool* exclusive);
+	///
+	/// The 'sync' argument of forCommand() after 'line' is sent: RAMP_SYNC sets or clears it,
+	/// other lines keep 'sync'.
+	///
+	bool syncAfter(const string& line, bool sync);
+	vector<string> split(const string& line);
+}
+
+#endif // DECODER_H
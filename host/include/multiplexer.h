@@ -0,0 +1,111 @@
+#ifndef MULTIPLEXER_H
+#define MULTIPLEXER_H
+#include "client.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+///
+/// Shares one board between several local processes. The multiplexer owns the port through
+/// a CLIENT and serves a Unix socket that behaves like the board's port: every command line
+/// a connection sends is queued on the board, and the bytes of its reply are forwarded to
+/// that connection only, as they arrive. Connections can raise their queue priority, and
+/// monitor connections receive a copy of every reply. Commands starting with MUX_ are
+/// answered by the multiplexer itself:
+///   MUX_PRIORITY,n           queue priority of the connection's commands (default 0, higher first)
+///   MUX_SHAPE,channels,bin   reply shape of later commands (enabled ADC channels, raw ramps)
+///   MUX_MONITOR,on           receive the replies of every connection
+///   MUX_STATUS               connections and board requests pending
+/// A MUX_ command waits until the connection's earlier commands are complete, and the
+/// commands after it wait for it, so that replies stay in order.
+///
+class MULTIPLEXER
+{
+public:
+	///
+	/// Reply bytes buffered for a connection that does not read them; beyond this the
+	/// connection is closed so that it cannot hold up the board.
+	///
+	static const size_t kMaxBacklogBytes = 64 << 20;
+
+	///
+	/// Opens the board and listens on socketPath. A stale socket file is replaced; a socket
+	/// that another daemon still serves is not.
+	/// \returns 0 if successful, 1 if the port or the socket cannot be opened.
+	///
+	uint8_t open(const string& portPath, uint32_t baud, const string& socketPath);
+	///
+	/// Serves connections until stop() is called or the board hangs up.
+	/// \returns 0 after stop(), 1 if the board was lost.
+	///
+	uint8_t run(void);
+	///
+	/// Makes run() return. Safe to call from a signal handler.
+	///
+	void stop(void);
+	///
+	/// Closes every connection, the socket and the board.
+	///
+	void close(void);
+
+	///
+	/// Reply shape of forwarded commands, as in CLIENT::send().
+	///
+	uint8_t adcChannels = 1;
+	bool binaryRamps = false;
+
+	MULTIPLEXER(void) = default;
+	MULTIPLEXER(const MULTIPLEXER&) = delete;
+	MULTIPLEXER& operator=(const MULTIPLEXER&) = delete;
+	~MULTIPLEXER();
+
+private:
+	struct Session {
+		int fd;
+		string input;
+		deque<string> lines;
+		// Guarded by 'lock': written by the client's reader thread.
+		string output;
+		size_t pending = 0;
+		bool monitor = false;
+		bool closed = false;
+		// AWG_LOAD table forwarded from the connection once the board printed AWG_READY.
+		size_t uploadBytes = 0;
+		string upload;
+		string uploadReply;
+		bool uploadReady = false;
+		// BATCH_BIN or SEQ_LOAD line and the part of its frame received so far, queued once complete.
+		size_t frameBytes = 0;
+		string frame;
+		int priority = 0;
+	};
+
+	CLIENT client;
+	// Whether the board's ramps wait for a sync edge, after the RAMP_SYNC lines queued so far.
+	bool syncedRamps = false;
+	string socketPath;
+	int listener = -1;
+	int wake[2] = {-1, -1};
+	atomic<bool> stopping{false};
+	mutex lock;
+	vector<shared_ptr<Session> > sessions;
+
+	void accept(void);
+	void receive(const shared_ptr<Session>& session);
+	void dispatch(const shared_ptr<Session>& session);
+	void command(const shared_ptr<Session>& session, const string& text);
+	string local(Session& session, const string& line);
+	void relay(const shared_ptr<Session>& owner, const uint8_t* data, size_t size);
+	void finish(const shared_ptr<Session>& owner, const Reply& reply);
+	void send(Session& session);
+	void forwardUpload(Session& session);
+	void notify(void);
+};
+
+#endif // MULTIPLEXER_H
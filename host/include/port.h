@@ -0,0 +1,44 @@
+#ifndef PORT_H
+#define PORT_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+using namespace std;
+
+///
+/// Raw serial port (or pseudo-terminal) opened in non-canonical 8N1 mode, or a connection
+/// to the Unix socket of od-daemon, which behaves like the board's port.
+///
+class PORT
+{
+private:
+	int fd = -1;
+
+	uint8_t connect(const string& path);
+
+public:
+	///
+	/// Opens the device. baud is ignored by pseudo-terminals, sockets and the Due's native USB port.
+	/// \returns 0 if successful, 1 if the device cannot be opened or configured.
+	///
+	uint8_t open(const string& path, uint32_t baud);
+	void close(void);
+	bool isOpen(void) const;
+	///
+	/// Writes all bytes, blocking until they are accepted by the driver.
+	/// \returns 0 if successful, 1 on error.
+	///
+	uint8_t write(const uint8_t* data, size_t size);
+	///
+	/// Waits up to timeoutMs for data and reads what is available.
+	/// \returns the number of bytes read, 0 on timeout, -1 on error or hang-up.
+	///
+	long read(uint8_t* data, size_t size, int timeoutMs);
+
+	PORT(void) = default;
+	PORT(const PORT&) = delete;
+	PORT& operator=(const PORT&) = delete;
+	~PORT();
+};
+
+#endif // PORT_H
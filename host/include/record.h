@@ -0,0 +1,155 @@
+#ifndef RECORD_H
+#define RECORD_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @namespace record_utils
+ * @brief Namespace containing the layout of the columnar recording file (.odr).
+ *
+ * A recording is a 4096-byte header followed by page-aligned chunks. The header holds the column names and types, the
+ * chunk geometry and a free-text configuration (commands, channel and setup configuration). Every chunk starts with a
+ * 64-byte chunk header (row count, index of its first row), followed by one block per column with room for
+ * chunkRows values, each block 64-byte aligned. All offsets follow from the header, so a reader maps the file and
+ * addresses any column of any chunk directly, without parsing. Chunks are only ever appended; the header counts are
+ * rewritten after every chunk. Values are stored in host (little-endian) byte order.
+ */
+namespace record_utils {
+
+	enum ColumnType : uint32_t { INT32, UINT32, FLOAT32, FLOAT64, UINT64 };
+
+	size_t typeSize(ColumnType type);
+	const char* typeName(ColumnType type);
+
+	const size_t kHeaderBytes = 4096;
+	const size_t kChunkHeaderBytes = 64;
+	const size_t kMaxColumns = 32;
+	const size_t kNameBytes = 24;
+	const char kMagic[8] = {'O', 'D', 'R', 'E', 'C', 0, 0, 1};
+	const uint32_t kChunkMagic = 0x4B4E4843; // "CHNK"
+
+	struct ColumnHeader {
+		char name[kNameBytes];
+		uint32_t type;
+		uint32_t offset; ///< Offset of the column block from the start of its chunk
+	};
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t columnCount;
+		uint32_t chunkRows;
+		uint32_t configurationBytes;
+		uint64_t chunkBytes;
+		uint64_t chunkCount;
+		uint64_t rowCount;
+		ColumnHeader columns[kMaxColumns];
+	};
+
+	struct ChunkHeader {
+		uint32_t magic;
+		uint32_t rows;
+		uint64_t firstRow;
+	};
+
+	///
+	/// Offset of the configuration text in the file header; it may fill the header up to kHeaderBytes.
+	///
+	const size_t kConfigurationOffset = (sizeof(FileHeader) + 63) & ~(size_t) 63;
+
+	///
+	/// Name and type of a column.
+	///
+	struct Column {
+		string name;
+		ColumnType type;
+	};
+}
+
+///
+/// Appends rows to a new recording. Rows are gathered column by column in a chunk buffer,
+/// which is written out when full, on flush() and on close().
+///
+class RECORDER
+{
+public:
+	///
+	/// Creates the file, truncating an existing one.
+	/// \returns 0 if successful, 1 if the columns or configuration do not fit the header or the file cannot be written.
+	///
+	uint8_t create(const string& path, const vector<record_utils::Column>& columns, const string& configuration,
+	               uint32_t chunkRows = 65536);
+	///
+	/// Appends 'rows' rows given column-wise: values[c] points to 'rows' values of column c.
+	///
+	uint8_t append(size_t rows, const void* const* values);
+	///
+	/// Writes the buffered rows as a (possibly partial) chunk, so they reach the file now.
+	///
+	uint8_t flush(void);
+	uint8_t close(void);
+	uint64_t rows(void) const;
+
+	RECORDER(void) = default;
+	RECORDER(const RECORDER&) = delete;
+	RECORDER& operator=(const RECORDER&) = delete;
+	~RECORDER();
+
+private:
+	int fd = -1;
+	record_utils::FileHeader header;
+	vector<uint8_t> chunk;
+	uint32_t chunkFill = 0;
+
+	uint8_t writeHeader(void);
+};
+
+///
+/// Read-only view of a recording mapped into memory.
+///
+class RECORDING
+{
+public:
+	///
+	/// Maps the file. \returns 0 if successful, 1 if it cannot be mapped or is not a recording.
+	///
+	uint8_t open(const string& path);
+	void close(void);
+
+	const vector<record_utils::Column>& columns(void) const;
+	///
+	/// Index of the column with this name, -1 if there is none.
+	///
+	int column(const string& name) const;
+	const string& configuration(void) const;
+	uint64_t rows(void) const;
+	uint64_t chunks(void) const;
+	uint32_t chunkRows(uint64_t chunk) const;
+	///
+	/// Values of a column in one chunk, chunkRows(chunk) of them, pointing into the mapping.
+	///
+	const void* data(uint64_t chunk, int column) const;
+	template <typename T> const T* data(uint64_t chunk, int column) const { return (const T*) data(chunk, column); }
+	///
+	/// Copies a whole column into 'out', converted to double.
+	///
+	void read(int column, vector<double>& out) const;
+
+	RECORDING(void) = default;
+	RECORDING(const RECORDING&) = delete;
+	RECORDING& operator=(const RECORDING&) = delete;
+	~RECORDING();
+
+private:
+	const uint8_t* base = 0;
+	size_t size = 0;
+	const record_utils::FileHeader* header = 0;
+	vector<record_utils::Column> columnList;
+	string text;
+	uint64_t chunkCount = 0;
+};
+
+#endif // RECORD_H
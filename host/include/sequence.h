@@ -0,0 +1,62 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @namespace sequence_utils
+ * @brief Namespace containing the assembler of the firmware's sequencer programs (SEQ_LOAD, SEQ_RUN).
+ *
+ * A program is bytecode run by the SEQUENCER of the firmware: eight signed 32-bit registers r0 to r7, DAC writes with an
+ * explicit LDAC, delays, ADC scans, comparisons, jumps and EMIT, which appends a register to the values sent back after
+ * the run. The assembler reads one instruction per line, with operands separated by commas:
+ *
+ *         set r0, 100           ; points
+ *         set r1, dac(-5)       ; DAC code of -5 V
+ *   next: dac_reg 0, r1
+ *         ldac
+ *         delay_us 200
+ *         adc_scan
+ *         adc_get r2, 0
+ *         emit r2
+ *         add r1, 1000
+ *         loop r0, next
+ *
+ * Comments start with ';' or '#', and a label is a name followed by ':'. Immediates are integers (decimal or 0x hex),
+ * dac(volts) for the DAC code of a voltage or adc(volts) for the AD4115 code of a voltage (+-25 V). Jumps take a label
+ * or a byte offset.
+ */
+namespace sequence_utils {
+
+	///
+	/// Opcodes, as SEQUENCER::Opcode in the firmware's include/sequencer.h.
+	///
+	enum Opcode : uint8_t {
+		HALT = 0x00, DAC_CODE = 0x01, LDAC = 0x02, ADC_SCAN = 0x03, DELAY_US = 0x04,
+		SET = 0x10, ADD = 0x11, ADD_REG = 0x12, SUB_REG = 0x13, MOV = 0x14, ADC_GET = 0x15, DAC_REG = 0x16, EMIT = 0x17,
+		CMP = 0x20, JMP = 0x21, JEQ = 0x22, JNE = 0x23, JLT = 0x24, JGE = 0x25, LOOP = 0x26
+	};
+
+	const size_t kMaxProgramBytes = 4096;
+	const uint8_t kRegisters = 8;
+
+	///
+	/// Assembles source text into program.
+	/// \returns 0 if successful, 1 with error set to "line N: reason" otherwise.
+	///
+	uint8_t assemble(const string& source, vector<uint8_t>& program, string& error);
+
+	///
+	/// Signed DAC code of a voltage (+-10 V), as AD5791::voltageToCode; DAC_REG writes its low 20 bits.
+	///
+	int32_t dacCode(double voltage);
+	///
+	/// AD4115 code of a voltage, the inverse of (code / 2^23 - 1) * 25.
+	///
+	int32_t adcCode(double voltage);
+}
+
+#endif // SEQUENCE_H
@@ -0,0 +1,47 @@
+#ifndef UNPACK_H
+#define UNPACK_H
+#include <stdint.h>
+#include <stddef.h>
+using namespace std;
+
+/**
+ * @namespace unpack_utils
+ * @brief Namespace containing the converters of raw AD4115 sample streams.
+ *
+ * The firmware streams each sample as a 3-byte big-endian offset-binary code. These functions unpack packed codes into
+ * int32 arrays, or map them to volts with the +-25 V formula of AD4115::voltageMap, using SSSE3 or AVX2 when the
+ * processor has them (chosen at run time) and a scalar loop otherwise. Large arrays are split across worker threads.
+ */
+namespace unpack_utils {
+
+	///
+	/// Instruction set of a conversion.
+	///
+	enum Isa : uint8_t { SCALAR, SSSE3, AVX2, BEST };
+
+	///
+	/// Best instruction set supported by this processor.
+	///
+	Isa bestIsa(void);
+	const char* isaName(Isa isa);
+
+	///
+	/// Unpacks count codes (3 * count bytes) into out, on the calling thread.
+	///
+	void codes(const uint8_t* data, size_t count, int32_t* out, Isa isa = BEST);
+	///
+	/// Unpacks count codes into volts: (code / 2^23 - 1) * 25, on the calling thread.
+	///
+	void voltages(const uint8_t* data, size_t count, float* out, Isa isa = BEST);
+
+	///
+	/// As codes() and voltages(), split across 'threads' workers (0: one per hardware thread).
+	/// Arrays under kParallelMinimum codes are converted on the calling thread.
+	///
+	void codesParallel(const uint8_t* data, size_t count, int32_t* out, unsigned threads = 0, Isa isa = BEST);
+	void voltagesParallel(const uint8_t* data, size_t count, float* out, unsigned threads = 0, Isa isa = BEST);
+
+	const size_t kParallelMinimum = 1 << 16;
+}
+
+#endif // UNPACK_H
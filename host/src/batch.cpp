@@ -0,0 +1,86 @@
+#include "../include/batch.h"
+#include <stdint.h>
+using namespace std;
+
+/**
+ * @brief Appends a DAC_CODE operation.
+ *
+ * @param channel The DAC channel, 0 to 3.
+ * @param code The 20-bit two's complement code.
+ * @return The frame.
+ */
+BATCH_FRAME& BATCH_FRAME::dacCode(uint8_t channel, uint32_t code) {
+	frame.push_back(DAC_CODE);
+	frame.push_back(channel);
+	frame.push_back((uint8_t) ((code >> 16) & 0x0F));
+	frame.push_back((uint8_t) (code >> 8));
+	frame.push_back((uint8_t) code);
+	return *this;
+}
+
+/**
+ * @brief Appends a DAC_CODE operation for a voltage.
+ *
+ * @param channel The DAC channel, 0 to 3.
+ * @param voltage The output voltage; clamped to +-10 V.
+ * @return The frame.
+ */
+BATCH_FRAME& BATCH_FRAME::dacVoltage(uint8_t channel, double voltage) {
+	return dacCode(channel, voltageToCode(voltage));
+}
+
+BATCH_FRAME& BATCH_FRAME::ldac(void) {
+	frame.push_back(LDAC);
+	return *this;
+}
+
+BATCH_FRAME& BATCH_FRAME::adcScan(void) {
+	frame.push_back(ADC_SCAN);
+	scanCount++;
+	return *this;
+}
+
+/**
+ * @brief Appends a DELAY_US operation.
+ *
+ * @param us The delay in microseconds.
+ * @return The frame.
+ */
+BATCH_FRAME& BATCH_FRAME::delayUs(uint32_t us) {
+	frame.push_back(DELAY_US);
+	frame.push_back((uint8_t) (us >> 24));
+	frame.push_back((uint8_t) (us >> 16));
+	frame.push_back((uint8_t) (us >> 8));
+	frame.push_back((uint8_t) us);
+	return *this;
+}
+
+size_t BATCH_FRAME::scans(void) const {
+	return scanCount;
+}
+
+const vector<uint8_t>& BATCH_FRAME::bytes(void) const {
+	return frame;
+}
+
+void BATCH_FRAME::clear(void) {
+	frame.clear();
+	scanCount = 0;
+}
+
+/**
+ * @brief Computes the DAC code of a voltage with the same arithmetic as the firmware.
+ *
+ * @param voltage The voltage; clamped to +-10 V.
+ * @return The 20-bit two's complement code.
+ */
+uint32_t BATCH_FRAME::voltageToCode(double voltage) {
+	const double fullScale = 10.0;
+	if (voltage < -fullScale) {voltage = -fullScale;}
+	if (voltage > fullScale) {voltage = fullScale;}
+
+	if (voltage < 0) {
+		return ((uint32_t) (voltage * 524288 / fullScale + 1048576)) & 0xFFFFF;
+	}
+	return (uint32_t) (voltage * 524287 / fullScale);
+}
@@ -0,0 +1,408 @@
+#include "../include/client.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Opens the port and starts the reader and writer threads.
+ *
+ * @param path The device path of the board or of a pseudo-terminal.
+ * @param baud The baud rate.
+ * @return 0 if successful, 1 if the port cannot be opened.
+ */
+uint8_t CLIENT::open(const string& path, uint32_t baud) {
+	close();
+	if (port.open(path, baud) != 0) {return 1;}
+
+	running = true;
+	reader = thread(&CLIENT::readLoop, this);
+	writer = thread(&CLIENT::writeLoop, this);
+	return 0;
+}
+
+/**
+ * @brief Stops the threads, closes the port and fails every pending request.
+ */
+void CLIENT::close(void) {
+	{
+		lock_guard<mutex> guard(lock);
+		running = false;
+	}
+	changed.notify_all();
+
+	if (writer.joinable()) {writer.join();}
+	if (reader.joinable()) {reader.join();}
+	port.close();
+
+	deque<unique_ptr<Request> > failed;
+	{
+		lock_guard<mutex> guard(lock);
+		while (!inFlight.empty()) {
+			failed.push_back(move(inFlight.front()));
+			inFlight.pop_front();
+		}
+		while (!queued.empty()) {
+			failed.push_back(move(queued.front()));
+			queued.pop_front();
+		}
+		inFlightBytes = 0;
+	}
+
+	for (size_t r = 0; r < failed.size(); r++) {
+		failed[r]->reply.error = "closed";
+		complete(move(failed[r]));
+	}
+}
+
+/**
+ * @brief Returns the number of requests that are queued or in flight.
+ *
+ * @return The number of incomplete requests.
+ */
+size_t CLIENT::pending(void) {
+	lock_guard<mutex> guard(lock);
+	return queued.size() + inFlight.size();
+}
+
+/**
+ * @brief Returns whether the client is running.
+ *
+ * @return False after close() or a hang-up of the port.
+ */
+bool CLIENT::isOpen(void) {
+	lock_guard<mutex> guard(lock);
+	return running;
+}
+
+/**
+ * @brief Queues a command whose reply completes a future.
+ *
+ * @param command The command line without line ending, e.g. "GET_ADC,0".
+ * @param decoder The decoder of the reply.
+ * @param exclusive Whether the command must run alone on the board.
+ * @param priority The queue priority; higher is sent first.
+ * @return The future of the decoded reply.
+ */
+future<Reply> CLIENT::request(const string& command, unique_ptr<DECODER> decoder, bool exclusive, int priority) {
+	return request(command, vector<uint8_t>(), move(decoder), exclusive, priority);
+}
+
+/**
+ * @brief Queues a command followed by binary payload bytes.
+ *
+ * The payload is written together with the command line, without waiting for a ready line from the board.
+ *
+ * @param command The command line without line ending.
+ * @param payload The bytes sent right after the line ending.
+ * @param decoder The decoder of the reply.
+ * @param exclusive Whether the command must run alone on the board.
+ * @param priority The queue priority; higher is sent first.
+ * @return The future of the decoded reply.
+ */
+future<Reply> CLIENT::request(const string& command, const vector<uint8_t>& payload, unique_ptr<DECODER> decoder,
+                              bool exclusive, int priority) {
+	unique_ptr<Request> r(new Request());
+	r->bytes = command + "\r";
+	r->bytes.append(payload.begin(), payload.end());
+	r->decoder = move(decoder);
+	r->result = make_shared<promise<Reply> >();
+	r->exclusive = exclusive;
+	r->priority = priority;
+	r->reply.command = command;
+
+	future<Reply> result = r->result->get_future();
+	enqueue(move(r));
+	return result;
+}
+
+/**
+ * @brief Queues a command whose reply is passed to a callback.
+ *
+ * The callback runs on the reader thread and should return quickly; the next reply is not decoded until it does.
+ *
+ * @param command The command line without line ending.
+ * @param decoder The decoder of the reply.
+ * @param callback Called with the decoded reply.
+ * @param exclusive Whether the command must run alone on the board.
+ * @param priority The queue priority; higher is sent first.
+ */
+void CLIENT::request(const string& command, unique_ptr<DECODER> decoder, Callback callback, bool exclusive,
+                     int priority) {
+	request(command, vector<uint8_t>(), move(decoder), callback, exclusive, priority);
+}
+
+/**
+ * @brief Queues a command followed by binary payload bytes, whose reply is passed to a callback.
+ *
+ * @param command The command line without line ending.
+ * @param payload The bytes sent right after the line ending.
+ * @param decoder The decoder of the reply.
+ * @param callback Called with the decoded reply.
+ * @param exclusive Whether the command must run alone on the board.
+ * @param priority The queue priority; higher is sent first.
+ */
+void CLIENT::request(const string& command, const vector<uint8_t>& payload, unique_ptr<DECODER> decoder,
+                     Callback callback, bool exclusive, int priority) {
+	unique_ptr<Request> r(new Request());
+	r->bytes = command + "\r";
+	r->bytes.append(payload.begin(), payload.end());
+	r->decoder = move(decoder);
+	r->callback = callback;
+	r->exclusive = exclusive;
+	r->priority = priority;
+	r->reply.command = command;
+	enqueue(move(r));
+}
+
+/**
+ * @brief Queues a command with the decoder of its reply shape.
+ *
+ * With requestIds set, a command without an ID gets the next one.
+ *
+ * @param command The command line without line ending.
+ * @return The future of the decoded reply.
+ */
+future<Reply> CLIENT::send(const string& command) {
+	string line = (requestIds && command.compare(0, 1, "#") != 0) ? "#" + to_string(nextId++) + "," + command : command;
+	bool exclusive = false;
+	unique_ptr<DECODER> decoder = decoder_utils::forCommand(line, adcChannels, binaryRamps, syncedRamps, &exclusive);
+	syncedRamps = decoder_utils::syncAfter(line, syncedRamps);
+	return request(line, move(decoder), exclusive);
+}
+
+/**
+ * @brief Uploads a waveform table.
+ *
+ * Sends AWG_LOAD,channelMask,nPoints as an exclusive request; the table is written by the reader thread as soon as the
+ * board prints AWG_READY, as 3 bytes MSB first per code.
+ *
+ * @param channelMask The channels of the table, bit 0 for DAC 0.
+ * @param codes The table, one code per channel and point in ascending channel order.
+ * @return The future of the reply, whose last line is AWG_LOADED or an error.
+ */
+future<Reply> CLIENT::awgLoad(uint8_t channelMask, const vector<uint32_t>& codes) {
+	size_t channels = 0;
+	for (uint8_t j = 0; j < 4; j++) {
+		if (channelMask & (1 << j)) {channels++;}
+	}
+
+	vector<uint8_t> payload;
+	payload.reserve(3 * codes.size());
+	for (size_t c = 0; c < codes.size(); c++) {
+		payload.push_back((uint8_t) (codes[c] >> 16));
+		payload.push_back((uint8_t) (codes[c] >> 8));
+		payload.push_back((uint8_t) codes[c]);
+	}
+
+	size_t points = (channels > 0) ? codes.size() / channels : 0;
+	string command = "AWG_LOAD," + to_string(channelMask) + "," + to_string(points);
+	unique_ptr<DECODER> decoder = decoder_utils::upload("AWG_READY", payload, {"AWG_LOADED", "AWG TABLE TOO LARGE", "AWG LOAD TIMEOUT"});
+	if (requestIds) {
+		string id = to_string(nextId++);
+		command = "#" + id + "," + command;
+		decoder = decoder_utils::tagged(id, move(decoder));
+	}
+	return request(command, move(decoder), true);
+}
+
+/**
+ * @brief Runs a binary batch frame.
+ *
+ * Sends BATCH_BIN,nBytes with the frame appended as an exclusive request; the board runs it at once and replies with
+ * BATCH_BEGIN, the raw codes of its ADC scans and BATCH_DONE.
+ *
+ * @param frame The frame.
+ * @return The future of the reply, whose last line is BATCH_DONE or an error.
+ */
+future<Reply> CLIENT::batch(const BATCH_FRAME& frame) {
+	return framed("BATCH_BIN," + to_string(frame.bytes().size()), frame.bytes());
+}
+
+/**
+ * @brief Uploads a sequencer program.
+ *
+ * Sends SEQ_LOAD,nBytes with the program appended as an exclusive request; the board checks the program before keeping
+ * it. Run it with send("SEQ_RUN,...").
+ *
+ * @param program The bytecode, e.g. from sequence_utils::assemble.
+ * @return The future of the reply, whose last line is SEQ_LOADED or an error.
+ */
+future<Reply> CLIENT::sequenceLoad(const vector<uint8_t>& program) {
+	return framed("SEQ_LOAD," + to_string(program.size()), program);
+}
+
+/**
+ * @brief Queues a command whose frame follows the line ending, with the decoder of its reply shape.
+ *
+ * With requestIds set, the command gets the next ID.
+ *
+ * @param command The command line without line ending.
+ * @param frame The bytes sent right after the line ending.
+ * @return The future of the decoded reply.
+ */
+future<Reply> CLIENT::framed(string command, const vector<uint8_t>& frame) {
+	unique_ptr<DECODER> decoder = decoder_utils::forCommand(command, adcChannels, binaryRamps, syncedRamps, 0);
+	if (requestIds) {
+		string id = to_string(nextId++);
+		command = "#" + id + "," + command;
+		decoder = decoder_utils::tagged(id, move(decoder));
+	}
+	return request(command, frame, move(decoder), true);
+}
+
+/**
+ * @brief Adds a request to the send queue and wakes the writer.
+ *
+ * The request is queued behind every request of the same or a higher priority, so requests of one priority keep their
+ * order. Requests already in flight are not overtaken.
+ *
+ * @param request The request.
+ */
+void CLIENT::enqueue(unique_ptr<Request> request) {
+	{
+		lock_guard<mutex> guard(lock);
+		if (running) {
+			deque<unique_ptr<Request> >::iterator position = queued.end();
+			while (position != queued.begin() && (*(position - 1))->priority < request->priority) {position--;}
+			queued.insert(position, move(request));
+			request.reset();
+		}
+	}
+
+	if (request) {
+		request->reply.error = "closed";
+		complete(move(request));
+		return;
+	}
+	changed.notify_all();
+}
+
+/**
+ * @brief Returns whether a request may be written now. Called with 'lock' held.
+ *
+ * Requests are pipelined as long as the command bytes of all incomplete requests fit in kWindowBytes. An exclusive
+ * request waits for the board to be idle and blocks everything behind it until its reply is complete. A single command
+ * longer than the window is sent when nothing else is in flight.
+ *
+ * @param request The request at the head of the queue.
+ * @return True if the request can be written.
+ */
+bool CLIENT::canSend(const Request& request) {
+	if (inFlight.empty()) {return true;}
+	if (request.exclusive || inFlight.front()->exclusive) {return false;}
+	return inFlightBytes + request.bytes.size() <= kWindowBytes;
+}
+
+/**
+ * @brief Writes bytes to the port. Used by both threads and by callers forwarding an upload.
+ *
+ * @param data The bytes.
+ * @param size The number of bytes.
+ */
+void CLIENT::write(const uint8_t* data, size_t size) {
+	lock_guard<mutex> guard(writeLock);
+	port.write(data, size);
+}
+
+/**
+ * @brief Writer thread: sends queued commands as the window allows.
+ *
+ * A request is moved to the in-flight list before its bytes are written, so its reply can never arrive before the
+ * reader knows which decoder it belongs to.
+ */
+void CLIENT::writeLoop(void) {
+	while (true) {
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [this] { return !running || (!queued.empty() && canSend(*queued.front())); });
+		if (!running) {return;}
+
+		unique_ptr<Request> r = move(queued.front());
+		queued.pop_front();
+		r->sent = chrono::steady_clock::now();
+		inFlightBytes += r->bytes.size();
+		const string bytes = r->bytes;
+		inFlight.push_back(move(r));
+		guard.unlock();
+
+		write((const uint8_t*) bytes.data(), bytes.size());
+	}
+}
+
+/**
+ * @brief Reader thread: decodes replies in the order the commands were sent.
+ *
+ * Every chunk read from the port is fed to the decoder of the oldest in-flight request; when the decoder reports the
+ * reply complete, the request is removed, the window is released and its future or callback is completed, and the rest
+ * of the chunk goes to the next request. Bytes received while nothing is in flight are discarded. A hang-up of the port
+ * stops the client.
+ */
+void CLIENT::readLoop(void) {
+	vector<uint8_t> buffer(65536);
+
+	while (true) {
+		{
+			lock_guard<mutex> guard(lock);
+			if (!running) {return;}
+		}
+
+		long n = port.read(buffer.data(), buffer.size(), 50);
+		if (n < 0) {
+			{
+				lock_guard<mutex> guard(lock);
+				running = false;
+			}
+			changed.notify_all();
+			return;
+		}
+
+		size_t offset = 0;
+		while (offset < (size_t) n) {
+			Request* front = 0;
+			{
+				lock_guard<mutex> guard(lock);
+				if (!inFlight.empty()) {front = inFlight.front().get();}
+			}
+			if (!front) {break;}
+
+			size_t used = front->decoder->feed(buffer.data() + offset, n - offset, front->reply);
+			offset += used;
+
+			vector<uint8_t> outgoing = front->decoder->takeOutgoing();
+			if (!outgoing.empty()) {write(outgoing.data(), outgoing.size());}
+
+			if (!front->decoder->done()) {
+				if (used == 0) {break;}
+				continue;
+			}
+
+			unique_ptr<Request> finished;
+			{
+				lock_guard<mutex> guard(lock);
+				finished = move(inFlight.front());
+				inFlight.pop_front();
+				inFlightBytes -= finished->bytes.size();
+			}
+			changed.notify_all();
+			complete(move(finished));
+		}
+	}
+}
+
+/**
+ * @brief Completes a request with its reply.
+ *
+ * @param request The finished or failed request.
+ */
+void CLIENT::complete(unique_ptr<Request> request) {
+	request->reply.latencyUs = chrono::duration<double, micro>(chrono::steady_clock::now() - request->sent).count();
+	if (request->callback) {request->callback(request->reply);}
+	if (request->result) {request->result->set_value(move(request->reply));}
+}
+
+/**
+ * @brief Stops the client.
+ */
+CLIENT::~CLIENT() {
+	close();
+}
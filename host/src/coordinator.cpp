@@ -0,0 +1,192 @@
+#include "../include/coordinator.h"
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+using namespace std;
+
+uint8_t COORDINATOR::addBoard(const string& path, uint32_t baud, uint8_t adcChannels, bool binary) {
+	unique_ptr<CLIENT> client(new CLIENT());
+	if (client->open(path, baud) != 0) {return 1;}
+	client->adcChannels = adcChannels;
+	client->binaryRamps = binary;
+	clients.push_back(move(client));
+	return 0;
+}
+
+size_t COORDINATOR::boards(void) const {
+	return clients.size();
+}
+
+CLIENT& COORDINATOR::board(size_t index) {
+	return *clients[index];
+}
+
+void COORDINATOR::close(void) {
+	for (size_t b = 0; b < clients.size(); b++) {clients[b]->close();}
+	clients.clear();
+}
+
+/**
+ * @brief Sends a command to every board and waits for all replies.
+ *
+ * All commands are queued before the first reply is awaited, so the boards execute them concurrently.
+ *
+ * @param command The command line.
+ * @return The replies in board order.
+ */
+vector<Reply> COORDINATOR::broadcast(const string& command) {
+	vector<future<Reply> > results;
+	for (size_t b = 0; b < clients.size(); b++) {results.push_back(clients[b]->send(command));}
+
+	vector<Reply> replies;
+	for (size_t b = 0; b < results.size(); b++) {replies.push_back(results[b].get());}
+	return replies;
+}
+
+/**
+ * @brief Configures the shared sync line on every board.
+ *
+ * Sends RAMP_SYNC with drive set on the leader only. With pin -1 every board goes back to starting its ramps at once.
+ *
+ * @param pin The sync pin, the same on every board, or -1.
+ * @param edge The start edge: 0 rising, 1 falling, 2 any.
+ * @param timeoutMs The longest time a follower waits for the edge, 0 to wait forever.
+ * @param leader The board that produces the edge.
+ * @return 0 if every board replied RAMP SYNC, 1 otherwise.
+ */
+uint8_t COORDINATOR::setSync(int8_t pin, uint8_t edge, uint32_t timeoutMs, size_t leader) {
+	if (pin >= 0 && leader >= clients.size()) {return 1;}
+
+	vector<future<Reply> > results;
+	for (size_t b = 0; b < clients.size(); b++) {
+		string command = "RAMP_SYNC," + to_string(pin) + "," + to_string(edge) + "," + to_string(timeoutMs) + "," +
+		                 (pin >= 0 && b == leader ? "1" : "0");
+		results.push_back(clients[b]->send(command));
+	}
+
+	uint8_t status = 0;
+	for (size_t b = 0; b < results.size(); b++) {
+		Reply reply = results[b].get();
+		if (!reply.ok() || reply.lines.empty() || reply.lines[0].compare(0, 9, "RAMP SYNC") != 0) {status = 1;}
+	}
+	if (status == 0) {
+		syncPin = pin;
+		syncLeader = leader;
+	}
+	return status;
+}
+
+/**
+ * @brief Starts a ramp on every board together.
+ *
+ * Without a sync line, the commands are queued on all boards before any reply is awaited, so they start within the
+ * host's write latency of each other. With a sync line it works as follows:
+ *   1. Every follower gets its command with a synced decoder that records its SYNC_ARMED line. The ramps are
+ *      exclusive, since any byte written to a waiting follower aborts its wait.
+ *   2. Once all followers are armed the leader gets its command, and its edge starts every ramp at the same time.
+ *   3. If they are not all armed within armTimeoutMs, the leader is not started and every follower gets the abort
+ *      byte instead, so that none keeps waiting for an edge that will not come (a follower with a timeout of 0 would
+ *      wait forever). The followers report "sync timeout" and the leader "followers not armed".
+ *
+ * @param commands One command per board, or a single command for all boards.
+ * @param armTimeoutMs How long to wait for the followers to arm.
+ * @return The replies in board order.
+ */
+vector<Reply> COORDINATOR::start(const vector<string>& commands, uint32_t armTimeoutMs) {
+	vector<Reply> replies(clients.size());
+	if (commands.empty() || (commands.size() != 1 && commands.size() != clients.size())) {
+		for (size_t b = 0; b < replies.size(); b++) {replies[b].error = "one command per board expected";}
+		return replies;
+	}
+
+	vector<future<Reply> > results(clients.size());
+	if (syncPin < 0) {
+		for (size_t b = 0; b < clients.size(); b++) {
+			results[b] = clients[b]->send(commands[commands.size() == 1 ? 0 : b]);
+		}
+		for (size_t b = 0; b < clients.size(); b++) {replies[b] = results[b].get();}
+		return replies;
+	}
+
+	mutex lock;
+	condition_variable changed;
+	size_t armed = 0;
+	function<void()> onArmed = [&]() {
+		lock_guard<mutex> guard(lock);
+		armed++;
+		changed.notify_all();
+	};
+
+	for (size_t b = 0; b < clients.size(); b++) {
+		if (b == syncLeader) {continue;}
+		const string& command = commands[commands.size() == 1 ? 0 : b];
+		unique_ptr<DECODER> ramp = decoder_utils::forCommand(command, clients[b]->adcChannels, clients[b]->binaryRamps,
+		                                                     false, 0);
+		results[b] = clients[b]->request(command, decoder_utils::synced(move(ramp), onArmed), true);
+	}
+
+	bool allArmed;
+	{
+		unique_lock<mutex> guard(lock);
+		allArmed = changed.wait_for(guard, chrono::milliseconds(armTimeoutMs),
+		                            [&]() { return armed == clients.size() - 1; });
+	}
+
+	if (!allArmed) {
+		//Armed followers would wait for the leader's edge and late ones may arm at any time: abort them all
+		const uint8_t abort = '\r';
+		for (size_t b = 0; b < clients.size(); b++) {
+			if (b != syncLeader) {clients[b]->write(&abort, 1);}
+		}
+		for (size_t b = 0; b < clients.size(); b++) {
+			if (b != syncLeader) {replies[b] = results[b].get();}
+		}
+		replies[syncLeader].error = "followers not armed";
+		return replies;
+	}
+
+	const string& command = commands[commands.size() == 1 ? 0 : syncLeader];
+	CLIENT& leader = *clients[syncLeader];
+	unique_ptr<DECODER> ramp = decoder_utils::forCommand(command, leader.adcChannels, leader.binaryRamps, false, 0);
+	results[syncLeader] = leader.request(command, decoder_utils::synced(move(ramp), function<void()>()), true);
+
+	for (size_t b = 0; b < clients.size(); b++) {replies[b] = results[b].get();}
+	return replies;
+}
+
+/**
+ * @brief Merges the code streams of several boards by step index.
+ *
+ * Each board's stream holds adcChannels codes per step. The merged stream has one column per board and channel, named
+ * b<board>_adc<channel>, and as many rows as the shortest stream.
+ *
+ * @param replies The replies of start(), in board order.
+ * @return The merged stream.
+ */
+MergedStream COORDINATOR::merge(const vector<Reply>& replies) {
+	MergedStream merged;
+	size_t rows = SIZE_MAX;
+	for (size_t b = 0; b < replies.size() && b < clients.size(); b++) {
+		uint8_t channels = clients[b]->adcChannels;
+		for (uint8_t k = 0; k < channels; k++) {
+			merged.columns.push_back("b" + to_string(b) + "_adc" + to_string(k));
+		}
+		size_t n = channels ? replies[b].codes.size() / channels : 0;
+		if (n < rows) {rows = n;}
+	}
+	if (merged.columns.empty()) {return merged;}
+
+	merged.codes.resize(rows * merged.columns.size());
+	size_t column = 0;
+	for (size_t b = 0; b < replies.size() && b < clients.size(); b++) {
+		uint8_t channels = clients[b]->adcChannels;
+		for (size_t r = 0; r < rows; r++) {
+			for (uint8_t k = 0; k < channels; k++) {
+				merged.codes[r * merged.columns.size() + column + k] = replies[b].codes[r * channels + k];
+			}
+		}
+		column += channels;
+	}
+	return merged;
+}
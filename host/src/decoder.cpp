@@ -0,0 +1,827 @@
+#include "../include/decoder.h"
+#include "../include/unpack.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Returns whether a line starts with one of the prefixes.
+ *
+ * @param line The line to test.
+ * @param prefixes The candidate prefixes.
+ * @return True if a prefix matches.
+ */
+static bool startsWithAny(const string& line, const vector<string>& prefixes) {
+	for (size_t p = 0; p < prefixes.size(); p++) {
+		if (line.compare(0, prefixes[p].size(), prefixes[p]) == 0) {return true;}
+	}
+	return false;
+}
+
+/**
+ * @brief Accumulates one byte into a text line.
+ *
+ * Lines end with '\n'; a preceding '\r' (Serial.println writes "\r\n") is dropped.
+ *
+ * @param byte The received byte.
+ * @param current The partial line.
+ * @param line Receives the complete line.
+ * @return True if the byte completed a line.
+ */
+static bool pushLineByte(uint8_t byte, string& current, string& line) {
+	if (byte != '\n') {
+		current += (char) byte;
+		return false;
+	}
+	if (!current.empty() && current[current.size() - 1] == '\r') {current.erase(current.size() - 1);}
+	line.swap(current);
+	current.clear();
+	return true;
+}
+
+/**
+ * @brief Accumulates raw bytes into 24-bit codes.
+ *
+ * A code split across reads is completed byte by byte; the whole codes that follow are unpacked in bulk by
+ * unpack_utils::codes, and the bytes of a trailing incomplete code are kept in 'partial'.
+ *
+ * @param data The received bytes.
+ * @param size The number of bytes.
+ * @param partial The bytes of the incomplete code.
+ * @param count The number of bytes in 'partial'.
+ * @param reply The reply receiving complete codes.
+ */
+static void pushCodes(const uint8_t* data, size_t size, uint8_t partial[3], uint8_t& count, Reply& reply) {
+	size_t i = 0;
+	while (i < size && count > 0) {
+		partial[count++] = data[i++];
+		if (count == 3) {
+			reply.codes.push_back(((uint32_t) partial[0] << 16) | ((uint32_t) partial[1] << 8) | partial[2]);
+			count = 0;
+		}
+	}
+
+	size_t whole = (size - i) / 3;
+	if (whole > 0) {
+		size_t first = reply.codes.size();
+		reply.codes.resize(first + whole);
+		unpack_utils::codes(data + i, whole, (int32_t*) &reply.codes[first]);
+		i += 3 * whole;
+	}
+	while (i < size) {partial[count++] = data[i++];}
+}
+
+// A fixed number of lines.
+class LinesDecoder : public DECODER {
+	size_t remaining;
+	string current;
+public:
+	LinesDecoder(size_t count) : remaining(count) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t i = 0;
+		string line;
+		while (i < size && remaining > 0) {
+			if (pushLineByte(data[i++], current, line)) {
+				reply.lines.push_back(line);
+				remaining--;
+			}
+		}
+		return i;
+	}
+
+	bool done(void) const { return remaining == 0; }
+};
+
+// Lines up to an end line, then a fixed number of lines after it.
+class UntilDecoder : public DECODER {
+	vector<string> ends;
+	size_t trailing;
+	string current;
+	bool matched = false;
+public:
+	UntilDecoder(vector<string> endPrefixes) : ends(endPrefixes), trailing(0) {}
+	UntilDecoder(vector<string> endPrefixes, size_t lines) : ends(endPrefixes), trailing(lines) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t i = 0;
+		string line;
+		while (i < size && !done()) {
+			if (pushLineByte(data[i++], current, line)) {
+				reply.lines.push_back(line);
+				if (matched) {trailing--;}
+				else {matched = startsWithAny(line, ends);}
+			}
+		}
+		return i;
+	}
+
+	bool done(void) const { return matched && trailing == 0; }
+};
+
+// A known number of raw bytes, then lines up to an end line.
+class BinaryDecoder : public DECODER {
+	size_t remaining;
+	uint8_t partial[3];
+	uint8_t count = 0;
+	UntilDecoder trailer;
+public:
+	BinaryDecoder(size_t bytes, vector<string> endPrefixes) : remaining(bytes), trailer(endPrefixes) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		if (reply.codes.capacity() < remaining / 3) {reply.codes.reserve(remaining / 3);}
+		size_t i = (size < remaining) ? size : remaining;
+		pushCodes(data, i, partial, count, reply);
+		remaining -= i;
+		return i + trailer.feed(data + i, size - i, reply);
+	}
+
+	bool done(void) const { return remaining == 0 && trailer.done(); }
+};
+
+// A begin line carrying the sample count, the raw samples, then lines up to an end line.
+class CountedDecoder : public DECODER {
+	string begin;
+	vector<string> ends;
+	string current;
+	bool started = false;
+	bool finished = false;
+	size_t remaining = 0;
+	uint8_t partial[3];
+	uint8_t count = 0;
+public:
+	CountedDecoder(string beginPrefix, vector<string> endPrefixes) : begin(beginPrefix), ends(endPrefixes) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t i = 0;
+		string line;
+		while (i < size && !finished) {
+			if (started && remaining > 0) {
+				size_t n = (size - i < remaining) ? size - i : remaining;
+				pushCodes(data + i, n, partial, count, reply);
+				remaining -= n;
+				i += n;
+			}
+			else if (pushLineByte(data[i++], current, line)) {
+				reply.lines.push_back(line);
+				if (!started && line.compare(0, begin.size(), begin) == 0) {
+					vector<string> fields = decoder_utils::split(line);
+					size_t n = (fields.size() > 1) ? strtoul(fields[1].c_str(), 0, 10) : 0;
+					remaining = 3 * n;
+					reply.codes.reserve(n);
+					started = true;
+				}
+				else {
+					finished = startsWithAny(line, ends);
+				}
+			}
+		}
+		return i;
+	}
+
+	bool done(void) const { return finished; }
+};
+
+// Record count of a legacy stream whose length is not known in advance.
+static const size_t kAnyRecords = SIZE_MAX;
+
+// The legacy buffered ramp stream: per channel and point, b0 "_\r\n" b1 "_\r\n" b2 "_\r\n" followed by the voltage
+// printed with six decimals and no line ending. Debug lines of the firmware may appear between records.
+class LegacyDecoder : public DECODER {
+	size_t remaining;
+	vector<string> ends;
+	string pending;
+	bool text = false;
+	bool finished = false;
+	bool dot = false;
+	uint8_t decimals = 0;
+
+	// Whether the last byte of 'pending' keeps it a possible record.
+	bool consistent(void) {
+		size_t i = pending.size() - 1;
+		char c = pending[i];
+		if (i < 12) {
+			size_t k = i % 4;
+			if (k == 1) {return c == '_';}
+			if (k == 2) {return c == '\r';}
+			if (k == 3) {return c == '\n';}
+			return true;
+		}
+		if (i == 12 && c == '-') {return true;}
+		if (c == '.' && !dot && i > 12 && pending[i - 1] != '-') {
+			dot = true;
+			return true;
+		}
+		if (c >= '0' && c <= '9') {
+			if (dot) {decimals++;}
+			return true;
+		}
+		return false;
+	}
+
+	void emitLine(const string& line, Reply& reply) {
+		reply.lines.push_back(line);
+		if (startsWithAny(line, ends)) {finished = true;}
+	}
+
+	// Adds one byte to the pending record or text line.
+	void push(uint8_t byte, Reply& reply) {
+		pending += (char) byte;
+
+		if (text) {
+			if (byte == '\n') {
+				string line = pending.substr(0, pending.size() - 1);
+				if (!line.empty() && line[line.size() - 1] == '\r') {line.erase(line.size() - 1);}
+				pending.clear();
+				text = false;
+				emitLine(line, reply);
+			}
+			return;
+		}
+
+		if (remaining > 0 && consistent()) {
+			if (decimals == 6) {
+				reply.codes.push_back(((uint32_t) (uint8_t) pending[0] << 16) | ((uint32_t) (uint8_t) pending[4] << 8) |
+				                      (uint8_t) pending[8]);
+				reply.voltages.push_back(atof(pending.c_str() + 12));
+				pending.clear();
+				dot = false;
+				decimals = 0;
+				if (remaining != kAnyRecords) {remaining--;}
+			}
+			return;
+		}
+
+		//Not a record: the bytes so far start a text line, possibly an already complete one
+		dot = false;
+		decimals = 0;
+		size_t newline = pending.find('\n');
+		if (newline == string::npos) {
+			text = true;
+			return;
+		}
+
+		string line = pending.substr(0, newline);
+		if (!line.empty() && line[line.size() - 1] == '\r') {line.erase(line.size() - 1);}
+		string rest = pending.substr(newline + 1);
+		pending.clear();
+		emitLine(line, reply);
+
+		//Re-examine the bytes after the line ending
+		for (size_t r = 0; r < rest.size() && !finished; r++) {
+			push((uint8_t) rest[r], reply);
+		}
+	}
+
+public:
+	LegacyDecoder(size_t records, vector<string> endPrefixes) : remaining(records), ends(endPrefixes) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		if (remaining != kAnyRecords && reply.codes.capacity() < remaining) {
+			reply.codes.reserve(remaining);
+			reply.voltages.reserve(remaining);
+		}
+
+		size_t i = 0;
+		while (i < size && !finished) {
+			push(data[i++], reply);
+		}
+		return i;
+	}
+
+	bool done(void) const { return finished; }
+};
+
+// ADAPTIVE_BEGIN with the DAC and ADC channel counts, records of a 0x01 byte and the codes of a point, a 0x00 byte, then
+// lines up to ADAPTIVE_DONE.
+class AdaptiveDecoder : public DECODER {
+	string current;
+	bool started = false;
+	bool streaming = false;
+	bool rejected = false;
+	size_t recordBytes = 0;
+	size_t remaining = 0;
+	uint8_t partial[3];
+	uint8_t count = 0;
+	UntilDecoder trailer;
+public:
+	AdaptiveDecoder(void) : trailer({"ADAPTIVE_DONE"}) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t i = 0;
+		string line;
+		while (i < size && !done()) {
+			if (!started) {
+				if (!pushLineByte(data[i++], current, line)) {continue;}
+				reply.lines.push_back(line);
+				if (line.compare(0, 14, "ADAPTIVE_BEGIN") == 0) {
+					vector<string> fields = decoder_utils::split(line);
+					size_t dacs = (fields.size() > 1) ? strtoul(fields[1].c_str(), 0, 10) : 0;
+					size_t adcs = (fields.size() > 2) ? strtoul(fields[2].c_str(), 0, 10) : 0;
+					recordBytes = 3 * (dacs + adcs);
+					started = true;
+					streaming = true;
+				}
+				else {rejected = line.compare(0, 21, "INVALID ADAPTIVE RAMP") == 0;}
+			}
+			else if (streaming && remaining > 0) {
+				size_t n = (size - i < remaining) ? size - i : remaining;
+				pushCodes(data + i, n, partial, count, reply);
+				remaining -= n;
+				i += n;
+			}
+			else if (streaming) {
+				//Each record starts with 0x01; the 0x00 byte ends the records
+				if (data[i++] == 0x01) {remaining = recordBytes;}
+				else {streaming = false;}
+			}
+			else {
+				i += trailer.feed(data + i, size - i, reply);
+			}
+		}
+		return i;
+	}
+
+	bool done(void) const { return rejected || (started && !streaming && trailer.done()); }
+};
+
+// RASTER_BEGIN with the line count, the points per line and the ADC channel count, one frame per line of a 7-byte
+// header and the codes of its points, then lines up to RASTER_DONE.
+class RasterDecoder : public DECODER {
+	string current;
+	bool started = false;
+	bool rejected = false;
+	size_t frames = 0;
+	size_t frameBytes = 0;
+	size_t header = 0;
+	size_t remaining = 0;
+	uint8_t partial[3];
+	uint8_t count = 0;
+	UntilDecoder trailer;
+public:
+	RasterDecoder(void) : trailer({"RASTER_DONE"}) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t i = 0;
+		string line;
+		while (i < size && !done()) {
+			if (!started) {
+				if (!pushLineByte(data[i++], current, line)) {continue;}
+				reply.lines.push_back(line);
+				if (line.compare(0, 12, "RASTER_BEGIN") == 0) {
+					vector<string> fields = decoder_utils::split(line);
+					frames = (fields.size() > 1) ? strtoul(fields[1].c_str(), 0, 10) : 0;
+					size_t points = (fields.size() > 2) ? strtoul(fields[2].c_str(), 0, 10) : 0;
+					size_t channels = (fields.size() > 3) ? strtoul(fields[3].c_str(), 0, 10) : 0;
+					frameBytes = 3 * points * channels;
+					reply.codes.reserve(frames * points * channels);
+					started = true;
+				}
+				else {rejected = line.compare(0, 19, "INVALID RASTER AXES") == 0;}
+			}
+			else if (header > 0) {
+				size_t n = (size - i < header) ? size - i : header;
+				header -= n;
+				i += n;
+			}
+			else if (remaining > 0) {
+				size_t n = (size - i < remaining) ? size - i : remaining;
+				pushCodes(data + i, n, partial, count, reply);
+				remaining -= n;
+				i += n;
+			}
+			else if (frames > 0) {
+				header = 7;
+				remaining = frameBytes;
+				frames--;
+			}
+			else {
+				i += trailer.feed(data + i, size - i, reply);
+			}
+		}
+		return i;
+	}
+
+	bool done(void) const { return rejected || (started && frames == 0 && header == 0 && remaining == 0 && trailer.done()); }
+};
+
+// Lines until the board is ready for a payload, the payload, then lines up to an end line.
+class UploadDecoder : public DECODER {
+	string ready;
+	vector<uint8_t> payload;
+	UntilDecoder trailer;
+	bool sent = false;
+public:
+	UploadDecoder(string readyPrefix, vector<uint8_t> data, vector<string> endPrefixes)
+		: ready(readyPrefix), payload(data), trailer(endPrefixes) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t lines = reply.lines.size();
+		size_t used = trailer.feed(data, size, reply);
+		for (size_t l = lines; l < reply.lines.size() && !sent; l++) {
+			if (reply.lines[l].compare(0, ready.size(), ready) == 0) {sent = true;}
+		}
+		return used;
+	}
+
+	bool done(void) const { return trailer.done(); }
+
+	vector<uint8_t> takeOutgoing(void) {
+		vector<uint8_t> out;
+		if (sent && !payload.empty()) {out.swap(payload);}
+		return out;
+	}
+};
+
+// Lines up to SYNC_ARMED, the start status byte of a synchronized ramp, then the ramp's own reply, or after a '!'
+// status byte the lines up to SYNC TIMEOUT.
+class SyncedDecoder : public DECODER {
+	unique_ptr<DECODER> inner;
+	function<void()> armed;
+	string current;
+	bool waiting = true;
+	bool started = false;
+	bool aborted = false;
+	bool finished = false;
+public:
+	SyncedDecoder(unique_ptr<DECODER> ramp, function<void()> onArmed) : inner(move(ramp)), armed(onArmed) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t i = 0;
+		string line;
+		while (i < size && waiting) {
+			if (pushLineByte(data[i++], current, line)) {
+				reply.lines.push_back(line);
+				if (line.compare(0, 10, "SYNC_ARMED") == 0) {
+					waiting = false;
+					if (armed) {armed();}
+				}
+			}
+		}
+		if (!waiting && !started && !aborted && i < size) {
+			if (data[i++] == '+') {started = true;}
+			else {
+				reply.error = "sync timeout";
+				aborted = true;
+			}
+		}
+		while (aborted && !finished && i < size) {
+			if (pushLineByte(data[i++], current, line)) {
+				reply.lines.push_back(line);
+				finished = line.compare(0, 12, "SYNC TIMEOUT") == 0;
+			}
+		}
+		if (started && i < size) {i += inner->feed(data + i, size - i, reply);}
+		return i;
+	}
+
+	bool done(void) const { return finished || (started && inner->done()); }
+	vector<uint8_t> takeOutgoing(void) { return inner->takeOutgoing(); }
+};
+
+// The reply of another decoder, with every consumed byte also passed to a sink as it arrives.
+class RelayDecoder : public DECODER {
+	unique_ptr<DECODER> inner;
+	function<void(const uint8_t*, size_t)> sink;
+public:
+	RelayDecoder(unique_ptr<DECODER> reply, function<void(const uint8_t*, size_t)> bytes) : inner(move(reply)), sink(bytes) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t used = inner->feed(data, size, reply);
+		if (used > 0 && sink) {sink(data, used);}
+		return used;
+	}
+
+	bool done(void) const { return inner->done(); }
+	vector<uint8_t> takeOutgoing(void) { return inner->takeOutgoing(); }
+};
+
+// The reply of a command sent with a request ID: lines up to "@id,ACK", the stream of another decoder if the command has
+// one, then lines up to "@id,DONE,elapsed_us". The event lines are not stored in the reply.
+class TaggedDecoder : public DECODER {
+	string ack;
+	string completion;
+	unique_ptr<DECODER> stream;
+	chrono::steady_clock::time_point created = chrono::steady_clock::now();
+	string current;
+	bool acknowledged = false;
+	bool finished = false;
+public:
+	TaggedDecoder(const string& id, unique_ptr<DECODER> body) : ack("@" + id + ",ACK"), completion("@" + id + ",DONE,"),
+	                                                           stream(move(body)) {}
+
+	size_t feed(const uint8_t* data, size_t size, Reply& reply) {
+		size_t i = 0;
+		string line;
+		while (i < size && !finished) {
+			if (acknowledged && stream && !stream->done()) {
+				i += stream->feed(data + i, size - i, reply);
+				continue;
+			}
+			if (!pushLineByte(data[i++], current, line)) {continue;}
+
+			if (!acknowledged && line.compare(0, ack.size(), ack) == 0) {
+				acknowledged = true;
+				reply.id = ack.substr(1, ack.size() - 5);
+				reply.ackUs = chrono::duration<double, micro>(chrono::steady_clock::now() - created).count();
+			}
+			else if (acknowledged && line.compare(0, completion.size(), completion) == 0) {
+				reply.deviceUs = atof(line.c_str() + completion.size());
+				finished = true;
+			}
+			else {reply.lines.push_back(line);}
+		}
+		return i;
+	}
+
+	bool done(void) const { return finished; }
+	vector<uint8_t> takeOutgoing(void) { return stream ? stream->takeOutgoing() : vector<uint8_t>(); }
+};
+
+/**
+ * @brief Returns whether the reply of a command carries raw samples of a size known from the command or its reply.
+ *
+ * @param name The command name.
+ * @return True for sample streams.
+ */
+static bool hasStream(const string& name) {
+	return name == "BURST" || name == "TRIG_CAPTURE" || name == "TRIG_PIN_CAPTURE" || name == "BUFFER_RAMP" ||
+	       name == "SLEW_RAMP" || name == "ADAPTIVE_RAMP" || name == "PATH_RUN" || name == "RASTER" ||
+	       name == "BATCH_BIN" || name == "SEQ_RUN";
+}
+
+/**
+ * @brief Returns whether a command is a ramp that waits for the start edge once RAMP_SYNC has set a sync pin.
+ */
+static bool waitsForSync(const string& name) {
+	return name == "RAMP" || name == "BUFFER_RAMP";
+}
+
+/**
+ * @brief Returns whether AD5791::setVoltage writes a voltage, or rejects it with VOLTAGE OVERRANGE.
+ */
+static bool dacInRange(double voltage) {
+	return !(voltage < -10.0 || voltage > 10.0);
+}
+
+/**
+ * @brief Returns the number of lines printed by an unbuffered RAMP.
+ *
+ * RAMP prints its channels, vi and vf on three lines. Every voltage then goes through AD5791::setVoltage, which prints
+ * the four lines of setVoltageMsg followed by either the two lines of the written voltage or VOLTAGE OVERRANGE: first
+ * the initial voltage of each active channel, then at every step the voltage of each active channel, which
+ * simpleRampIteration follows with the voltage and the vReadings line. The step voltages are computed as on the board.
+ * Missing arguments are empty strings on the board, i.e. 0. This holds for one-way ramps; with RAMP_SWEEP set, RAMP
+ * prints the three argument lines only. With a sync line, the argument and initial voltage lines come before
+ * SYNC_ARMED and are read by synced(), so only the step lines are counted.
+ *
+ * @param fields The fields of the command line.
+ * @param sync Whether the ramp waits for a sync edge.
+ * @return The number of lines.
+ */
+static size_t rampLines(const vector<string>& fields, bool sync) {
+	double number[15] = {0};
+	for (size_t k = 1; k < 15 && k < fields.size(); k++) {number[k] = atof(fields[k].c_str());}
+
+	long steps = (fields.size() > 13) ? atol(fields[13].c_str()) : 0;
+	size_t count = sync ? 0 : 3;
+	for (int j = 0; j < 4; j++) {
+		if (fields.size() <= (size_t) j + 1 || atol(fields[j + 1].c_str()) != 1) {continue;}
+		double vi = number[j + 5];
+		double dv = (number[j + 9] - vi) / steps;
+		if (!sync) {count += dacInRange(vi) ? 6 : 5;}
+		for (long i = 0; i < steps; i++) {count += dacInRange(vi + ((i + 1) * dv)) ? 8 : 7;}
+	}
+	return count;
+}
+
+namespace decoder_utils {
+
+/**
+ * @brief Splits a line at ',' and ':' and removes spaces, like interface_utils::querySerial on the board.
+ *
+ * @param line The line to split.
+ * @return The fields.
+ */
+vector<string> split(const string& line) {
+	vector<string> fields(1);
+	for (size_t i = 0; i < line.size(); i++) {
+		char c = line[i];
+		if (c == ',' || c == ':') {fields.push_back("");}
+		else if (c != ' ' && c != '\r' && c != '\n') {fields.back() += c;}
+	}
+	return fields;
+}
+
+unique_ptr<DECODER> lines(size_t count) {
+	return unique_ptr<DECODER>(new LinesDecoder(count));
+}
+
+unique_ptr<DECODER> until(vector<string> endPrefixes) {
+	return unique_ptr<DECODER>(new UntilDecoder(endPrefixes));
+}
+
+unique_ptr<DECODER> until(vector<string> endPrefixes, size_t trailing) {
+	return unique_ptr<DECODER>(new UntilDecoder(endPrefixes, trailing));
+}
+
+unique_ptr<DECODER> binary(size_t bytes, vector<string> endPrefixes) {
+	return unique_ptr<DECODER>(new BinaryDecoder(bytes, endPrefixes));
+}
+
+unique_ptr<DECODER> counted(string beginPrefix, vector<string> endPrefixes) {
+	return unique_ptr<DECODER>(new CountedDecoder(beginPrefix, endPrefixes));
+}
+
+unique_ptr<DECODER> legacyRamp(size_t records, vector<string> endPrefixes) {
+	return unique_ptr<DECODER>(new LegacyDecoder(records, endPrefixes));
+}
+
+unique_ptr<DECODER> legacyRamp(vector<string> endPrefixes) {
+	return unique_ptr<DECODER>(new LegacyDecoder(kAnyRecords, endPrefixes));
+}
+
+unique_ptr<DECODER> adaptive(void) {
+	return unique_ptr<DECODER>(new AdaptiveDecoder());
+}
+
+unique_ptr<DECODER> raster(void) {
+	return unique_ptr<DECODER>(new RasterDecoder());
+}
+
+unique_ptr<DECODER> synced(unique_ptr<DECODER> ramp, function<void()> onArmed) {
+	return unique_ptr<DECODER>(new SyncedDecoder(move(ramp), onArmed));
+}
+
+unique_ptr<DECODER> relayed(unique_ptr<DECODER> reply, function<void(const uint8_t*, size_t)> sink) {
+	return unique_ptr<DECODER>(new RelayDecoder(move(reply), sink));
+}
+
+unique_ptr<DECODER> tagged(const string& id, unique_ptr<DECODER> stream) {
+	return unique_ptr<DECODER>(new TaggedDecoder(id, move(stream)));
+}
+
+unique_ptr<DECODER> upload(string readyPrefix, vector<uint8_t> payload, vector<string> endPrefixes) {
+	return unique_ptr<DECODER>(new UploadDecoder(readyPrefix, payload, endPrefixes));
+}
+
+/**
+ * @brief Chooses the decoder of a command line.
+ *
+ * Every command of the firmware's Router is listed here with the shape of its reply, including the debug lines of the
+ * driver code (DAC_WRITE prints the message bytes and the written voltage before its DAC # line, CONFIG_CHANNEL and
+ * DISABLE_ALL_CHANNELS the state of every channel); reset_adc, SETUP_CONFIG and the commands that only set a parameter
+ * answer with a single line. Buffered ramps are sized from their step count: (nSteps + 1) points of 'channels'
+ * readings, in the raw format when 'binary' is set and in the legacy format otherwise; both end with the SETTLE_JITTER
+ * line of the timing report. Slew ramps and paths stream legacy records until their end line, and an unbuffered RAMP,
+ * which has no end line, is counted line by line. Commands that stop on any received byte or read raw input from the
+ * port are marked exclusive.
+ *
+ * With 'sync' set, RAMP and BUFFER_RAMP print SYNC_ARMED and a status byte before their reply (see synced()). They are
+ * marked exclusive too: a follower gives up waiting for the start edge on any byte from the host, so nothing may be
+ * written behind them.
+ *
+ * A command line with a request ID ("#17,DAC_WRITE,0,1.5") is framed by its ACK and DONE events instead, so its reply
+ * may have any number of lines; the decoder of the command is kept only to size the raw samples of sample streams,
+ * which could otherwise contain the bytes of the DONE line, and to skip the status byte of synced ramps.
+ *
+ * @param line The command line.
+ * @param channels The number of enabled ADC channels.
+ * @param binary Whether buffered ramps stream raw codes.
+ * @param sync Whether ramps wait for a shared start edge (RAMP_SYNC with a pin).
+ * @param exclusive Receives whether the command must run alone. May be null.
+ * @return The decoder of the reply.
+ */
+unique_ptr<DECODER> forCommand(const string& line, uint8_t channels, bool binary, bool sync, bool* exclusive) {
+	vector<string> fields = split(line);
+	const string& name = fields[0];
+	bool alone = false;
+	unique_ptr<DECODER> decoder;
+
+	if (name.compare(0, 1, "#") == 0) {
+		size_t separator = line.find_first_of(",:");
+		string command = (separator == string::npos) ? string() : line.substr(separator + 1);
+		unique_ptr<DECODER> stream = forCommand(command, channels, binary, sync, exclusive);
+		string inner = split(command)[0];
+		if (!hasStream(inner) && !(sync && waitsForSync(inner))) {stream.reset();}
+		return tagged(name.substr(1), move(stream));
+	}
+
+	if (line.find(';') != string::npos) {
+		decoder = until({"BATCH_DONE", "INVALID BATCH COMMAND", "MESSAGE TOO LONG"});
+	}
+	else if (name == "DAC_WRITE" || name == "DAC_GET") {
+		//An out of range voltage prints VOLTAGE OVERRANGE in place of the written voltage, the DAC # line still follows
+		decoder = until({"DAC #"});
+	}
+	else if (name == "ADC_GET") {
+		decoder = until({"EndOfFullReading"});
+	}
+	else if (name == "CONFIG_CHANNEL") {
+		decoder = until({"Channel 15"}, 1);
+	}
+	else if (name == "ADC_CONFIG") {
+		decoder = until({"Setup config done"}, 1);
+	}
+	else if (name == "DISABLE_ALL_CHANNELS") {
+		//The state of channel 15, the 48 bytes sent and the result
+		decoder = until({"Channel 15"}, 50);
+	}
+	else if (name == "CONFIG_CHANNELS_TEST") {
+		decoder = until({"Reading channel 15"});
+	}
+	else if (name == "GETID") {
+		decoder = until({"ID code is"});
+	}
+	else if (name == "STATS?") {
+		decoder = until({"EndOfStats"});
+	}
+	else if (name == "BURST") {
+		decoder = counted("BURST_BEGIN", {"BURST_END"});
+	}
+	else if (name == "TRIG_CAPTURE" || name == "TRIG_PIN_CAPTURE") {
+		decoder = counted("TRIG_BEGIN", {"TRIG_END", "TRIG_TIMEOUT", "TRIG CHANNEL NOT ENABLED",
+		                                   "NO CHANNELS ENABLED"});
+	}
+	else if (name == "RAMP") {
+		decoder = lines(rampLines(fields, sync));
+	}
+	else if (name == "BUFFER_RAMP" && fields.size() > 13) {
+		size_t records = (strtoul(fields[13].c_str(), 0, 10) + 1) * channels;
+		if (binary) {decoder = decoder_utils::binary(3 * records, {"SETTLE_JITTER"});}
+		else {decoder = legacyRamp(records, {"SETTLE_JITTER", "INVALID TIMED OFFSET"});}
+	}
+	else if (name == "SLEW_RAMP") {
+		vector<string> ends = {"SETTLE_JITTER", "INVALID SLEW LIMITS", "INVALID SLEW START"};
+		if (fields.size() > 21 && atol(fields[21].c_str()) == 1) {decoder = legacyRamp(ends);}
+		else {decoder = until({"SLEW_RAMP", "INVALID SLEW LIMITS", "INVALID SLEW START"});}
+	}
+	else if (name == "ADAPTIVE_RAMP") {
+		decoder = adaptive();
+	}
+	else if (name == "PATH_RUN") {
+		decoder = legacyRamp({"PATH_DONE", "PATH NEEDS 2 VERTICES"});
+	}
+	else if (name == "RASTER") {
+		decoder = raster();
+	}
+	else if (name == "AWG_LOAD") {
+		decoder = until({"AWG_LOADED", "AWG TABLE TOO LARGE", "AWG LOAD TIMEOUT"});
+		alone = true;
+	}
+	else if (name == "AWG_RUN") {
+		decoder = until({"AWG_DONE", "AWG NOT READY"});
+		alone = true;
+	}
+	else if (name == "LOCKIN_RUN") {
+		decoder = until({"LOCKIN_DONE", "LOCKIN NOT CONFIGURED"});
+		alone = true;
+	}
+	else if (name == "BATCH_BIN") {
+		decoder = counted("BATCH_BEGIN", {"BATCH_DONE", "INVALID BATCH", "BATCH TIMEOUT"});
+		alone = true;
+	}
+	else if (name == "SEQ_LOAD") {
+		decoder = until({"SEQ_LOADED", "INVALID SEQ PROGRAM", "SEQ LOAD TIMEOUT"});
+		alone = true;
+	}
+	else if (name == "SEQ_RUN") {
+		decoder = counted("SEQ_BEGIN", {"SEQ_DONE", "SEQ NOT LOADED"});
+		alone = true;
+	}
+	else {
+		decoder = lines(1);
+	}
+
+	if (sync && waitsForSync(name)) {
+		decoder = synced(move(decoder), function<void()>());
+		alone = true;
+	}
+
+	if (exclusive) {*exclusive = alone;}
+	return decoder;
+}
+
+/**
+ * @brief Tracks whether ramps wait for a shared start edge.
+ *
+ * @param line A command line sent to the board.
+ * @param sync The state before the line.
+ * @return The state after the line: set by RAMP_SYNC with a pin and a valid edge, cleared by RAMP_SYNC with pin -1.
+ */
+bool syncAfter(const string& line, bool sync) {
+	vector<string> fields = split(line);
+	size_t name = (fields[0].compare(0, 1, "#") == 0) ? 1 : 0;
+	if (fields.size() <= name || fields[name] != "RAMP_SYNC") {return sync;}
+
+	//The firmware reads missing arguments as 0 and rejects an edge above 2 without changing its state
+	long pin = (fields.size() > name + 1) ? atol(fields[name + 1].c_str()) : 0;
+	long edge = (fields.size() > name + 2) ? atol(fields[name + 2].c_str()) : 0;
+	if (edge < 0 || edge > 2) {return sync;}
+	return pin >= 0;
+}
+
+}
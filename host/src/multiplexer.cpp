@@ -0,0 +1,473 @@
+#include "../include/multiplexer.h"
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * @brief Fills the address of a Unix socket.
+ *
+ * @return 0 if successful, 1 if the path does not fit.
+ */
+static uint8_t socketAddress(const string& path, struct sockaddr_un& address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {return 1;}
+	memcpy(address.sun_path, path.c_str(), path.size());
+	return 0;
+}
+
+/**
+ * @brief Returns where the arguments of an AWG_LOAD start, after the name and the request ID if any.
+ *
+ * @param fields The fields of a command line.
+ * @return The index of the channel mask, or 0 if the line is not a complete AWG_LOAD.
+ */
+static size_t isUpload(const vector<string>& fields) {
+	size_t name = (fields[0].compare(0, 1, "#") == 0) ? 1 : 0;
+	if (fields.size() < name + 3 || fields[name] != "AWG_LOAD") {return 0;}
+	return name + 1;
+}
+
+/**
+ * @brief Returns the frame length of a BATCH_BIN or SEQ_LOAD line, whose frame follows the line ending at once.
+ *
+ * @param fields The fields of a command line.
+ * @return The number of frame bytes, or 0 if the line carries no frame.
+ */
+static size_t frameLength(const vector<string>& fields) {
+	size_t name = (fields[0].compare(0, 1, "#") == 0) ? 1 : 0;
+	if (fields.size() < name + 2 || (fields[name] != "BATCH_BIN" && fields[name] != "SEQ_LOAD")) {return 0;}
+	return strtoul(fields[name + 1].c_str(), 0, 10);
+}
+
+/**
+ * @brief Returns the table length of an AWG_LOAD line, whose table follows once the board printed AWG_READY.
+ *
+ * @param fields The fields of a command line.
+ * @return The number of table bytes, 3 per point and channel, or 0 if the line is not an AWG_LOAD.
+ */
+static size_t tableLength(const vector<string>& fields) {
+	size_t first = isUpload(fields);
+	if (first == 0) {return 0;}
+	uint32_t mask = strtoul(fields[first].c_str(), 0, 10);
+	size_t channels = 0;
+	for (uint8_t j = 0; j < 4; j++) {
+		if (mask & (1 << j)) {channels++;}
+	}
+	return 3 * channels * strtoul(fields[first + 1].c_str(), 0, 10);
+}
+
+/**
+ * @brief Opens the board and the listening socket.
+ *
+ * A socket file left behind by a daemon that exited is removed; if a daemon still accepts connections on it the call
+ * fails, so two daemons never serve the same path.
+ *
+ * @param portPath The device path of the board.
+ * @param baud The baud rate.
+ * @param socketPath The path of the Unix socket to serve.
+ * @return 0 if successful, 1 if the port or the socket cannot be opened.
+ */
+uint8_t MULTIPLEXER::open(const string& portPath, uint32_t baud, const string& socketPath) {
+	close();
+
+	struct sockaddr_un address;
+	if (socketAddress(socketPath, address) != 0) {return 1;}
+
+	struct stat st;
+	if (stat(socketPath.c_str(), &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {return 1;}
+		int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		bool served = probe >= 0 && connect(probe, (struct sockaddr*) &address, sizeof(address)) == 0;
+		if (probe >= 0) {::close(probe);}
+		if (served) {return 1;}
+		unlink(socketPath.c_str());
+	}
+
+	if (client.open(portPath, baud) != 0) {return 1;}
+
+	listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 16) != 0 ||
+	    pipe2(wake, O_NONBLOCK | O_CLOEXEC) != 0) {
+		close();
+		return 1;
+	}
+	this->socketPath = socketPath;
+	stopping = false;
+	return 0;
+}
+
+/**
+ * @brief Serves the connections.
+ *
+ * A single thread polls the listening socket and every connection: it accepts connections, splits their input into
+ * command lines, queues them on the board and writes the buffered replies. Reply bytes are appended to the connection
+ * buffers by the client's reader thread, which wakes the loop through a pipe, so a slow connection never blocks the
+ * board.
+ *
+ * @return 0 after stop(), 1 if the board hung up.
+ */
+uint8_t MULTIPLEXER::run(void) {
+	while (!stopping) {
+		if (!client.isOpen()) {return 1;}
+
+		vector<shared_ptr<Session> > polled = sessions;
+		vector<struct pollfd> fds;
+		fds.push_back({wake[0], POLLIN, 0});
+		fds.push_back({listener, POLLIN, 0});
+		{
+			lock_guard<mutex> guard(lock);
+			for (size_t s = 0; s < polled.size(); s++) {
+				short events = POLLIN | (polled[s]->output.empty() ? 0 : POLLOUT);
+				fds.push_back({polled[s]->fd, events, 0});
+			}
+		}
+
+		if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) {return 1;}
+
+		char drain[64];
+		while (read(wake[0], drain, sizeof(drain)) > 0) {}
+		if (fds[1].revents & POLLIN) {accept();}
+
+		for (size_t s = 0; s < polled.size(); s++) {
+			short revents = fds[2 + s].revents;
+			if (revents & POLLIN) {receive(polled[s]);}
+			else if (revents & (POLLHUP | POLLERR)) {
+				lock_guard<mutex> guard(lock);
+				polled[s]->closed = true;
+			}
+			dispatch(polled[s]);
+			send(*polled[s]);
+			forwardUpload(*polled[s]);
+		}
+
+		lock_guard<mutex> guard(lock);
+		for (size_t s = sessions.size(); s-- > 0;) {
+			if (!sessions[s]->closed) {continue;}
+			::close(sessions[s]->fd);
+			sessions.erase(sessions.begin() + s);
+		}
+	}
+	return 0;
+}
+
+void MULTIPLEXER::stop(void) {
+	stopping = true;
+	notify();
+}
+
+/**
+ * @brief Closes the board, every connection and the socket.
+ *
+ * The board is closed first: its pending requests fail with "closed" while the connections still exist.
+ */
+void MULTIPLEXER::close(void) {
+	client.close();
+
+	{
+		lock_guard<mutex> guard(lock);
+		for (size_t s = 0; s < sessions.size(); s++) {::close(sessions[s]->fd);}
+		sessions.clear();
+	}
+
+	if (listener >= 0) {
+		::close(listener);
+		listener = -1;
+		unlink(socketPath.c_str());
+	}
+	for (uint8_t p = 0; p < 2; p++) {
+		if (wake[p] >= 0) {::close(wake[p]);}
+		wake[p] = -1;
+	}
+}
+
+/**
+ * @brief Accepts the waiting connections.
+ */
+void MULTIPLEXER::accept(void) {
+	while (true) {
+		int fd = accept4(listener, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {return;}
+		shared_ptr<Session> session = make_shared<Session>();
+		session->fd = fd;
+		lock_guard<mutex> guard(lock);
+		sessions.push_back(session);
+	}
+}
+
+/**
+ * @brief Reads the bytes a connection sent.
+ *
+ * Lines ending in '\r' or '\n' are commands; empty lines are ignored. After an AWG_LOAD the size of its table is taken
+ * as raw bytes instead, counted when the line is read so that the table is not parsed as text while the line waits
+ * behind a MUX_ command. End of file closes the connection.
+ *
+ * @param session The connection.
+ */
+void MULTIPLEXER::receive(const shared_ptr<Session>& session) {
+	char buffer[4096];
+
+	while (true) {
+		ssize_t n = recv(session->fd, buffer, sizeof(buffer), 0);
+		if (n < 0 && errno == EINTR) {continue;}
+		if (n < 0 && errno == EAGAIN) {return;}
+		if (n <= 0) {
+			lock_guard<mutex> guard(lock);
+			session->closed = true;
+			return;
+		}
+
+		size_t i = 0;
+		while (i < (size_t) n) {
+			{
+				lock_guard<mutex> guard(lock);
+				if (session->uploadBytes > 0) {
+					size_t take = (session->uploadBytes < n - i) ? session->uploadBytes : n - i;
+					session->upload.append(buffer + i, take);
+					session->uploadBytes -= take;
+					i += take;
+					continue;
+				}
+			}
+
+			if (session->frameBytes > 0) {
+				size_t take = (session->frameBytes < n - i) ? session->frameBytes : n - i;
+				session->frame.append(buffer + i, take);
+				session->frameBytes -= take;
+				i += take;
+				if (session->frameBytes == 0) {
+					session->lines.push_back(string());
+					session->lines.back().swap(session->frame);
+					dispatch(session);
+				}
+				continue;
+			}
+
+			char c = buffer[i++];
+			if (c != '\r' && c != '\n') {
+				session->input += c;
+				continue;
+			}
+			if (session->input.empty()) {continue;}
+
+			vector<string> fields = decoder_utils::split(session->input);
+			size_t frame = (c == '\r') ? frameLength(fields) : 0;
+			if (frame > 0) {
+				session->frame = session->input + "\r";
+				session->frameBytes = frame;
+				session->input.clear();
+				continue;
+			}
+			size_t table = tableLength(fields);
+			if (table > 0) {
+				lock_guard<mutex> guard(lock);
+				session->uploadBytes = table;
+				session->upload.clear();
+				session->uploadReply.clear();
+				session->uploadReady = false;
+			}
+			session->lines.push_back(string());
+			session->lines.back().swap(session->input);
+			dispatch(session);
+		}
+	}
+}
+
+/**
+ * @brief Handles the waiting command lines of a connection in order.
+ *
+ * Board commands are queued at once. A MUX_ command is handled only when the connection has no command pending on the
+ * board, so its reply and its effect (e.g. a new priority) come after the earlier commands; the lines behind it wait.
+ *
+ * @param session The connection.
+ */
+void MULTIPLEXER::dispatch(const shared_ptr<Session>& session) {
+	while (!session->lines.empty()) {
+		if (session->lines.front().compare(0, 4, "MUX_") == 0) {
+			lock_guard<mutex> guard(lock);
+			if (session->pending > 0) {return;}
+		}
+		string line;
+		line.swap(session->lines.front());
+		session->lines.pop_front();
+		command(session, line);
+	}
+}
+
+/**
+ * @brief Queues a command line of a connection on the board.
+ *
+ * The reply is decoded with the decoder chosen by decoder_utils::forCommand (with the current reply shape) to find where
+ * it ends, and its bytes are relayed to the connection unchanged. For AWG_LOAD the table bytes counted by receive() are
+ * held and sent once the board asks for it. A BATCH_BIN or SEQ_LOAD line arrives with its frame after a '\r', and
+ * both are sent in one write.
+ *
+ * @param session The connection.
+ * @param text The command line without line ending, or a BATCH_BIN or SEQ_LOAD line, '\r' and its frame.
+ */
+void MULTIPLEXER::command(const shared_ptr<Session>& session, const string& text) {
+	size_t end = text.find('\r');
+	string line = text.substr(0, end);
+	vector<uint8_t> payload;
+	if (end != string::npos) {payload.assign(text.begin() + end + 1, text.end());}
+
+	if (line.compare(0, 4, "MUX_") == 0) {
+		string reply = local(*session, line) + "\r\n";
+		lock_guard<mutex> guard(lock);
+		session->output += reply;
+		return;
+	}
+
+	bool exclusive = false;
+	unique_ptr<DECODER> decoder = decoder_utils::forCommand(line, adcChannels, binaryRamps, syncedRamps, &exclusive);
+	syncedRamps = decoder_utils::syncAfter(line, syncedRamps);
+
+	int priority;
+	{
+		lock_guard<mutex> guard(lock);
+		session->pending++;
+		priority = session->priority;
+	}
+
+	shared_ptr<Session> owner = session;
+	client.request(line, payload, decoder_utils::relayed(move(decoder), [this, owner](const uint8_t* data, size_t size) {
+		relay(owner, data, size);
+	}), [this, owner](Reply& reply) { finish(owner, reply); }, exclusive, priority);
+}
+
+/**
+ * @brief Answers a MUX_ command. Called when the connection has no command pending.
+ *
+ * @param session The connection.
+ * @param line The command line.
+ * @return The reply line.
+ */
+string MULTIPLEXER::local(Session& session, const string& line) {
+	vector<string> fields = decoder_utils::split(line);
+	const string& name = fields[0];
+	size_t queued = client.pending();
+
+	lock_guard<mutex> guard(lock);
+	if (name == "MUX_PRIORITY" && fields.size() >= 2) {
+		session.priority = atoi(fields[1].c_str());
+		return "MUX PRIORITY " + to_string(session.priority);
+	}
+	else if (name == "MUX_SHAPE" && fields.size() >= 3) {
+		int channels = atoi(fields[1].c_str());
+		int binary = atoi(fields[2].c_str());
+		if (channels < 1 || channels > 16 || binary < 0 || binary > 1) {return "INVALID MUX SHAPE";}
+		adcChannels = (uint8_t) channels;
+		binaryRamps = binary == 1;
+		return "MUX SHAPE " + to_string(channels) + " " + to_string(binary);
+	}
+	else if (name == "MUX_MONITOR" && fields.size() >= 2) {
+		session.monitor = atoi(fields[1].c_str()) != 0;
+		return session.monitor ? "MUX MONITOR ON" : "MUX MONITOR OFF";
+	}
+	else if (name == "MUX_STATUS") {
+		return "MUX STATUS," + to_string(sessions.size()) + "," + to_string(queued);
+	}
+	return "INVALID MUX COMMAND";
+}
+
+/**
+ * @brief Buffers reply bytes for the connection that sent the command and for every monitor. Runs on the reader thread.
+ *
+ * A connection whose backlog exceeds kMaxBacklogBytes is closed. While an AWG_LOAD waits for its table, the reply text
+ * is watched for AWG_READY.
+ *
+ * @param owner The connection that sent the command.
+ * @param data The reply bytes.
+ * @param size The number of bytes.
+ */
+void MULTIPLEXER::relay(const shared_ptr<Session>& owner, const uint8_t* data, size_t size) {
+	{
+		lock_guard<mutex> guard(lock);
+		if (!owner->closed) {
+			owner->output.append((const char*) data, size);
+			if (owner->output.size() > kMaxBacklogBytes) {owner->closed = true;}
+			if (owner->uploadBytes + owner->upload.size() > 0 && !owner->uploadReady) {
+				owner->uploadReply.append((const char*) data, size);
+				owner->uploadReady = owner->uploadReply.find("AWG_READY") != string::npos;
+			}
+		}
+		for (size_t s = 0; s < sessions.size(); s++) {
+			Session& monitor = *sessions[s];
+			if (!monitor.monitor || monitor.closed || sessions[s] == owner) {continue;}
+			monitor.output.append((const char*) data, size);
+			if (monitor.output.size() > kMaxBacklogBytes) {monitor.closed = true;}
+		}
+	}
+	notify();
+}
+
+/**
+ * @brief Records a completed command of a connection. Runs on the reader thread.
+ *
+ * @param owner The connection that sent the command.
+ * @param reply The decoded reply.
+ */
+void MULTIPLEXER::finish(const shared_ptr<Session>& owner, const Reply& reply) {
+	{
+		lock_guard<mutex> guard(lock);
+		owner->pending--;
+		if (isUpload(decoder_utils::split(reply.command)) > 0) {
+			owner->uploadBytes = 0;
+			owner->upload.clear();
+			owner->uploadReply.clear();
+			owner->uploadReady = false;
+		}
+	}
+	notify();
+}
+
+/**
+ * @brief Writes as much of a connection's buffered replies as its socket accepts.
+ *
+ * @param session The connection.
+ */
+void MULTIPLEXER::send(Session& session) {
+	lock_guard<mutex> guard(lock);
+	if (session.closed || session.output.empty()) {return;}
+
+	ssize_t n = ::send(session.fd, session.output.data(), session.output.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (n > 0) {session.output.erase(0, n);}
+	else if (n < 0 && errno != EAGAIN && errno != EINTR) {session.closed = true;}
+}
+
+/**
+ * @brief Sends the table bytes of an AWG_LOAD received so far, once the board printed AWG_READY.
+ *
+ * The AWG_LOAD is exclusive, so nothing else is in flight and the bytes can be written to the board directly.
+ *
+ * @param session The connection.
+ */
+void MULTIPLEXER::forwardUpload(Session& session) {
+	string bytes;
+	{
+		lock_guard<mutex> guard(lock);
+		if (!session.uploadReady || session.upload.empty()) {return;}
+		bytes.swap(session.upload);
+	}
+	client.write((const uint8_t*) bytes.data(), bytes.size());
+}
+
+/**
+ * @brief Wakes the poll loop. Only writes to a pipe, so it may be called from a signal handler.
+ */
+void MULTIPLEXER::notify(void) {
+	char c = 0;
+	if (wake[1] >= 0 && write(wake[1], &c, 1) < 0) {}
+}
+
+MULTIPLEXER::~MULTIPLEXER() {
+	close();
+}
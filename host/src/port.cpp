@@ -0,0 +1,176 @@
+#include "../include/port.h"
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * @brief Maps a baud rate to its termios constant.
+ *
+ * @param baud The baud rate.
+ * @return The termios speed, B115200 for rates that have no constant.
+ */
+static speed_t baudConstant(uint32_t baud) {
+	switch (baud) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 921600: return B921600;
+		default: return B115200;
+	}
+}
+
+/**
+ * @brief Opens and configures the device.
+ *
+ * The device is put in raw mode: no echo, no line editing, no translation of carriage returns, 8 data bits, no parity
+ * and no flow control, so the binary streams of the firmware arrive unchanged. Reads never block inside the driver;
+ * waiting is done with poll() in read().
+ *
+ * A Unix socket (the socket of od-daemon) is connected instead and used as a byte stream.
+ *
+ * @param path The device path, e.g. /dev/ttyACM0 or the slave side of a pseudo-terminal, or a Unix socket.
+ * @param baud The baud rate.
+ * @return 0 if successful, 1 if the device cannot be opened or configured.
+ */
+uint8_t PORT::open(const string& path, uint32_t baud) {
+	close();
+
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {return connect(path);}
+
+	fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0) {return 1;}
+
+	struct termios tty;
+	if (tcgetattr(fd, &tty) != 0) {
+		close();
+		return 1;
+	}
+
+	cfmakeraw(&tty);
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~CSTOPB;
+#ifdef CRTSCTS
+	tty.c_cflag &= ~CRTSCTS;
+#endif
+	tty.c_cc[VMIN] = 0;
+	tty.c_cc[VTIME] = 0;
+	cfsetispeed(&tty, baudConstant(baud));
+	cfsetospeed(&tty, baudConstant(baud));
+
+	if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+		close();
+		return 1;
+	}
+
+	tcflush(fd, TCIOFLUSH);
+	return 0;
+}
+
+/**
+ * @brief Connects to a Unix socket.
+ *
+ * @param path The socket path.
+ * @return 0 if successful, 1 if the path is too long or nothing listens on it.
+ */
+uint8_t PORT::connect(const string& path) {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {return 1;}
+	memcpy(address.sun_path, path.c_str(), path.size());
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {return 1;}
+	if (::connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+		close();
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Closes the device if it is open.
+ */
+void PORT::close(void) {
+	if (fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+}
+
+/**
+ * @brief Returns whether the device is open.
+ *
+ * @return True if the device is open.
+ */
+bool PORT::isOpen(void) const {
+	return fd >= 0;
+}
+
+/**
+ * @brief Writes all bytes to the device.
+ *
+ * Partial writes and EAGAIN are retried after waiting for the device to become writable.
+ *
+ * @param data The bytes to write.
+ * @param size The number of bytes.
+ * @return 0 if successful, 1 on error.
+ */
+uint8_t PORT::write(const uint8_t* data, size_t size) {
+	size_t written = 0;
+
+	while (written < size) {
+		ssize_t n = ::write(fd, data + written, size - written);
+		if (n > 0) {
+			written += n;
+		}
+		else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+			struct pollfd p = {fd, POLLOUT, 0};
+			poll(&p, 1, 100);
+		}
+		else {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Reads the bytes that are available, waiting up to a timeout for the first one.
+ *
+ * @param data The destination buffer.
+ * @param size The size of the buffer.
+ * @param timeoutMs The longest wait in milliseconds.
+ * @return The number of bytes read, 0 on timeout, -1 on error or hang-up.
+ */
+long PORT::read(uint8_t* data, size_t size, int timeoutMs) {
+	struct pollfd p = {fd, POLLIN, 0};
+	int ready = poll(&p, 1, timeoutMs);
+
+	if (ready == 0 || (ready < 0 && errno == EINTR)) {return 0;}
+	if (ready < 0) {return -1;}
+
+	ssize_t n = ::read(fd, data, size);
+	if (n > 0) {return n;}
+	if (n < 0 && (errno == EAGAIN || errno == EINTR)) {return 0;}
+	return (p.revents & POLLHUP) ? -1 : 0;
+}
+
+/**
+ * @brief Closes the device.
+ */
+PORT::~PORT() {
+	close();
+}
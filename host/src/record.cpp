@@ -0,0 +1,320 @@
+#include "../include/record.h"
+#include <stdint.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+namespace record_utils {
+
+size_t typeSize(ColumnType type) {
+	return (type == FLOAT64 || type == UINT64) ? 8 : 4;
+}
+
+const char* typeName(ColumnType type) {
+	switch (type) {
+		case INT32: return "int32";
+		case UINT32: return "uint32";
+		case FLOAT32: return "float32";
+		case FLOAT64: return "float64";
+		case UINT64: return "uint64";
+		default: return "?";
+	}
+}
+
+}
+
+/**
+ * @brief Writes a buffer at a file offset, retrying short writes.
+ *
+ * @return 0 if successful, 1 on error.
+ */
+static uint8_t writeAt(int fd, const void* data, size_t size, uint64_t offset) {
+	const uint8_t* p = (const uint8_t*) data;
+	while (size > 0) {
+		ssize_t n = pwrite(fd, p, size, offset);
+		if (n <= 0) {return 1;}
+		p += n;
+		size -= n;
+		offset += n;
+	}
+	return 0;
+}
+
+/**
+ * @brief Creates a recording.
+ *
+ * Lays out the chunk: the chunk header, then one 64-byte aligned block of chunkRows values per column; the chunk size
+ * is rounded up to whole pages so every chunk starts on a page boundary of the mapping. The header is written at once,
+ * with no chunks.
+ *
+ * @param path The file path.
+ * @param columns The column names (up to 23 characters) and types, at most kMaxColumns.
+ * @param configuration Free text stored in the header, e.g. the commands and channel setup of the acquisition.
+ * @param chunkRows The number of rows per chunk.
+ * @return 0 if successful, 1 if the layout does not fit or the file cannot be created.
+ */
+uint8_t RECORDER::create(const string& path, const vector<record_utils::Column>& columns, const string& configuration,
+                         uint32_t chunkRows) {
+	close();
+	if (columns.empty() || columns.size() > record_utils::kMaxColumns || chunkRows == 0) {return 1;}
+	if (record_utils::kConfigurationOffset + configuration.size() > record_utils::kHeaderBytes) {return 1;}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, record_utils::kMagic, sizeof(header.magic));
+	header.version = 1;
+	header.columnCount = columns.size();
+	header.chunkRows = chunkRows;
+	header.configurationBytes = configuration.size();
+
+	uint64_t offset = record_utils::kChunkHeaderBytes;
+	for (size_t c = 0; c < columns.size(); c++) {
+		if (columns[c].name.size() >= record_utils::kNameBytes) {return 1;}
+		strncpy(header.columns[c].name, columns[c].name.c_str(), record_utils::kNameBytes - 1);
+		header.columns[c].type = columns[c].type;
+		header.columns[c].offset = offset;
+		offset += (chunkRows * record_utils::typeSize(columns[c].type) + 63) & ~(uint64_t) 63;
+		if (offset > UINT32_MAX) {return 1;}
+	}
+	header.chunkBytes = (offset + 4095) & ~(uint64_t) 4095;
+
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {return 1;}
+
+	vector<uint8_t> block(record_utils::kHeaderBytes, 0);
+	memcpy(block.data(), &header, sizeof(header));
+	memcpy(block.data() + record_utils::kConfigurationOffset, configuration.data(), configuration.size());
+	if (writeAt(fd, block.data(), block.size(), 0) != 0) {
+		close();
+		return 1;
+	}
+
+	chunk.assign(header.chunkBytes, 0);
+	chunkFill = 0;
+	return 0;
+}
+
+/**
+ * @brief Rewrites the fixed part of the header with the current chunk and row counts.
+ */
+uint8_t RECORDER::writeHeader(void) {
+	return writeAt(fd, &header, sizeof(header), 0);
+}
+
+/**
+ * @brief Appends rows given column by column.
+ *
+ * The values are copied into the column blocks of the chunk buffer; every time the buffer is full it is written as the
+ * next chunk.
+ *
+ * @param rows The number of rows.
+ * @param values One pointer per column to 'rows' values of the column's type.
+ * @return 0 if successful, 1 if the recording is not open or a write fails.
+ */
+uint8_t RECORDER::append(size_t rows, const void* const* values) {
+	if (fd < 0) {return 1;}
+
+	size_t done = 0;
+	while (done < rows) {
+		size_t n = rows - done;
+		if (n > header.chunkRows - chunkFill) {n = header.chunkRows - chunkFill;}
+
+		for (uint32_t c = 0; c < header.columnCount; c++) {
+			size_t width = record_utils::typeSize((record_utils::ColumnType) header.columns[c].type);
+			memcpy(chunk.data() + header.columns[c].offset + chunkFill * width,
+			       (const uint8_t*) values[c] + done * width, n * width);
+		}
+		chunkFill += n;
+		done += n;
+
+		if (chunkFill == header.chunkRows && flush() != 0) {return 1;}
+	}
+	return 0;
+}
+
+/**
+ * @brief Writes the buffered rows as the next chunk and updates the header.
+ *
+ * A chunk written by flush() before it is full keeps its full size in the file; its header records how many rows are
+ * valid. The file header is rewritten after the chunk, so a reader never sees a count covering unwritten data.
+ *
+ * @return 0 if successful or if no rows are buffered, 1 if a write fails.
+ */
+uint8_t RECORDER::flush(void) {
+	if (fd < 0) {return 1;}
+	if (chunkFill == 0) {return 0;}
+
+	record_utils::ChunkHeader chunkHeader = {record_utils::kChunkMagic, chunkFill, header.rowCount};
+	memcpy(chunk.data(), &chunkHeader, sizeof(chunkHeader));
+
+	uint64_t offset = record_utils::kHeaderBytes + header.chunkCount * header.chunkBytes;
+	if (writeAt(fd, chunk.data(), chunk.size(), offset) != 0) {return 1;}
+
+	header.chunkCount++;
+	header.rowCount += chunkFill;
+	chunkFill = 0;
+	return writeHeader();
+}
+
+/**
+ * @brief Writes the buffered rows and closes the file.
+ *
+ * @return 0 if successful, 1 if the last write failed.
+ */
+uint8_t RECORDER::close(void) {
+	if (fd < 0) {return 0;}
+	uint8_t status = flush();
+	::close(fd);
+	fd = -1;
+	chunk.clear();
+	return status;
+}
+
+uint64_t RECORDER::rows(void) const {
+	return (fd < 0) ? 0 : header.rowCount + chunkFill;
+}
+
+RECORDER::~RECORDER() {
+	close();
+}
+
+/**
+ * @brief Maps a recording.
+ *
+ * Checks the magic, the column layout and the chunk headers. Chunks past the end of the file (a writer that stopped
+ * mid-chunk) are not counted.
+ *
+ * @param path The file path.
+ * @return 0 if successful, 1 if the file cannot be mapped or is not a valid recording.
+ */
+uint8_t RECORDING::open(const string& path) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {return 1;}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < record_utils::kHeaderBytes) {
+		::close(fd);
+		return 1;
+	}
+	void* mapping = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED) {return 1;}
+
+	base = (const uint8_t*) mapping;
+	size = st.st_size;
+	header = (const record_utils::FileHeader*) base;
+
+	if (memcmp(header->magic, record_utils::kMagic, sizeof(header->magic)) != 0 || header->columnCount == 0 ||
+	    header->columnCount > record_utils::kMaxColumns || header->chunkBytes == 0 ||
+	    record_utils::kConfigurationOffset + header->configurationBytes > record_utils::kHeaderBytes) {
+		close();
+		return 1;
+	}
+
+	for (uint32_t c = 0; c < header->columnCount; c++) {
+		const record_utils::ColumnHeader& column = header->columns[c];
+		size_t width = record_utils::typeSize((record_utils::ColumnType) column.type);
+		if (column.offset + (uint64_t) header->chunkRows * width > header->chunkBytes) {
+			close();
+			return 1;
+		}
+		record_utils::Column entry = {string(column.name, strnlen(column.name, record_utils::kNameBytes)),
+		                              (record_utils::ColumnType) column.type};
+		columnList.push_back(entry);
+	}
+	text.assign((const char*) base + record_utils::kConfigurationOffset, header->configurationBytes);
+
+	uint64_t available = (size - record_utils::kHeaderBytes) / header->chunkBytes;
+	chunkCount = (header->chunkCount < available) ? header->chunkCount : available;
+	for (uint64_t k = 0; k < chunkCount; k++) {
+		const record_utils::ChunkHeader* chunk =
+			(const record_utils::ChunkHeader*) (base + record_utils::kHeaderBytes + k * header->chunkBytes);
+		if (chunk->magic != record_utils::kChunkMagic || chunk->rows > header->chunkRows) {
+			chunkCount = k;
+			break;
+		}
+	}
+	return 0;
+}
+
+void RECORDING::close(void) {
+	if (base) {munmap((void*) base, size);}
+	base = 0;
+	size = 0;
+	header = 0;
+	columnList.clear();
+	text.clear();
+	chunkCount = 0;
+}
+
+const vector<record_utils::Column>& RECORDING::columns(void) const {
+	return columnList;
+}
+
+int RECORDING::column(const string& name) const {
+	for (size_t c = 0; c < columnList.size(); c++) {
+		if (columnList[c].name == name) {return (int) c;}
+	}
+	return -1;
+}
+
+const string& RECORDING::configuration(void) const {
+	return text;
+}
+
+uint64_t RECORDING::rows(void) const {
+	uint64_t total = 0;
+	for (uint64_t k = 0; k < chunkCount; k++) {total += chunkRows(k);}
+	return total;
+}
+
+uint64_t RECORDING::chunks(void) const {
+	return chunkCount;
+}
+
+uint32_t RECORDING::chunkRows(uint64_t chunk) const {
+	if (chunk >= chunkCount) {return 0;}
+	return ((const record_utils::ChunkHeader*) (base + record_utils::kHeaderBytes + chunk * header->chunkBytes))->rows;
+}
+
+/**
+ * @brief Returns the values of a column in one chunk.
+ *
+ * @param chunk The chunk index.
+ * @param column The column index.
+ * @return A pointer into the mapping, or 0 if the chunk or column does not exist.
+ */
+const void* RECORDING::data(uint64_t chunk, int column) const {
+	if (chunk >= chunkCount || column < 0 || (size_t) column >= columnList.size()) {return 0;}
+	return base + record_utils::kHeaderBytes + chunk * header->chunkBytes + header->columns[column].offset;
+}
+
+/**
+ * @brief Gathers a column across all chunks.
+ *
+ * @param column The column index.
+ * @param out Receives one value per row, converted to double.
+ */
+void RECORDING::read(int column, vector<double>& out) const {
+	out.clear();
+	if (column < 0 || (size_t) column >= columnList.size()) {return;}
+	out.reserve(rows());
+
+	for (uint64_t k = 0; k < chunkCount; k++) {
+		uint32_t n = chunkRows(k);
+		switch (columnList[column].type) {
+			case record_utils::INT32: out.insert(out.end(), data<int32_t>(k, column), data<int32_t>(k, column) + n); break;
+			case record_utils::UINT32: out.insert(out.end(), data<uint32_t>(k, column), data<uint32_t>(k, column) + n); break;
+			case record_utils::FLOAT32: out.insert(out.end(), data<float>(k, column), data<float>(k, column) + n); break;
+			case record_utils::FLOAT64: out.insert(out.end(), data<double>(k, column), data<double>(k, column) + n); break;
+			case record_utils::UINT64: out.insert(out.end(), data<uint64_t>(k, column), data<uint64_t>(k, column) + n); break;
+		}
+	}
+}
+
+RECORDING::~RECORDING() {
+	close();
+}
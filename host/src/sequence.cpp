@@ -0,0 +1,257 @@
+#include "../include/sequence.h"
+#include "../include/batch.h"
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Operand kinds: r register, d DAC channel, a ADC channel, i 32-bit immediate, k 20-bit DAC code, t jump target.
+struct Mnemonic {
+	const char* name;
+	sequence_utils::Opcode opcode;
+	const char* operands;
+};
+
+static const Mnemonic kMnemonics[] = {
+	{"halt", sequence_utils::HALT, ""},
+	{"dac_code", sequence_utils::DAC_CODE, "dk"},
+	{"ldac", sequence_utils::LDAC, ""},
+	{"adc_scan", sequence_utils::ADC_SCAN, ""},
+	{"delay_us", sequence_utils::DELAY_US, "i"},
+	{"set", sequence_utils::SET, "ri"},
+	{"add", sequence_utils::ADD, "ri"},
+	{"add_reg", sequence_utils::ADD_REG, "rr"},
+	{"sub_reg", sequence_utils::SUB_REG, "rr"},
+	{"mov", sequence_utils::MOV, "rr"},
+	{"adc_get", sequence_utils::ADC_GET, "ra"},
+	{"dac_reg", sequence_utils::DAC_REG, "dr"},
+	{"emit", sequence_utils::EMIT, "r"},
+	{"cmp", sequence_utils::CMP, "ri"},
+	{"jmp", sequence_utils::JMP, "t"},
+	{"jeq", sequence_utils::JEQ, "t"},
+	{"jne", sequence_utils::JNE, "t"},
+	{"jlt", sequence_utils::JLT, "t"},
+	{"jge", sequence_utils::JGE, "t"},
+	{"loop", sequence_utils::LOOP, "rt"},
+};
+
+struct Instruction {
+	const Mnemonic* mnemonic;
+	vector<string> operands;
+	size_t line;
+};
+
+static size_t operandBytes(char kind) {
+	switch (kind) {
+		case 'i': return 4;
+		case 'k': return 3;
+		case 't': return 2;
+		default: return 1;
+	}
+}
+
+static bool isName(const string& s) {
+	if (s.empty() || !(isalpha((unsigned char) s[0]) || s[0] == '_')) {return false;}
+	for (size_t i = 1; i < s.size(); i++) {
+		if (!(isalnum((unsigned char) s[i]) || s[i] == '_')) {return false;}
+	}
+	return true;
+}
+
+/**
+ * @brief Parses an integer that must fill the whole token.
+ */
+static bool parseInteger(const string& s, long long& value) {
+	if (s.empty()) {return false;}
+	char* end = 0;
+	value = strtoll(s.c_str(), &end, 0);
+	return *end == 0;
+}
+
+/**
+ * @brief Parses an immediate: an integer, dac(volts) or adc(volts).
+ */
+static bool parseImmediate(const string& s, long long& value) {
+	if (parseInteger(s, value)) {return true;}
+
+	bool dac = s.compare(0, 4, "dac(") == 0;
+	bool adc = s.compare(0, 4, "adc(") == 0;
+	if (!(dac || adc) || s[s.size() - 1] != ')') {return false;}
+
+	string number = s.substr(4, s.size() - 5);
+	char* end = 0;
+	double volts = strtod(number.c_str(), &end);
+	if (number.empty() || *end != 0) {return false;}
+	value = dac ? sequence_utils::dacCode(volts) : sequence_utils::adcCode(volts);
+	return true;
+}
+
+/**
+ * @brief Splits a source line into a label, a mnemonic and its operands, without comments.
+ *
+ * @return True if the line has a label.
+ */
+static bool tokenize(const string& line, string& label, vector<string>& tokens) {
+	string text = line.substr(0, line.find_first_of(";#"));
+
+	size_t colon = text.find(':');
+	bool labeled = colon != string::npos;
+	if (labeled) {
+		label = text.substr(0, colon);
+		label.erase(0, label.find_first_not_of(" \t"));
+		label.erase(label.find_last_not_of(" \t\r") + 1);
+		for (size_t i = 0; i < label.size(); i++) {label[i] = (char) tolower((unsigned char) label[i]);}
+		text = text.substr(colon + 1);
+	}
+
+	string token;
+	for (size_t i = 0; i <= text.size(); i++) {
+		char c = (i < text.size()) ? text[i] : ' ';
+		if (c == ' ' || c == '\t' || c == '\r' || c == ',') {
+			if (!token.empty()) {tokens.push_back(token);}
+			token.clear();
+		}
+		else {
+			token += (char) tolower((unsigned char) c);
+		}
+	}
+	return labeled;
+}
+
+static string at(size_t line, const string& reason) {
+	return "line " + to_string(line) + ": " + reason;
+}
+
+namespace sequence_utils {
+
+int32_t dacCode(double voltage) {
+	uint32_t code = BATCH_FRAME::voltageToCode(voltage);
+	return (code & 0x80000) ? (int32_t) code - 0x100000 : (int32_t) code;
+}
+
+int32_t adcCode(double voltage) {
+	double code = (voltage / 25 + 1) * 8388608;
+	if (code < 0) {code = 0;}
+	if (code > 16777215) {code = 16777215;}
+	return (int32_t) lround(code);
+}
+
+/**
+ * @brief Assembles a sequencer program.
+ *
+ * The first pass parses every line and places labels at the byte offset of the next instruction; the second pass
+ * encodes the instructions, operands MSB first, and resolves the jump targets.
+ *
+ * @param source The program text.
+ * @param program Receives the bytecode.
+ * @param error Set to the line and reason of the first error.
+ * @return 0 if successful, 1 otherwise.
+ */
+uint8_t assemble(const string& source, vector<uint8_t>& program, string& error) {
+	program.clear();
+	map<string, size_t> labels;
+	vector<Instruction> instructions;
+	size_t offset = 0;
+
+	size_t lineNumber = 0;
+	size_t begin = 0;
+	while (begin <= source.size()) {
+		size_t end = source.find('\n', begin);
+		if (end == string::npos) {end = source.size();}
+		string line = source.substr(begin, end - begin);
+		begin = end + 1;
+		lineNumber++;
+
+		string label;
+		vector<string> tokens;
+		if (tokenize(line, label, tokens)) {
+			if (!isName(label)) {
+				error = at(lineNumber, "invalid label '" + label + "'");
+				return 1;
+			}
+			if (labels.count(label)) {
+				error = at(lineNumber, "duplicate label '" + label + "'");
+				return 1;
+			}
+			labels[label] = offset;
+		}
+		if (tokens.empty()) {continue;}
+
+		const Mnemonic* mnemonic = 0;
+		for (size_t m = 0; m < sizeof(kMnemonics) / sizeof(kMnemonics[0]); m++) {
+			if (tokens[0] == kMnemonics[m].name) {mnemonic = &kMnemonics[m];}
+		}
+		if (!mnemonic) {
+			error = at(lineNumber, "unknown instruction '" + tokens[0] + "'");
+			return 1;
+		}
+
+		string kinds = mnemonic->operands;
+		if (tokens.size() - 1 != kinds.size()) {
+			error = at(lineNumber, string(mnemonic->name) + " takes " + to_string(kinds.size()) + " operands");
+			return 1;
+		}
+
+		Instruction instruction = {mnemonic, vector<string>(tokens.begin() + 1, tokens.end()), lineNumber};
+		instructions.push_back(instruction);
+		offset += 1;
+		for (size_t k = 0; k < kinds.size(); k++) {offset += operandBytes(kinds[k]);}
+	}
+
+	if (offset > kMaxProgramBytes) {
+		error = "program of " + to_string(offset) + " bytes exceeds " + to_string(kMaxProgramBytes);
+		return 1;
+	}
+
+	for (size_t n = 0; n < instructions.size(); n++) {
+		const Instruction& instruction = instructions[n];
+		string kinds = instruction.mnemonic->operands;
+		program.push_back(instruction.mnemonic->opcode);
+
+		for (size_t k = 0; k < kinds.size(); k++) {
+			const string& operand = instruction.operands[k];
+			long long value = 0;
+			bool valid = true;
+
+			if (kinds[k] == 'r') {
+				valid = operand.size() > 1 && operand[0] == 'r' && parseInteger(operand.substr(1), value) &&
+				        value >= 0 && value < kRegisters;
+			}
+			else if (kinds[k] == 'd') {
+				valid = parseInteger(operand, value) && value >= 0 && value <= 3;
+			}
+			else if (kinds[k] == 'a') {
+				valid = parseInteger(operand, value) && value >= 0 && value <= 15;
+			}
+			else if (kinds[k] == 'i') {
+				valid = parseImmediate(operand, value) && value >= INT32_MIN && value <= (long long) UINT32_MAX;
+			}
+			else if (kinds[k] == 'k') {
+				valid = parseImmediate(operand, value) && value >= -524288 && value <= 0xFFFFF;
+			}
+			else if (labels.count(operand)) {
+				value = labels[operand];
+			}
+			else {
+				valid = parseInteger(operand, value) && value >= 0 && value < (long long) offset;
+			}
+
+			if (!valid) {
+				error = at(instruction.line, "invalid operand '" + operand + "'");
+				program.clear();
+				return 1;
+			}
+
+			size_t bytes = operandBytes(kinds[k]);
+			if (kinds[k] == 'k') {value &= 0xFFFFF;}
+			for (size_t b = bytes; b-- > 0;) {program.push_back((uint8_t) ((uint64_t) value >> (8 * b)));}
+		}
+	}
+	return 0;
+}
+
+}
@@ -0,0 +1,258 @@
+#include "../include/unpack.h"
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UNPACK_X86 1
+#endif
+using namespace std;
+
+namespace unpack_utils {
+
+// Volts per code step: 25 V over 2^23 codes, exact in single precision
+static const float kVoltsPerCode = 25.0f / 8388608.0f;
+static const float kOffsetVolts = 25.0f;
+
+/**
+ * @brief Unpacks codes one at a time.
+ *
+ * @param data The packed codes, 3 bytes each, MSB first.
+ * @param count The number of codes.
+ * @param out Receives the codes.
+ */
+static void codesScalar(const uint8_t* data, size_t count, int32_t* out) {
+	for (size_t i = 0; i < count; i++, data += 3) {
+		out[i] = ((int32_t) data[0] << 16) | ((int32_t) data[1] << 8) | data[2];
+	}
+}
+
+/**
+ * @brief Maps codes to volts one at a time.
+ *
+ * Computes code * 25 / 2^23 - 25 in single precision, with the multiplication and subtraction rounded separately as
+ * in the vector paths, so every path returns identical results.
+ *
+ * @param data The packed codes, 3 bytes each, MSB first.
+ * @param count The number of codes.
+ * @param out Receives the voltages.
+ */
+static void voltagesScalar(const uint8_t* data, size_t count, float* out) {
+	for (size_t i = 0; i < count; i++, data += 3) {
+		int32_t code = ((int32_t) data[0] << 16) | ((int32_t) data[1] << 8) | data[2];
+		float scaled = (float) code * kVoltsPerCode;
+		out[i] = scaled - kOffsetVolts;
+	}
+}
+
+#ifdef UNPACK_X86
+
+/**
+ * @brief Spreads four packed codes of a 16-byte block into four 32-bit lanes.
+ *
+ * Bytes 3k to 3k + 2 of the block are moved to lane k in reverse order (little-endian), with a zero top byte.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i spread4(__m128i block) {
+	const __m128i order = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	return _mm_shuffle_epi8(block, order);
+}
+
+/**
+ * @brief Unpacks codes with SSSE3: eight codes per iteration from two overlapping 16-byte loads.
+ *
+ * Every load reads 4 bytes past the 12 it uses, so the last codes are left to the scalar loop.
+ *
+ * @return The number of codes converted.
+ */
+__attribute__((target("ssse3")))
+static size_t codesSsse3(const uint8_t* data, size_t count, int32_t* out) {
+	size_t i = 0;
+	for (; i + 10 <= count; i += 8) {
+		const uint8_t* p = data + 3 * i;
+		__m128i low = spread4(_mm_loadu_si128((const __m128i*) p));
+		__m128i high = spread4(_mm_loadu_si128((const __m128i*) (p + 12)));
+		_mm_storeu_si128((__m128i*) (out + i), low);
+		_mm_storeu_si128((__m128i*) (out + i + 4), high);
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t voltagesSsse3(const uint8_t* data, size_t count, float* out) {
+	const __m128 scale = _mm_set1_ps(kVoltsPerCode);
+	const __m128 offset = _mm_set1_ps(kOffsetVolts);
+	size_t i = 0;
+	for (; i + 10 <= count; i += 8) {
+		const uint8_t* p = data + 3 * i;
+		__m128i low = spread4(_mm_loadu_si128((const __m128i*) p));
+		__m128i high = spread4(_mm_loadu_si128((const __m128i*) (p + 12)));
+		_mm_storeu_ps(out + i, _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(low), scale), offset));
+		_mm_storeu_ps(out + i + 4, _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(high), scale), offset));
+	}
+	return i;
+}
+
+/**
+ * @brief Spreads eight packed codes of a 32-byte load into eight 32-bit lanes.
+ *
+ * The byte shuffle works within 128-bit halves, so the dwords are first permuted to put bytes 0 to 15 in the low half
+ * and bytes 12 to 27 in the high half; each half then holds four whole codes at offset 0.
+ */
+__attribute__((target("avx2")))
+static inline __m256i spread8(__m256i block) {
+	const __m256i halves = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i order = _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+	                                       2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	return _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(block, halves), order);
+}
+
+/**
+ * @brief Unpacks codes with AVX2: sixteen codes per iteration from two 32-byte loads.
+ *
+ * Every load reads 8 bytes past the 24 it uses, so the last codes are left to the scalar loop.
+ *
+ * @return The number of codes converted.
+ */
+__attribute__((target("avx2")))
+static size_t codesAvx2(const uint8_t* data, size_t count, int32_t* out) {
+	size_t i = 0;
+	for (; i + 19 <= count; i += 16) {
+		const uint8_t* p = data + 3 * i;
+		__m256i low = spread8(_mm256_loadu_si256((const __m256i*) p));
+		__m256i high = spread8(_mm256_loadu_si256((const __m256i*) (p + 24)));
+		_mm256_storeu_si256((__m256i*) (out + i), low);
+		_mm256_storeu_si256((__m256i*) (out + i + 8), high);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t voltagesAvx2(const uint8_t* data, size_t count, float* out) {
+	const __m256 scale = _mm256_set1_ps(kVoltsPerCode);
+	const __m256 offset = _mm256_set1_ps(kOffsetVolts);
+	size_t i = 0;
+	for (; i + 19 <= count; i += 16) {
+		const uint8_t* p = data + 3 * i;
+		__m256i low = spread8(_mm256_loadu_si256((const __m256i*) p));
+		__m256i high = spread8(_mm256_loadu_si256((const __m256i*) (p + 24)));
+		_mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(low), scale), offset));
+		_mm256_storeu_ps(out + i + 8, _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(high), scale), offset));
+	}
+	return i;
+}
+
+#endif
+
+/**
+ * @brief Returns the best instruction set of this processor.
+ *
+ * @return AVX2 or SSSE3 if the processor supports them, SCALAR otherwise or on non-x86 builds.
+ */
+Isa bestIsa(void) {
+#ifdef UNPACK_X86
+	static const Isa best = __builtin_cpu_supports("avx2") ? AVX2 : __builtin_cpu_supports("ssse3") ? SSSE3 : SCALAR;
+	return best;
+#else
+	return SCALAR;
+#endif
+}
+
+const char* isaName(Isa isa) {
+	switch (isa) {
+		case SCALAR: return "scalar";
+		case SSSE3: return "ssse3";
+		case AVX2: return "avx2";
+		default: return isaName(bestIsa());
+	}
+}
+
+/**
+ * @brief Resolves BEST and falls back to the best supported instruction set.
+ */
+static Isa resolve(Isa isa) {
+	Isa best = bestIsa();
+	return (isa == BEST || isa > best) ? best : isa;
+}
+
+/**
+ * @brief Unpacks packed codes into 32-bit integers.
+ *
+ * The vector path converts all but the last few codes; the scalar loop converts the rest, so no byte past the end of
+ * data is read.
+ *
+ * @param data The packed codes, 3 bytes each, MSB first.
+ * @param count The number of codes.
+ * @param out Receives count codes.
+ * @param isa The instruction set; unsupported ones fall back to the best supported.
+ */
+void codes(const uint8_t* data, size_t count, int32_t* out, Isa isa) {
+	size_t done = 0;
+#ifdef UNPACK_X86
+	isa = resolve(isa);
+	if (isa == AVX2) {done = codesAvx2(data, count, out);}
+	else if (isa == SSSE3) {done = codesSsse3(data, count, out);}
+#else
+	(void) isa;
+#endif
+	codesScalar(data + 3 * done, count - done, out + done);
+}
+
+/**
+ * @brief Unpacks packed codes into volts, (code / 2^23 - 1) * 25.
+ *
+ * @param data The packed codes, 3 bytes each, MSB first.
+ * @param count The number of codes.
+ * @param out Receives count voltages.
+ * @param isa The instruction set; unsupported ones fall back to the best supported.
+ */
+void voltages(const uint8_t* data, size_t count, float* out, Isa isa) {
+	size_t done = 0;
+#ifdef UNPACK_X86
+	isa = resolve(isa);
+	if (isa == AVX2) {done = voltagesAvx2(data, count, out);}
+	else if (isa == SSSE3) {done = voltagesSsse3(data, count, out);}
+#else
+	(void) isa;
+#endif
+	voltagesScalar(data + 3 * done, count - done, out + done);
+}
+
+/**
+ * @brief Splits a conversion into contiguous ranges, one per worker.
+ *
+ * The calling thread converts the last range while the other workers run, then joins them. Ranges are multiples of 64
+ * codes so that workers do not write to the same cache line.
+ *
+ * @param count The number of codes.
+ * @param threads The number of workers, 0 for one per hardware thread.
+ * @param convert Converts the codes [first, first + n).
+ */
+template <typename Convert>
+static void split(size_t count, unsigned threads, Convert convert) {
+	if (threads == 0) {threads = thread::hardware_concurrency();}
+	if (threads <= 1 || count < kParallelMinimum) {
+		convert(0, count);
+		return;
+	}
+
+	size_t chunk = ((count + threads - 1) / threads + 63) & ~(size_t) 63;
+	vector<thread> workers;
+	size_t first = 0;
+	while (first + chunk < count) {
+		workers.push_back(thread(convert, first, chunk));
+		first += chunk;
+	}
+	convert(first, count - first);
+	for (size_t w = 0; w < workers.size(); w++) {workers[w].join();}
+}
+
+void codesParallel(const uint8_t* data, size_t count, int32_t* out, unsigned threads, Isa isa) {
+	split(count, threads, [=](size_t first, size_t n) { codes(data + 3 * first, n, out + first, isa); });
+}
+
+void voltagesParallel(const uint8_t* data, size_t count, float* out, unsigned threads, Isa isa) {
+	split(count, threads, [=](size_t first, size_t n) { voltages(data + 3 * first, n, out + first, isa); });
+}
+
+}
@@ -0,0 +1,308 @@
+#include "../include/decoder.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+static int failures = 0;
+
+static void expect(bool condition, const string& what) {
+	if (!condition) {
+		fprintf(stderr, "FAIL: %s\n", what.c_str());
+		failures++;
+	}
+}
+
+/**
+ * @brief Feeds a byte stream to a decoder in reads of at most 'chunk' bytes, as the client's reader thread does.
+ *
+ * @param decoder The decoder.
+ * @param stream The received bytes.
+ * @param offset The position of the first byte of the reply in 'stream'; advanced past the consumed bytes.
+ * @param chunk The largest read.
+ * @param reply The reply being decoded.
+ * @return True if the decoder completed its reply.
+ */
+static bool decode(DECODER& decoder, const string& stream, size_t& offset, size_t chunk, Reply& reply) {
+	while (offset < stream.size() && !decoder.done()) {
+		size_t n = (stream.size() - offset < chunk) ? stream.size() - offset : chunk;
+		offset += decoder.feed((const uint8_t*) stream.data() + offset, n, reply);
+	}
+	return decoder.done();
+}
+
+static string lastLine(const Reply& reply) {
+	return reply.lines.empty() ? string() : reply.lines.back();
+}
+
+// Read sizes of every test: byte by byte, odd splits across line endings and codes, and the whole stream at once.
+static const size_t kChunks[] = {1, 2, 5, 64, 1 << 20};
+
+/**
+ * @brief A fixed number of lines stops at the last one and leaves the next reply untouched.
+ */
+static void testLines(void) {
+	const string stream = "DAC #0 | UPDATED TO 1.50000V\r\nREADY\r\nNOP\r\n";
+	for (size_t c = 0; c < sizeof(kChunks) / sizeof(kChunks[0]); c++) {
+		Reply reply;
+		size_t offset = 0;
+		unique_ptr<DECODER> decoder = decoder_utils::lines(2);
+		expect(decode(*decoder, stream, offset, kChunks[c], reply), "lines: done");
+		expect(reply.lines.size() == 2 && lastLine(reply) == "READY", "lines: line endings are dropped");
+		expect(stream.substr(offset) == "NOP\r\n", "lines: the next reply is not consumed");
+	}
+}
+
+/**
+ * @brief Lines up to an end line, with and without trailing lines.
+ */
+static void testUntil(void) {
+	const string stream = "configChannel 2\r\n16\r\nChannel 15\r\n0\r\nNOP\r\n";
+	for (size_t c = 0; c < sizeof(kChunks) / sizeof(kChunks[0]); c++) {
+		Reply reply;
+		size_t offset = 0;
+		unique_ptr<DECODER> decoder = decoder_utils::until({"Channel 15"}, 1);
+		expect(decode(*decoder, stream, offset, kChunks[c], reply), "until: done");
+		expect(reply.lines.size() == 4 && lastLine(reply) == "0", "until: the trailing line is part of the reply");
+		expect(stream.substr(offset) == "NOP\r\n", "until: the next reply is not consumed");
+
+		Reply first;
+		offset = 0;
+		decoder = decoder_utils::until({"16", "Channel"});
+		expect(decode(*decoder, stream, offset, kChunks[c], first), "until: done at the first end line");
+		expect(first.lines.size() == 2, "until: the first matching prefix ends the reply");
+	}
+}
+
+/**
+ * @brief A counted stream whose raw codes contain line endings.
+ */
+static void testCounted(void) {
+	const string stream = string("BURST_BEGIN,2,32768,1000.000\r\n") + string("\x0a\x0d\x0a\x12\x34\x56", 6) +
+	                      "\r\nBURST_END\r\nNOP\r\n";
+	for (size_t c = 0; c < sizeof(kChunks) / sizeof(kChunks[0]); c++) {
+		Reply reply;
+		size_t offset = 0;
+		unique_ptr<DECODER> decoder = decoder_utils::forCommand("BURST,2", 1, false, false, 0);
+		expect(decode(*decoder, stream, offset, kChunks[c], reply), "counted: done");
+		expect(reply.codes.size() == 2 && reply.codes[0] == 0x0a0d0a && reply.codes[1] == 0x123456, "counted: codes");
+		expect(lastLine(reply) == "BURST_END", "counted: end line");
+		expect(stream.substr(offset) == "NOP\r\n", "counted: the next reply is not consumed");
+	}
+
+	Reply timeout;
+	size_t offset = 0;
+	const string error = "TRIG_TIMEOUT\r\nNOP\r\n";
+	unique_ptr<DECODER> decoder = decoder_utils::forCommand("TRIG_CAPTURE,0,1.5,0,10,10,5", 1, false, false, 0);
+	expect(decode(*decoder, error, offset, 1, timeout), "counted: an end line before the begin line ends the reply");
+	expect(error.substr(offset) == "NOP\r\n", "counted: nothing after the error is consumed");
+}
+
+/**
+ * @brief Returns one record of the legacy buffered ramp stream.
+ */
+static string legacyRecord(uint32_t code, const string& voltage) {
+	string record;
+	for (int b = 2; b >= 0; b--) {
+		record += (char) (uint8_t) (code >> (8 * b));
+		record += "_\r\n";
+	}
+	return record + voltage;
+}
+
+/**
+ * @brief The legacy buffered ramp stream, with debug lines between records and record bytes that look like text.
+ */
+static void testLegacy(void) {
+	const string stream = "BeginningOfAdcMode\r\n" + legacyRecord(0x0a5f0d, "-1.234567") + "BeginningOfAdcMode\r\n" +
+	                      legacyRecord(0x800000, "0.000000") + "RAMP_DONE,1,0.000,0.000,0,0.000,0.000\r\n" +
+	                      "UPDATE_JITTER,1\r\nSETTLE_JITTER,2\r\nNOP\r\n";
+	for (size_t c = 0; c < sizeof(kChunks) / sizeof(kChunks[0]); c++) {
+		Reply reply;
+		size_t offset = 0;
+		unique_ptr<DECODER> decoder = decoder_utils::forCommand("BUFFER_RAMP,1,0,0,0,0,0,0,0,1,0,0,0,1,0", 1, false, false,
+		                                                        0);
+		expect(decode(*decoder, stream, offset, kChunks[c], reply), "legacy: done");
+		expect(reply.codes.size() == 2 && reply.codes[0] == 0x0a5f0d && reply.codes[1] == 0x800000, "legacy: codes");
+		expect(reply.voltages.size() == 2 && reply.voltages[0] == -1.234567, "legacy: voltages");
+		expect(reply.lines.size() == 5 && lastLine(reply).compare(0, 13, "SETTLE_JITTER") == 0, "legacy: text lines");
+		expect(stream.substr(offset) == "NOP\r\n", "legacy: the next reply is not consumed");
+
+		//The same stream without a known record count, as for slew ramps and paths
+		Reply any;
+		offset = 0;
+		decoder = decoder_utils::legacyRamp({"SETTLE_JITTER"});
+		expect(decode(*decoder, stream, offset, kChunks[c], any), "legacy: done without a record count");
+		expect(any.codes == reply.codes && any.lines == reply.lines, "legacy: same reply without a record count");
+	}
+}
+
+/**
+ * @brief Tagged replies: event lines are not stored, and a sample stream may contain the bytes of the DONE event.
+ */
+static void testTagged(void) {
+	const string text = "@7,ACK,DAC_WRITE\r\nsetVoltageMsg debugging: \r\nVOLTAGE OVERRANGE\r\n"
+	                    "DAC #0 | UPDATED TO 999.00000V\r\n@7,DONE,85\r\n@8,ACK,NOP\r\n";
+	const string stream = string("@9,ACK,BURST\r\nBURST_BEGIN,4,32768,1000.000\r\n\n@9,DONE,1\r\n\r\nBURST_END\r\n") +
+	                      "@9,DONE,310\r\nNOP\r\n";
+	for (size_t c = 0; c < sizeof(kChunks) / sizeof(kChunks[0]); c++) {
+		Reply reply;
+		size_t offset = 0;
+		unique_ptr<DECODER> decoder = decoder_utils::forCommand("#7,DAC_WRITE,0,99", 1, false, false, 0);
+		expect(decode(*decoder, text, offset, kChunks[c], reply), "tagged: done");
+		expect(reply.id == "7" && reply.deviceUs == 85, "tagged: id and device time");
+		expect(reply.lines.size() == 3 && lastLine(reply).compare(0, 5, "DAC #") == 0, "tagged: lines without events");
+		expect(text.substr(offset) == "@8,ACK,NOP\r\n", "tagged: the next reply is not consumed");
+
+		Reply burst;
+		offset = 0;
+		decoder = decoder_utils::forCommand("#9,BURST,4", 1, false, false, 0);
+		expect(decode(*decoder, stream, offset, kChunks[c], burst), "tagged stream: done");
+		expect(burst.codes.size() == 4 && burst.codes[0] == 0x0a4039, "tagged stream: raw bytes are codes");
+		expect(burst.deviceUs == 310 && lastLine(burst) == "BURST_END", "tagged stream: DONE after the stream");
+		expect(stream.substr(offset) == "NOP\r\n", "tagged stream: the next reply is not consumed");
+	}
+}
+
+/**
+ * @brief Ramps after RAMP_SYNC: lines up to SYNC_ARMED, the status byte, then the ramp or the SYNC TIMEOUT line.
+ */
+static void testSynced(void) {
+	const string aborted = "channelsDAC : 1, 0, 0, 0, \r\nSYNC_ARMED\r\n!SYNC TIMEOUT\r\nNOP\r\n";
+	const string started = "vi : 0.00, 0.00, 0.00, 0.00, \r\nSYNC_ARMED\r\n+BeginningOfAdcMode\r\n" +
+	                       legacyRecord(0x0a5f0d, "-1.234567") + "BeginningOfAdcMode\r\n" +
+	                       legacyRecord(0x800000, "0.000000") + "RAMP_DONE,1,0.000,0.000,0,0.000,0.000\r\nUPDATE_JITTER,1\r\nSETTLE_JITTER,2\r\nNOP\r\n";
+	for (size_t c = 0; c < sizeof(kChunks) / sizeof(kChunks[0]); c++) {
+		Reply reply;
+		size_t offset = 0;
+		bool exclusive = false;
+		unique_ptr<DECODER> decoder = decoder_utils::forCommand("RAMP,1,0,0,0,0,0,0,0,1,0,0,0,3,0", 1, false, true,
+		                                                        &exclusive);
+		expect(exclusive, "synced: exclusive");
+		expect(decode(*decoder, aborted, offset, kChunks[c], reply), "synced: done on SYNC TIMEOUT");
+		expect(reply.error == "sync timeout" && lastLine(reply) == "SYNC TIMEOUT", "synced: timeout reported");
+		expect(aborted.substr(offset) == "NOP\r\n", "synced: the next reply is not consumed after a timeout");
+
+		Reply ramp;
+		offset = 0;
+		decoder = decoder_utils::forCommand("BUFFER_RAMP,1,0,0,0,0,0,0,0,1,0,0,0,1,0", 1, false, true, 0);
+		expect(decode(*decoder, started, offset, kChunks[c], ramp), "synced: done");
+		expect(ramp.ok() && ramp.codes.size() == 2 && ramp.codes[1] == 0x800000, "synced: codes after the status byte");
+		expect(started.substr(offset) == "NOP\r\n", "synced: the next reply is not consumed");
+	}
+
+	expect(decoder_utils::syncAfter("#3,RAMP_SYNC,22,0,0,0", false), "synced: RAMP_SYNC with a pin");
+	expect(!decoder_utils::syncAfter("RAMP_SYNC,-1,0,0,0", true), "synced: RAMP_SYNC without a pin");
+	expect(decoder_utils::syncAfter("RAMP_SYNC,-1,3,0,0", true), "synced: an invalid edge keeps the state");
+	expect(decoder_utils::syncAfter("NOP", true), "synced: other commands keep the state");
+}
+
+/**
+ * @brief Reads a whole file.
+ */
+static bool readFile(const string& path, string& text) {
+	ifstream file(path.c_str(), ios::in | ios::binary);
+	if (!file) {return false;}
+	stringstream buffer;
+	buffer << file.rdbuf();
+	text = buffer.str();
+	return true;
+}
+
+struct Recorded {
+	const char* lastLine;
+	long codes;
+};
+
+// Expected end of every reply of replies.txt: the prefix of its last line and its number of codes (-1 to skip).
+static const Recorded kRecorded[] = {
+	{"0", 0},                          // ADC_CONFIG: the state of channel 15 and the result
+	{"DAC #0 | UPDATED TO 1.5", 0},    // DAC_WRITE: message bytes and written voltage first
+	{"DAC #1 | UPDATED TO 999", 0},    // DAC_WRITE out of range: VOLTAGE OVERRANGE, then the DAC # line
+	{"DAC #0 | LAST UPDATED", 0},
+	{"READY", 0},
+	{"ID code is", 0},
+	{"EndOfFullReading", 0},
+	{"0", 0},                          // CONFIG_CHANNEL: no end marker
+	{"vReadings[j]", 0},               // RAMP: counted line by line, the last step is out of range
+	{"BURST_END", 4},
+	{"SETTLE_JITTER", 4},              // BUFFER_RAMP: 3 steps of the legacy stream
+	{"SETTLE_JITTER", 5},              // SLEW_RAMP: 4 steps
+	{"ADAPTIVE_DONE", -1},
+	{"RASTER_DONE", 12},
+	{"TRIG CHANNEL NOT ENABLED", 0},
+	{"NOP", 0},
+};
+
+/**
+ * @brief Replays output recorded from od-emulator through the decoders chosen by forCommand.
+ *
+ * replies.bin holds everything the emulator sent for the commands of replies.txt, each sent after the previous reply,
+ * with ADC channel 0 enabled by the first command. Every reply must end on its own last line, so that pipelined
+ * replies are never attributed to the wrong request.
+ *
+ * @param directory The directory of replies.txt and replies.bin.
+ */
+static void testReplay(const string& directory) {
+	string commands;
+	string stream;
+	if (!readFile(directory + "/replies.txt", commands) || !readFile(directory + "/replies.bin", stream)) {
+		expect(false, "replay: cannot read " + directory + "/replies.txt and replies.bin");
+		return;
+	}
+
+	vector<string> lines;
+	stringstream text(commands);
+	for (string line; getline(text, line);) {
+		if (!line.empty()) {lines.push_back(line);}
+	}
+	expect(lines.size() == sizeof(kRecorded) / sizeof(kRecorded[0]), "replay: one expectation per command");
+
+	for (size_t c = 0; c < sizeof(kChunks) / sizeof(kChunks[0]); c++) {
+		size_t offset = 0;
+		for (size_t n = 0; n < lines.size() && n < sizeof(kRecorded) / sizeof(kRecorded[0]); n++) {
+			Reply reply;
+			unique_ptr<DECODER> decoder = decoder_utils::forCommand(lines[n], 1, false, false, 0);
+			bool done = decode(*decoder, stream, offset, kChunks[c], reply);
+			string last = lastLine(reply);
+			expect(done && last.compare(0, strlen(kRecorded[n].lastLine), kRecorded[n].lastLine) == 0,
+			       "replay: " + lines[n] + " ends on '" + last + "'");
+			expect(kRecorded[n].codes < 0 || (long) reply.codes.size() == kRecorded[n].codes,
+			       "replay: " + lines[n] + " decodes " + to_string(reply.codes.size()) + " codes");
+			if (lines[n].compare(0, 13, "ADAPTIVE_RAMP") == 0) {
+				vector<string> fields = decoder_utils::split(last);
+				expect(fields.size() > 1 && reply.codes.size() == 2 * strtoul(fields[1].c_str(), 0, 10),
+				       "replay: ADAPTIVE_RAMP decodes a DAC and an ADC code per point");
+			}
+		}
+		expect(offset == stream.size(), "replay: the recording ends with the last reply");
+	}
+}
+
+/**
+ * @brief Runs the decoder tests.
+ *
+ * @return 0 if every test passed, 1 otherwise.
+ */
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: decoder-test DIRECTORY   directory of replies.txt and replies.bin\n");
+		return 1;
+	}
+
+	testLines();
+	testUntil();
+	testCounted();
+	testLegacy();
+	testTagged();
+	testSynced();
+	testReplay(argv[1]);
+
+	printf("%s, %d failure%s\n", failures ? "FAILED" : "OK", failures, failures == 1 ? "" : "s");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+#include "../include/client.h"
+#include <stdint.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+struct Step {
+	const char* command;
+	const char* lastLine;
+};
+
+// Commands pipelined on the emulator and the prefix of the last line of each reply. Several print debug lines of the
+// driver code before their result, so a reply read with the wrong line count ends on another command's line.
+static const Step kSteps[] = {
+	{"ADC_CONFIG,0,1,0,0,16", "0"},
+	{"DAC_WRITE,0,1.5", "DAC #0 | UPDATED TO 1.5"},
+	{"DAC_WRITE,1,-11", "DAC #1 | UPDATED TO 999"},
+	{"*RDY?", "READY"},
+	{"DAC_GET,0", "DAC #0 | LAST UPDATED TO 1.5"},
+	{"GETID", "ID code is"},
+	{"CONFIG_CHANNEL,1,0,0,2,3", "0"},
+	{"RAMP,1,1,0,0,0,9,0,0,1,11,0,0,3,0", "vReadings[j]"},
+	{"ADC_GET", "EndOfFullReading"},
+	{"DISABLE_ALL_CHANNELS", "0"},
+	{"ADC_CONFIG,0,1,0,0,16", "0"},
+	{"BUFFER_RAMP,1,0,0,0,0,0,0,0,1,0,0,0,4,0", "SETTLE_JITTER"},
+	{"SLEW_RAMP,1,0,0,0,1,0,0,0,0,0,0,0,100,1,1,1,0.25,1,1,1,0", "SLEW_RAMP,4,"},
+	{"SLEW_RAMP,1,0,0,0,0.5,0,0,0,1,0,0,0,100,1,1,1,0.25,1,1,1,0", "INVALID SLEW START"},
+	{"PATH_CLEAR", "PATH CLEARED"},
+	{"PATH_ADD,0,0,0,0,0,0", "PATH VERTEX 1"},
+	{"PATH_ADD,1,0,0,0,3,0", "PATH VERTEX 2"},
+	{"PATH_RUN,1,0,0,0,0,1", "PATH_DONE,1,4,"},
+	{"ADAPTIVE_RAMP,1,0,0,0,-1,0,0,0,1,0,0,0,0.1,0.5,0.01,0", "ADAPTIVE_DONE"},
+	{"RASTER,0,-1,1,4,1,-1,1,3,10,0,1", "RASTER_DONE,3,"},
+	{"ATOMIC;DAC_WRITE,0,1.5;DAC_WRITE,1,-1.5;NOP", "BATCH_DONE,3,"},
+	{"DAC_WRITE,0,1;SEQ_LOAD,4", "INVALID BATCH COMMAND SEQ_LOAD"},
+	{"RAMP_SYNC,22,0,0,1", "RAMP SYNC ON"},
+	{"RAMP,1,1,0,0,0,9,0,0,1,11,0,0,3,0", "vReadings[j]"},
+	{"RAMP_SYNC,-1,0,0,0", "RAMP SYNC OFF"},
+	{"NOP", "NOP"},
+};
+
+/**
+ * @brief Starts od-emulator with its serial port linked to 'link'.
+ *
+ * @return The process ID, or -1 if the emulator cannot be started or its port does not appear within 5 s.
+ */
+static pid_t startEmulator(const string& emulator, const string& link) {
+	pid_t pid = fork();
+	if (pid < 0) {return -1;}
+	if (pid == 0) {
+		execl(emulator.c_str(), emulator.c_str(), "--link", link.c_str(), (char*) 0);
+		_exit(127);
+	}
+
+	struct stat info;
+	for (int wait = 0; wait < 500; wait++) {
+		if (stat(link.c_str(), &info) == 0) {return pid;}
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	kill(pid, SIGTERM);
+	waitpid(pid, 0, 0);
+	return -1;
+}
+
+/**
+ * @brief Pipelines every command of kSteps and checks where each reply ends.
+ *
+ * @param client The open client.
+ * @param ids Whether the commands carry request IDs.
+ * @return The number of failed commands.
+ */
+static int run(CLIENT& client, bool ids) {
+	client.requestIds = ids;
+	size_t n = sizeof(kSteps) / sizeof(kSteps[0]);
+	vector<future<Reply> > replies;
+	for (size_t s = 0; s < n; s++) {replies.push_back(client.send(kSteps[s].command));}
+
+	int failures = 0;
+	for (size_t s = 0; s < n; s++) {
+		if (replies[s].wait_for(chrono::seconds(10)) != future_status::ready) {
+			fprintf(stderr, "FAIL: %s%s: no reply\n", kSteps[s].command, ids ? " (ids)" : "");
+			return failures + (int) (n - s);
+		}
+		Reply reply = replies[s].get();
+		string last = reply.lines.empty() ? string() : reply.lines.back();
+		if (!reply.ok() || last.compare(0, strlen(kSteps[s].lastLine), kSteps[s].lastLine) != 0) {
+			fprintf(stderr, "FAIL: %s%s: ends on '%s' %s\n", kSteps[s].command, ids ? " (ids)" : "", last.c_str(),
+			        reply.error.c_str());
+			failures++;
+		}
+	}
+	return failures;
+}
+
+/**
+ * @brief Runs a program with the emulator's port as its first argument, e.g. "od-seq PORT --check".
+ *
+ * @param argv The program and its other arguments, null terminated.
+ * @param link The emulator's port.
+ * @return The number of failures: 0 if the program exited with status 0, 1 otherwise.
+ */
+static int runProgram(char** argv, const string& link) {
+	vector<char*> args(1, argv[0]);
+	args.push_back((char*) link.c_str());
+	for (char** arg = argv + 1; *arg; arg++) {args.push_back(*arg);}
+	args.push_back((char*) 0);
+
+	pid_t pid = fork();
+	if (pid < 0) {return 1;}
+	if (pid == 0) {
+		execv(args[0], args.data());
+		_exit(127);
+	}
+
+	int status = 0;
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "FAIL: %s\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Runs the pipelined command checks against od-emulator, with and without request IDs, or the given program.
+ *
+ * @return 0 if every reply ended where expected (or the program succeeded), 1 otherwise.
+ */
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: emulator-test OD_EMULATOR [PROGRAM ARGS...]   PROGRAM gets the port as first argument\n");
+		return 1;
+	}
+
+	char directory[] = "/tmp/od-emulator-test-XXXXXX";
+	if (!mkdtemp(directory)) {
+		perror("emulator-test: mkdtemp");
+		return 1;
+	}
+	string link = string(directory) + "/port";
+
+	pid_t emulator = startEmulator(argv[1], link);
+	if (emulator < 0) {
+		fprintf(stderr, "emulator-test: cannot start %s\n", argv[1]);
+		rmdir(directory);
+		return 1;
+	}
+
+	int failures = 0;
+	CLIENT client;
+	if (argc > 2) {
+		failures = runProgram(argv + 2, link);
+	}
+	else if (client.open(link, 115200) != 0) {
+		fprintf(stderr, "emulator-test: cannot open %s\n", link.c_str());
+		failures = 1;
+	}
+	else {
+		failures += run(client, false);
+		failures += run(client, true);
+		client.close();
+	}
+
+	kill(emulator, SIGTERM);
+	waitpid(emulator, 0, 0);
+	unlink(link.c_str());
+	rmdir(directory);
+
+	printf("%s, %d failure%s\n", failures ? "FAILED" : "OK", failures, failures == 1 ? "" : "s");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+#include "../include/client.h"
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Prints the usage of the benchmark driver.
+ */
+static void usage(void) {
+	fprintf(stderr,
+		"usage: od-bench PORT [options]\n"
+		"  -b, --baud RATE       baud rate (default 115200)\n"
+		"  -n, --count N         commands per latency and pipelining run (default 1000)\n"
+		"      --burst N         samples per BURST (default 10000, 0 to skip)\n"
+		"      --ramp N          steps of the pipelined BUFFER_RAMP (default 1000, 0 to skip)\n"
+		"      --batch N         DAC writes per batch run (default 16, 0 to skip)\n"
+		"Measures the round-trip latency of *RDY?, the pipelined command rate, the sustained\n"
+		"throughput of sample streams and the cost of DAC writes sent one by one or batched,\n"
+		"e.g. against od-emulator:\n"
+		"  od-emulator --link /tmp/od-dacadc & od-bench /tmp/od-dacadc\n");
+}
+
+/**
+ * @brief Returns the value at fraction q of sorted samples.
+ *
+ * @param sorted The samples in ascending order.
+ * @param q The quantile, 0 to 1.
+ * @return The sample at rank q * (size - 1).
+ */
+static double quantile(const vector<double>& sorted, double q) {
+	if (sorted.empty()) {return 0;}
+	return sorted[(size_t) (q * (sorted.size() - 1) + 0.5)];
+}
+
+/**
+ * @brief Returns the seconds elapsed since start.
+ */
+static double secondsSince(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Waits for a reply and reports a failed one.
+ *
+ * @param result The reply future.
+ * @param reply Set to the reply.
+ * @return 0 if the reply was received, 1 otherwise.
+ */
+static uint8_t await(future<Reply>& result, Reply& reply) {
+	reply = result.get();
+	if (reply.ok()) {return 0;}
+	fprintf(stderr, "od-bench: %s: %s\n", reply.command.c_str(), reply.error.c_str());
+	return 1;
+}
+
+/**
+ * @brief Measures the round-trip latency of sequential commands.
+ *
+ * Sends *RDY? count times, each after the previous reply, and prints the mean, median, 99th percentile and maximum of
+ * the time from writing the command to decoding its reply.
+ *
+ * @return 0 if every reply was received, 1 otherwise.
+ */
+static uint8_t latencyRun(CLIENT& client, uint32_t count) {
+	vector<double> latencies;
+	latencies.reserve(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		future<Reply> result = client.send("*RDY?");
+		Reply reply;
+		if (await(result, reply) != 0) {return 1;}
+		latencies.push_back(reply.latencyUs);
+	}
+
+	double sum = 0;
+	for (size_t i = 0; i < latencies.size(); i++) {sum += latencies[i];}
+	sort(latencies.begin(), latencies.end());
+	printf("LATENCY,*RDY?,%u,mean_us=%.1f,p50_us=%.1f,p99_us=%.1f,max_us=%.1f\n", count, sum / count,
+	       quantile(latencies, 0.5), quantile(latencies, 0.99), latencies.back());
+	return 0;
+}
+
+/**
+ * @brief Measures the rate of pipelined commands.
+ *
+ * Queues count *RDY? commands at once, so the client keeps its window of commands in flight, and prints the command
+ * rate from the first write to the last reply.
+ *
+ * @return 0 if every reply was received, 1 otherwise.
+ */
+static uint8_t pipelineRun(CLIENT& client, uint32_t count) {
+	vector<future<Reply> > results;
+	results.reserve(count);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; i++) {results.push_back(client.send("*RDY?"));}
+	for (uint32_t i = 0; i < count; i++) {
+		Reply reply;
+		if (await(results[i], reply) != 0) {return 1;}
+	}
+	double seconds = secondsSince(start);
+
+	printf("PIPELINE,*RDY?,%u,seconds=%.3f,commands_per_s=%.1f\n", count, seconds, count / seconds);
+	return 0;
+}
+
+/**
+ * @brief Measures the sustained throughput of a sample stream.
+ *
+ * Sends one stream command and prints the number of codes received, the elapsed time and the sample and payload rates
+ * (3 bytes per code).
+ *
+ * @return 0 if the reply was received, 1 otherwise.
+ */
+static uint8_t streamRun(CLIENT& client, const char* name, const string& command) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	future<Reply> result = client.send(command);
+	Reply reply;
+	if (await(result, reply) != 0) {return 1;}
+	double seconds = secondsSince(start);
+
+	size_t codes = reply.codes.size();
+	printf("STREAM,%s,%zu,seconds=%.3f,samples_per_s=%.1f,kbytes_per_s=%.1f\n", name, codes, seconds,
+	       codes / seconds, codes * 3 / seconds / 1000);
+	return 0;
+}
+
+/**
+ * @brief Measures count DAC writes sent one by one, as a text batch and as a binary batch.
+ *
+ * Each run writes the same voltages to DAC 0: count DAC_WRITE commands, each after the previous reply; one line of
+ * count DAC_WRITE commands separated by ';'; and one BATCH_BIN frame of count DAC_CODE and LDAC operations. Prints the
+ * time of each run from the first write to the last reply.
+ *
+ * @return 0 if every reply was received, 1 otherwise.
+ */
+static uint8_t batchRun(CLIENT& client, uint32_t count) {
+	vector<double> voltages;
+	for (uint32_t i = 0; i < count; i++) {voltages.push_back(-5 + 10.0 * i / count);}
+	Reply reply;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; i++) {
+		future<Reply> result = client.send("DAC_WRITE,0," + to_string(voltages[i]));
+		if (await(result, reply) != 0) {return 1;}
+	}
+	double seconds = secondsSince(start);
+	printf("BATCH,sequential,%u,seconds=%.4f,writes_per_s=%.1f\n", count, seconds, count / seconds);
+
+	string line;
+	for (uint32_t i = 0; i < count; i++) {line += (i ? ";DAC_WRITE,0," : "DAC_WRITE,0,") + to_string(voltages[i]);}
+	start = chrono::steady_clock::now();
+	future<Reply> text = client.send(line);
+	if (await(text, reply) != 0) {return 1;}
+	seconds = secondsSince(start);
+	printf("BATCH,text,%u,seconds=%.4f,writes_per_s=%.1f\n", count, seconds, count / seconds);
+
+	BATCH_FRAME frame;
+	for (uint32_t i = 0; i < count && frame.bytes().size() + 6 <= BATCH_FRAME::kMaxBytes; i++) {
+		frame.dacVoltage(0, voltages[i]).ldac();
+	}
+	size_t writes = frame.bytes().size() / 6;
+	start = chrono::steady_clock::now();
+	future<Reply> binary = client.batch(frame);
+	if (await(binary, reply) != 0) {return 1;}
+	seconds = secondsSince(start);
+	printf("BATCH,binary,%zu,seconds=%.4f,writes_per_s=%.1f\n", writes, seconds, writes / seconds);
+	return 0;
+}
+
+/**
+ * @brief Runs the latency, pipelining, stream and batch benchmarks against a board or the emulator.
+ *
+ * Before measuring, ADC channel 0 is enabled and pipelined (binary) buffered ramps are switched on. The firmware
+ * prints unframed debug output while configuring the ADC, so the configuration is sent together with *RDY? and the
+ * reply is read up to READY.
+ *
+ * @return 0 if every benchmark completed, 1 otherwise.
+ */
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		usage();
+		return 1;
+	}
+
+	string path = argv[1];
+	uint32_t baud = 115200;
+	uint32_t count = 1000;
+	uint32_t burst = 10000;
+	uint32_t ramp = 1000;
+	uint32_t batch = 16;
+
+	for (int a = 2; a < argc; a++) {
+		string arg = argv[a];
+		bool more = a + 1 < argc;
+		if ((arg == "-b" || arg == "--baud") && more) {baud = strtoul(argv[++a], 0, 10);}
+		else if ((arg == "-n" || arg == "--count") && more) {count = strtoul(argv[++a], 0, 10);}
+		else if (arg == "--burst" && more) {burst = strtoul(argv[++a], 0, 10);}
+		else if (arg == "--ramp" && more) {ramp = strtoul(argv[++a], 0, 10);}
+		else if (arg == "--batch" && more) {batch = strtoul(argv[++a], 0, 10);}
+		else {
+			usage();
+			return (arg == "-h" || arg == "--help") ? 0 : 1;
+		}
+	}
+
+	CLIENT client;
+	if (client.open(path, baud) != 0) {
+		fprintf(stderr, "od-bench: cannot open %s: %s\n", path.c_str(), strerror(errno));
+		return 1;
+	}
+	client.adcChannels = 1;
+	client.binaryRamps = true;
+
+	future<Reply> configured = client.request("ADC_CONFIG,0,1,0,0,16\rRAMP_PIPELINE,1\r*RDY?",
+	                                          decoder_utils::until({"READY"}), true);
+	Reply reply;
+	uint8_t status = await(configured, reply);
+
+	if (status == 0 && count) {
+		status |= latencyRun(client, count);
+		status |= pipelineRun(client, count);
+	}
+	if (status == 0 && burst) {
+		status |= streamRun(client, "BURST", "BURST," + to_string(burst));
+	}
+	if (status == 0 && ramp) {
+		status |= streamRun(client, "BUFFER_RAMP",
+		                    "BUFFER_RAMP,1,0,0,0,-5,0,0,0,5,0,0,0," + to_string(ramp) + ",0");
+	}
+
+	if (status == 0 && batch) {
+		status |= batchRun(client, batch);
+	}
+
+	client.close();
+	return status;
+}
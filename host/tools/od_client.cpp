@@ -0,0 +1,114 @@
+#include "../include/client.h"
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Prints the usage of the command line client.
+ */
+static void usage(void) {
+	fprintf(stderr,
+		"usage: od-client PORT [options] COMMAND...\n"
+		"  -b, --baud RATE       baud rate (default 115200)\n"
+		"  -c, --channels N      enabled ADC channels, sizes buffered ramp replies (default 1)\n"
+		"      --binary          buffered ramps stream raw codes (RAMP_PIPELINE or RAMP_TIMED on)\n"
+		"      --ids             tag every command with a request ID; replies are framed by the\n"
+		"                        board's ACK and DONE events\n"
+		"  -r, --repeat N        send the command list N times (default 1)\n"
+		"  -q, --quiet           print only the summary\n"
+		"Every COMMAND is queued at once and the replies are printed in order, e.g.\n"
+		"  od-client /dev/ttyACM0 \"*RDY?\" \"STATS?\"\n");
+}
+
+/**
+ * @brief Sends the commands given on the command line and prints their replies.
+ *
+ * All commands are queued before the first reply is awaited, so they are pipelined by the client. Each reply is
+ * printed with its latency and the number of decoded codes; the summary gives the total time and the command rate.
+ *
+ * @return 0 if every reply was received, 1 otherwise.
+ */
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		usage();
+		return 1;
+	}
+
+	string path = argv[1];
+	uint32_t baud = 115200;
+	uint32_t repeat = 1;
+	bool quiet = false;
+	CLIENT client;
+	vector<string> commands;
+
+	for (int a = 2; a < argc; a++) {
+		string arg = argv[a];
+		bool more = a + 1 < argc;
+		if ((arg == "-b" || arg == "--baud") && more) {baud = strtoul(argv[++a], 0, 10);}
+		else if ((arg == "-c" || arg == "--channels") && more) {client.adcChannels = (uint8_t) strtoul(argv[++a], 0, 10);}
+		else if (arg == "--binary") {client.binaryRamps = true;}
+		else if (arg == "--ids") {client.requestIds = true;}
+		else if ((arg == "-r" || arg == "--repeat") && more) {repeat = strtoul(argv[++a], 0, 10);}
+		else if (arg == "-q" || arg == "--quiet") {quiet = true;}
+		else if (arg == "-h" || arg == "--help") {
+			usage();
+			return 0;
+		}
+		else {commands.push_back(arg);}
+	}
+
+	if (commands.empty()) {
+		usage();
+		return 1;
+	}
+
+	if (client.open(path, baud) != 0) {
+		fprintf(stderr, "od-client: cannot open %s: %s\n", path.c_str(), strerror(errno));
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	vector<future<Reply> > replies;
+	for (uint32_t r = 0; r < repeat; r++) {
+		for (size_t c = 0; c < commands.size(); c++) {
+			replies.push_back(client.send(commands[c]));
+		}
+	}
+
+	int status = 0;
+	size_t codes = 0;
+	for (size_t r = 0; r < replies.size(); r++) {
+		Reply reply = replies[r].get();
+		codes += reply.codes.size();
+
+		if (!reply.ok()) {
+			fprintf(stderr, "%s: %s\n", reply.command.c_str(), reply.error.c_str());
+			status = 1;
+			continue;
+		}
+		if (quiet) {continue;}
+
+		if (reply.id.empty()) {printf("> %s  (%.1f us, %zu codes)\n", reply.command.c_str(), reply.latencyUs, reply.codes.size());}
+		else {
+			printf("> %s  (%.1f us, ack %.1f us, device %.0f us, %zu codes)\n", reply.command.c_str(), reply.latencyUs,
+			       reply.ackUs, reply.deviceUs, reply.codes.size());
+		}
+		for (size_t l = 0; l < reply.lines.size(); l++) {
+			printf("%s\n", reply.lines[l].c_str());
+		}
+	}
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	printf("%zu commands, %zu codes in %.3f s (%.1f commands/s)\n", replies.size(), codes, seconds,
+	       replies.size() / seconds);
+
+	client.close();
+	return status;
+}
@@ -0,0 +1,154 @@
+#include "../include/coordinator.h"
+#include "../include/record.h"
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Prints the usage of the coordinator.
+ */
+static void usage(void) {
+	fprintf(stderr,
+		"usage: od-coord [options] PORT... -- COMMAND...\n"
+		"  -b, --baud RATE       baud rate (default 115200)\n"
+		"  -c, --channels N      enabled ADC channels of every board (default 1)\n"
+		"      --binary          buffered ramps stream raw codes (RAMP_PIPELINE or RAMP_TIMED on)\n"
+		"      --sync PIN[,EDGE] start on a shared sync line wired to PIN of every board\n"
+		"                        (EDGE 0 rising, 1 falling, 2 any; default 0)\n"
+		"      --leader N        board that drives the sync line (default 0)\n"
+		"      --sync-timeout MS how long followers wait for the edge (default 10000)\n"
+		"  -o, --out FILE        write the merged stream to a columnar recording\n"
+		"Starts one ramp per board together (a single COMMAND is sent to every board) and merges\n"
+		"the ADC streams by step index, e.g.\n"
+		"  od-coord --binary --sync 22 /dev/ttyACM0 /dev/ttyACM1 -- \"BUFFER_RAMP,1,0,0,0,-1,0,0,0,1,0,0,0,1000,0\"\n");
+}
+
+/**
+ * @brief Writes a merged stream to a recording: the step index, then one code column per board and channel.
+ *
+ * @return 0 if successful, 1 otherwise.
+ */
+static uint8_t writeRecording(const string& file, const MergedStream& merged, const string& configuration) {
+	size_t rows = merged.rows();
+	size_t width = merged.columns.size();
+
+	vector<record_utils::Column> columns;
+	columns.push_back({"step", record_utils::UINT32});
+	vector<uint32_t> steps(rows);
+	for (size_t r = 0; r < rows; r++) {steps[r] = r;}
+
+	vector<vector<int32_t> > codes(width, vector<int32_t>(rows));
+	for (size_t c = 0; c < width; c++) {
+		columns.push_back({merged.columns[c] + "_code", record_utils::INT32});
+		for (size_t r = 0; r < rows; r++) {codes[c][r] = merged.codes[r * width + c];}
+	}
+
+	vector<const void*> values;
+	values.push_back(steps.data());
+	for (size_t c = 0; c < width; c++) {values.push_back(codes[c].data());}
+
+	RECORDER recorder;
+	if (recorder.create(file, columns, configuration) != 0) {return 1;}
+	if (recorder.append(rows, values.data()) != 0) {return 1;}
+	return recorder.close();
+}
+
+/**
+ * @brief Runs a coordinated ramp across boards.
+ *
+ * Opens every port, configures the sync line if one is given (or returns the boards to software start), starts the
+ * commands together, prints each board's reply status and the merged stream size, and optionally records the merged
+ * stream.
+ *
+ * @return 0 if every board completed its ramp, 1 otherwise.
+ */
+int main(int argc, char** argv) {
+	uint32_t baud = 115200;
+	uint8_t channels = 1;
+	bool binary = false;
+	int8_t syncPin = -1;
+	uint8_t syncEdge = 0;
+	size_t leader = 0;
+	uint32_t syncTimeoutMs = 10000;
+	string out;
+	vector<string> ports;
+	vector<string> commands;
+	bool commandList = false;
+
+	for (int a = 1; a < argc; a++) {
+		string arg = argv[a];
+		bool more = a + 1 < argc;
+		if (commandList) {commands.push_back(arg);}
+		else if (arg == "--") {commandList = true;}
+		else if ((arg == "-b" || arg == "--baud") && more) {baud = strtoul(argv[++a], 0, 10);}
+		else if ((arg == "-c" || arg == "--channels") && more) {channels = (uint8_t) strtoul(argv[++a], 0, 10);}
+		else if (arg == "--binary") {binary = true;}
+		else if (arg == "--sync" && more) {
+			vector<string> fields = decoder_utils::split(argv[++a]);
+			syncPin = (int8_t) atoi(fields[0].c_str());
+			if (fields.size() > 1) {syncEdge = (uint8_t) atoi(fields[1].c_str());}
+		}
+		else if (arg == "--leader" && more) {leader = strtoul(argv[++a], 0, 10);}
+		else if (arg == "--sync-timeout" && more) {syncTimeoutMs = strtoul(argv[++a], 0, 10);}
+		else if ((arg == "-o" || arg == "--out") && more) {out = argv[++a];}
+		else if (arg == "-h" || arg == "--help") {
+			usage();
+			return 0;
+		}
+		else if (arg[0] != '-') {ports.push_back(arg);}
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (ports.empty() || commands.empty() || channels == 0 ||
+	    (commands.size() != 1 && commands.size() != ports.size())) {
+		usage();
+		return 1;
+	}
+
+	COORDINATOR coordinator;
+	for (size_t p = 0; p < ports.size(); p++) {
+		if (coordinator.addBoard(ports[p], baud, channels, binary) != 0) {
+			fprintf(stderr, "od-coord: cannot open %s: %s\n", ports[p].c_str(), strerror(errno));
+			return 1;
+		}
+	}
+	if (coordinator.setSync(syncPin, syncEdge, syncTimeoutMs, leader) != 0) {
+		fprintf(stderr, "od-coord: a board rejected the sync configuration\n");
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<Reply> replies = coordinator.start(commands);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	int status = 0;
+	for (size_t b = 0; b < replies.size(); b++) {
+		printf("board %zu (%s): %zu codes, %.1f us%s%s\n", b, ports[b].c_str(), replies[b].codes.size(),
+		       replies[b].latencyUs, replies[b].ok() ? "" : ", error: ", replies[b].error.c_str());
+		if (!replies[b].ok()) {status = 1;}
+	}
+
+	MergedStream merged = coordinator.merge(replies);
+	printf("merged %zu steps x %zu channels in %.3f s\n", merged.rows(), merged.columns.size(), seconds);
+
+	if (!out.empty()) {
+		string configuration = "boards=" + to_string(ports.size()) + "\nadc_channels=" + to_string(channels) +
+		                       "\nsync_pin=" + to_string(syncPin) + "\nleader=" + to_string(leader) + "\n";
+		for (size_t c = 0; c < commands.size(); c++) {configuration += "command=" + commands[c] + "\n";}
+		if (writeRecording(out, merged, configuration) != 0) {
+			fprintf(stderr, "od-coord: cannot write %s\n", out.c_str());
+			status = 1;
+		}
+	}
+
+	coordinator.close();
+	return status;
+}
@@ -0,0 +1,74 @@
+#include "../include/multiplexer.h"
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+using namespace std;
+
+static MULTIPLEXER multiplexer;
+
+/**
+ * @brief Prints the usage of the daemon.
+ */
+static void usage(void) {
+	fprintf(stderr,
+		"usage: od-daemon PORT SOCKET [options]\n"
+		"  -b, --baud RATE       baud rate (default 115200)\n"
+		"  -c, --channels N      enabled ADC channels, sizes buffered ramp replies (default 1)\n"
+		"      --binary          buffered ramps stream raw codes (RAMP_PIPELINE or RAMP_TIMED on)\n"
+		"Owns the board on PORT and shares it with every process that opens SOCKET as its port,\n"
+		"e.g. od-client SOCKET \"MUX_PRIORITY,1\" \"BUFFER_RAMP,...\". MUX_SHAPE,channels,binary\n"
+		"changes the reply shape at run time.\n");
+}
+
+/**
+ * @brief Stops the daemon on SIGINT and SIGTERM.
+ */
+static void onSignal(int) {
+	multiplexer.stop();
+}
+
+/**
+ * @brief Serves the board on a Unix socket until interrupted.
+ *
+ * @return 0 when stopped by a signal, 1 if the board or the socket cannot be opened or the board hangs up.
+ */
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		usage();
+		return 1;
+	}
+
+	string path = argv[1];
+	string socketPath = argv[2];
+	uint32_t baud = 115200;
+
+	for (int a = 3; a < argc; a++) {
+		string arg = argv[a];
+		bool more = a + 1 < argc;
+		if ((arg == "-b" || arg == "--baud") && more) {baud = strtoul(argv[++a], 0, 10);}
+		else if ((arg == "-c" || arg == "--channels") && more) {multiplexer.adcChannels = (uint8_t) strtoul(argv[++a], 0, 10);}
+		else if (arg == "--binary") {multiplexer.binaryRamps = true;}
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (multiplexer.open(path, baud, socketPath) != 0) {
+		fprintf(stderr, "od-daemon: cannot serve %s on %s: %s\n", path.c_str(), socketPath.c_str(), strerror(errno));
+		return 1;
+	}
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	signal(SIGPIPE, SIG_IGN);
+	fprintf(stderr, "od-daemon: serving %s on %s\n", path.c_str(), socketPath.c_str());
+
+	uint8_t status = multiplexer.run();
+	if (status != 0) {fprintf(stderr, "od-daemon: lost %s\n", path.c_str());}
+	multiplexer.close();
+	return status;
+}
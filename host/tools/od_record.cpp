@@ -0,0 +1,189 @@
+#include "../include/client.h"
+#include "../include/record.h"
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Prints the usage of the recorder.
+ */
+static void usage(void) {
+	fprintf(stderr,
+		"usage: od-record PORT FILE [options] COMMAND\n"
+		"       od-record --info FILE [COLUMN...]\n"
+		"  -b, --baud RATE       baud rate (default 115200)\n"
+		"  -c, --channels N      enabled ADC channels (default 1)\n"
+		"      --binary          buffered ramps stream raw codes (RAMP_PIPELINE or RAMP_TIMED on)\n"
+		"      --chunk-rows N    rows per chunk (default 65536)\n"
+		"Runs COMMAND (a BUFFER_RAMP or another sample stream such as BURST) and writes its samples\n"
+		"to a columnar recording: step, nominal time_us and dacK_V of every ramped DAC, then one\n"
+		"column per ADC channel with the raw codes (adcK_code), plus the printed voltages (adcK_V)\n"
+		"of the legacy ramp stream.\n"
+		"--info prints the layout of a recording and statistics of the given columns.\n");
+}
+
+/**
+ * @brief Prints the layout of a recording and the minimum, mean and maximum of selected columns.
+ *
+ * @return 0 if the file is a recording, 1 otherwise.
+ */
+static int info(const string& path, const vector<string>& names) {
+	RECORDING recording;
+	if (recording.open(path) != 0) {
+		fprintf(stderr, "od-record: %s is not a recording\n", path.c_str());
+		return 1;
+	}
+
+	printf("rows %llu, chunks %llu\n", (unsigned long long) recording.rows(), (unsigned long long) recording.chunks());
+	printf("configuration: %s\n", recording.configuration().c_str());
+	for (size_t c = 0; c < recording.columns().size(); c++) {
+		printf("column %zu: %s %s\n", c, recording.columns()[c].name.c_str(),
+		       record_utils::typeName(recording.columns()[c].type));
+	}
+
+	int status = 0;
+	for (size_t n = 0; n < names.size(); n++) {
+		int column = recording.column(names[n]);
+		if (column < 0) {
+			fprintf(stderr, "od-record: no column %s\n", names[n].c_str());
+			status = 1;
+			continue;
+		}
+		vector<double> values;
+		recording.read(column, values);
+		if (values.empty()) {continue;}
+		double low = values[0], high = values[0], sum = 0;
+		for (size_t i = 0; i < values.size(); i++) {
+			if (values[i] < low) {low = values[i];}
+			if (values[i] > high) {high = values[i];}
+			sum += values[i];
+		}
+		printf("%s: min %.9g, mean %.9g, max %.9g\n", names[n].c_str(), low, sum / values.size(), high);
+	}
+	return status;
+}
+
+/**
+ * @brief Runs a sample stream command and records its samples.
+ *
+ * For BUFFER_RAMP the nominal DAC voltage of every ramped channel and the nominal time of each step (step * delay) are
+ * computed from the command, since the stream carries only the ADC samples. Samples arrive interleaved by ADC channel
+ * and are split into one column per channel.
+ *
+ * @return 0 if the reply was received and written, 1 otherwise.
+ */
+int main(int argc, char** argv) {
+	if (argc >= 3 && string(argv[1]) == "--info") {
+		return info(argv[2], vector<string>(argv + 3, argv + argc));
+	}
+	if (argc < 4) {
+		usage();
+		return 1;
+	}
+
+	string path = argv[1];
+	string file = argv[2];
+	uint32_t baud = 115200;
+	uint32_t chunkRows = 65536;
+	CLIENT client;
+	string command;
+
+	for (int a = 3; a < argc; a++) {
+		string arg = argv[a];
+		bool more = a + 1 < argc;
+		if ((arg == "-b" || arg == "--baud") && more) {baud = strtoul(argv[++a], 0, 10);}
+		else if ((arg == "-c" || arg == "--channels") && more) {client.adcChannels = (uint8_t) strtoul(argv[++a], 0, 10);}
+		else if (arg == "--binary") {client.binaryRamps = true;}
+		else if (arg == "--chunk-rows" && more) {chunkRows = strtoul(argv[++a], 0, 10);}
+		else if (command.empty() && arg[0] != '-') {command = arg;}
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (command.empty() || client.adcChannels == 0) {
+		usage();
+		return 1;
+	}
+
+	if (client.open(path, baud) != 0) {
+		fprintf(stderr, "od-record: cannot open %s: %s\n", path.c_str(), strerror(errno));
+		return 1;
+	}
+	Reply reply = client.send(command).get();
+	client.close();
+	if (!reply.ok()) {
+		fprintf(stderr, "od-record: %s: %s\n", command.c_str(), reply.error.c_str());
+		return 1;
+	}
+
+	uint8_t channels = client.adcChannels;
+	bool raw = !reply.codes.empty();
+	bool printed = !reply.voltages.empty();
+	size_t samples = raw ? reply.codes.size() : reply.voltages.size();
+	size_t rows = samples / channels;
+
+	vector<string> fields = decoder_utils::split(command);
+	bool ramp = fields[0] == "BUFFER_RAMP" && fields.size() >= 15;
+
+	vector<record_utils::Column> columns;
+	columns.push_back({"step", record_utils::UINT32});
+	vector<uint32_t> steps(rows);
+	for (size_t r = 0; r < rows; r++) {steps[r] = r;}
+
+	vector<double> times;
+	vector<vector<float> > dacs;
+	if (ramp) {
+		uint32_t nSteps = strtoul(fields[13].c_str(), 0, 10);
+		double delayUs = atof(fields[14].c_str()) * 1000;
+		columns.push_back({"time_us", record_utils::FLOAT64});
+		times.resize(rows);
+		for (size_t r = 0; r < rows; r++) {times[r] = r * delayUs;}
+
+		for (uint8_t d = 0; d < 4; d++) {
+			if (atoi(fields[1 + d].c_str()) == 0) {continue;}
+			double vi = atof(fields[5 + d].c_str());
+			double vf = atof(fields[9 + d].c_str());
+			columns.push_back({"dac" + to_string(d) + "_V", record_utils::FLOAT32});
+			dacs.push_back(vector<float>(rows));
+			for (size_t r = 0; r < rows; r++) {dacs.back()[r] = nSteps ? vi + (vf - vi) * r / nSteps : vi;}
+		}
+	}
+
+	vector<vector<int32_t> > codes(raw ? channels : 0, vector<int32_t>(rows));
+	vector<vector<float> > volts(printed ? channels : 0, vector<float>(rows));
+	for (uint8_t k = 0; raw && k < channels; k++) {
+		columns.push_back({"adc" + to_string(k) + "_code", record_utils::INT32});
+		for (size_t r = 0; r < rows; r++) {codes[k][r] = reply.codes[r * channels + k];}
+	}
+	for (uint8_t k = 0; printed && k < channels; k++) {
+		columns.push_back({"adc" + to_string(k) + "_V", record_utils::FLOAT32});
+		for (size_t r = 0; r < rows && r * channels + k < reply.voltages.size(); r++) {
+			volts[k][r] = reply.voltages[r * channels + k];
+		}
+	}
+
+	vector<const void*> values;
+	values.push_back(steps.data());
+	if (ramp) {values.push_back(times.data());}
+	for (size_t d = 0; d < dacs.size(); d++) {values.push_back(dacs[d].data());}
+	for (size_t k = 0; k < codes.size(); k++) {values.push_back(codes[k].data());}
+	for (size_t k = 0; k < volts.size(); k++) {values.push_back(volts[k].data());}
+
+	string configuration = "command=" + command + "\nadc_channels=" + to_string(channels) +
+	                       "\nbinary=" + (client.binaryRamps ? "1" : "0") + "\n";
+	RECORDER recorder;
+	if (recorder.create(file, columns, configuration, chunkRows) != 0 || recorder.append(rows, values.data()) != 0 ||
+	    recorder.close() != 0) {
+		fprintf(stderr, "od-record: cannot write %s: %s\n", file.c_str(), strerror(errno));
+		return 1;
+	}
+
+	printf("%zu rows, %zu columns written to %s\n", rows, columns.size(), file.c_str());
+	return 0;
+}
@@ -0,0 +1,253 @@
+#include "../include/client.h"
+#include "../include/sequence.h"
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Prints the usage of the sequencer tool.
+ */
+static void usage(void) {
+	fprintf(stderr,
+		"usage: od-seq PORT FILE [options]   assemble FILE, upload it and run it\n"
+		"       od-seq PORT --check [options] run the sequencer checks, e.g. against od-emulator\n"
+		"       od-seq --assemble FILE        print the bytecode of FILE\n"
+		"  -b, --baud RATE       baud rate (default 115200)\n"
+		"  -r, --registers LIST  initial values of r0, r1, ..., e.g. 100,-5000\n"
+		"      --volts           print emitted values as AD4115 voltages\n"
+		"Emitted values are printed one per line, sign-extended from 24 bits, followed by the\n"
+		"SEQ_DONE line of the board. The program syntax is described in include/sequence.h.\n");
+}
+
+/**
+ * @brief Reads a whole file.
+ *
+ * @return 0 if successful, 1 if the file cannot be read.
+ */
+static uint8_t readFile(const string& path, string& text) {
+	ifstream file(path.c_str(), ios::in | ios::binary);
+	if (!file) {return 1;}
+	stringstream buffer;
+	buffer << file.rdbuf();
+	text = buffer.str();
+	return 0;
+}
+
+/**
+ * @brief Returns an emitted value as a signed number: EMIT sends the low 24 bits of a register.
+ */
+static int32_t signExtend(uint32_t value) {
+	return (value & 0x800000) ? (int32_t) value - 0x1000000 : (int32_t) value;
+}
+
+/**
+ * @brief Returns the last line of a reply, or an empty string.
+ */
+static string lastLine(const Reply& reply) {
+	return reply.lines.empty() ? string() : reply.lines.back();
+}
+
+/**
+ * @brief Uploads a program and runs it.
+ *
+ * @param client The open client.
+ * @param program The bytecode.
+ * @param registers The initial register values, e.g. ",100,-5000", or an empty string.
+ * @param run Set to the reply of SEQ_RUN.
+ * @return 0 if the program was loaded and its run completed, 1 otherwise.
+ */
+static uint8_t loadAndRun(CLIENT& client, const vector<uint8_t>& program, const string& registers, Reply& run) {
+	Reply load = client.sequenceLoad(program).get();
+	if (!load.ok() || lastLine(load).compare(0, 10, "SEQ_LOADED") != 0) {
+		run = load;
+		return 1;
+	}
+	run = client.send("SEQ_RUN" + registers).get();
+	return (run.ok() && lastLine(run).compare(0, 8, "SEQ_DONE") == 0) ? 0 : 1;
+}
+
+struct Check {
+	const char* name;
+	const char* source;
+	const char* registers;
+	function<bool(const vector<int32_t>&)> expect;
+};
+
+/**
+ * @brief Runs sequencer programs with known results on the board and prints SEQ_CHECK,name,OK or FAIL.
+ *
+ * The checks cover loops, comparisons and branches, initial registers, DAC writes read back through the ADC (the
+ * emulator's AINk reads DAC k % 4), a threshold search, program validation and aborting a run from the host. ADC
+ * channel 0 is enabled first.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+static uint8_t check(CLIENT& client) {
+	client.request("ADC_CONFIG,0,1,0,0,16\r*RDY?", decoder_utils::until({"READY"}), true).get();
+
+	const int32_t step = sequence_utils::dacCode(0.05);
+	const int32_t tolerance = sequence_utils::adcCode(0.01) - sequence_utils::adcCode(0);
+	const Check checks[] = {
+		{"loop", "set r0, 10\nset r1, 0\nnext: add r1, 3\nemit r1\nloop r0, next\n", "",
+		 [](const vector<int32_t>& v) {
+			 if (v.size() != 10) {return false;}
+			 for (size_t i = 0; i < v.size(); i++) {if (v[i] != 3 * (int32_t) (i + 1)) {return false;}}
+			 return true;
+		 }},
+		{"branch", "set r0, -2\nnext: emit r0\nadd r0, 1\ncmp r0, 3\njlt next\nhalt\nemit r0\n", "",
+		 [](const vector<int32_t>& v) {
+			 if (v.size() != 5) {return false;}
+			 for (size_t i = 0; i < v.size(); i++) {if (v[i] != (int32_t) i - 2) {return false;}}
+			 return true;
+		 }},
+		{"registers", "add_reg r0, r1\nemit r0\nmov r2, r1\nsub_reg r2, r0\nemit r2\nemit r3\n", ",7,-3",
+		 [](const vector<int32_t>& v) { return v.size() == 3 && v[0] == 4 && v[1] == -7 && v[2] == 0; }},
+		{"dac_adc", "dac_code 0, dac(2.5)\nldac\ndelay_us 1000\nadc_scan\nadc_get r0, 0\nemit r0\n", "",
+		 [tolerance](const vector<int32_t>& v) {
+			 //ADC codes are unsigned 24-bit values
+			 return v.size() == 1 && abs((v[0] & 0xFFFFFF) - sequence_utils::adcCode(2.5)) < tolerance;
+		 }},
+		{"threshold",
+		 "set r1, dac(-2)\nset r3, 100\n"
+		 "next: dac_reg 0, r1\nldac\ndelay_us 200\nadc_scan\nadc_get r2, 0\ncmp r2, adc(1)\njge found\n"
+		 "add r1, dac(0.05)\nloop r3, next\nfound: emit r1\n", "",
+		 [step](const vector<int32_t>& v) {
+			 return v.size() == 1 && abs(v[0] - sequence_utils::dacCode(1)) <= 2 * step;
+		 }},
+	};
+
+	uint8_t status = 0;
+	for (size_t c = 0; c < sizeof(checks) / sizeof(checks[0]); c++) {
+		vector<uint8_t> program;
+		string error;
+		bool ok = sequence_utils::assemble(checks[c].source, program, error) == 0;
+
+		Reply run;
+		ok = ok && loadAndRun(client, program, checks[c].registers, run) == 0;
+
+		vector<int32_t> values;
+		for (size_t i = 0; i < run.codes.size(); i++) {values.push_back(signExtend(run.codes[i]));}
+		ok = ok && checks[c].expect(values);
+
+		printf("SEQ_CHECK,%s,%s\n", checks[c].name, ok ? "OK" : "FAIL");
+		if (!ok) {status = 1;}
+	}
+
+	//A jump into the middle of an instruction must be rejected before the program can run
+	Reply invalid = client.sequenceLoad({sequence_utils::JMP, 0, 1, sequence_utils::HALT}).get();
+	Reply notLoaded = client.send("SEQ_RUN").get();
+	bool ok = lastLine(invalid) == "INVALID SEQ PROGRAM" && lastLine(notLoaded) == "SEQ NOT LOADED";
+	printf("SEQ_CHECK,invalid,%s\n", ok ? "OK" : "FAIL");
+	if (!ok) {status = 1;}
+
+	//An endless loop stops when a byte arrives; SEQ_RUN is exclusive, so the byte can be written directly
+	vector<uint8_t> program;
+	string error;
+	sequence_utils::assemble("spin: jmp spin\n", program, error);
+	client.sequenceLoad(program).get();
+	future<Reply> spinning = client.send("SEQ_RUN");
+	this_thread::sleep_for(chrono::milliseconds(50));
+	const uint8_t stop = '\r';
+	client.write(&stop, 1);
+	Reply aborted = spinning.get();
+	ok = lastLine(aborted).compare(0, 17, "SEQ_DONE,ABORTED,") == 0;
+	printf("SEQ_CHECK,abort,%s\n", ok ? "OK" : "FAIL");
+	if (!ok) {status = 1;}
+
+	return status;
+}
+
+/**
+ * @brief Assembles a sequencer program and runs it on a board, or runs the sequencer checks.
+ *
+ * @return 0 if the program ran (or every check passed), 1 otherwise.
+ */
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		usage();
+		return 1;
+	}
+
+	if (string(argv[1]) == "--assemble") {
+		string source;
+		vector<uint8_t> program;
+		string error;
+		if (readFile(argv[2], source) != 0) {
+			fprintf(stderr, "od-seq: cannot read %s: %s\n", argv[2], strerror(errno));
+			return 1;
+		}
+		if (sequence_utils::assemble(source, program, error) != 0) {
+			fprintf(stderr, "od-seq: %s: %s\n", argv[2], error.c_str());
+			return 1;
+		}
+		for (size_t i = 0; i < program.size(); i++) {printf("%02x%s", program[i], (i % 16 == 15) ? "\n" : " ");}
+		printf("%s%zu bytes\n", (program.size() % 16) ? "\n" : "", program.size());
+		return 0;
+	}
+
+	string path = argv[1];
+	string file = argv[2];
+	uint32_t baud = 115200;
+	string registers;
+	bool volts = false;
+
+	for (int a = 3; a < argc; a++) {
+		string arg = argv[a];
+		bool more = a + 1 < argc;
+		if ((arg == "-b" || arg == "--baud") && more) {baud = strtoul(argv[++a], 0, 10);}
+		else if ((arg == "-r" || arg == "--registers") && more) {registers = string(",") + argv[++a];}
+		else if (arg == "--volts") {volts = true;}
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	vector<uint8_t> program;
+	if (file != "--check") {
+		string source;
+		string error;
+		if (readFile(file, source) != 0) {
+			fprintf(stderr, "od-seq: cannot read %s: %s\n", file.c_str(), strerror(errno));
+			return 1;
+		}
+		if (sequence_utils::assemble(source, program, error) != 0) {
+			fprintf(stderr, "od-seq: %s: %s\n", file.c_str(), error.c_str());
+			return 1;
+		}
+	}
+
+	CLIENT client;
+	if (client.open(path, baud) != 0) {
+		fprintf(stderr, "od-seq: cannot open %s: %s\n", path.c_str(), strerror(errno));
+		return 1;
+	}
+
+	uint8_t status;
+	if (file == "--check") {
+		status = check(client);
+	}
+	else {
+		Reply run;
+		status = loadAndRun(client, program, registers, run);
+		for (size_t i = 0; i < run.codes.size(); i++) {
+			if (volts) {printf("%.6f\n", (run.codes[i] / 8388608.0 - 1) * 25);}
+			else {printf("%d\n", signExtend(run.codes[i]));}
+		}
+		if (status != 0) {fprintf(stderr, "od-seq: %s\n", run.ok() ? lastLine(run).c_str() : run.error.c_str());}
+		else {printf("%s\n", lastLine(run).c_str());}
+	}
+
+	client.close();
+	return status;
+}
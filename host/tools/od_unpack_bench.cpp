@@ -0,0 +1,134 @@
+#include "../include/unpack.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief Prints the usage of the decoder benchmark.
+ */
+static void usage(void) {
+	fprintf(stderr,
+		"usage: od-unpack-bench [options]\n"
+		"  -n, --codes N         codes per conversion (default 16777216)\n"
+		"  -t, --threads N       workers of the parallel runs (default: hardware threads)\n"
+		"  -r, --repeat N        timed repetitions, the fastest is reported (default 5)\n"
+		"Converts random packed 24-bit codes to int32 codes and to volts with every supported\n"
+		"instruction set, single-threaded and in parallel, checks each result against the scalar\n"
+		"reference and reports the input rate in GB/s.\n");
+}
+
+/**
+ * @brief Times a conversion.
+ *
+ * @param repeat The number of repetitions.
+ * @param run Performs one conversion.
+ * @return The fastest repetition in seconds.
+ */
+template <typename Run>
+static double fastest(uint32_t repeat, Run run) {
+	double best = 1e30;
+	for (uint32_t r = 0; r < repeat; r++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		run();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (seconds < best) {best = seconds;}
+	}
+	return best;
+}
+
+/**
+ * @brief Prints one result line.
+ *
+ * @param output "codes" or "volts".
+ * @param isa The instruction set.
+ * @param threads The number of workers.
+ * @param bytes The input size in bytes.
+ * @param seconds The conversion time.
+ * @param reference The time of the scalar reference.
+ * @param match Whether the output equals the scalar reference.
+ */
+static void report(const char* output, unpack_utils::Isa isa, unsigned threads, size_t bytes, double seconds,
+                   double reference, bool match) {
+	printf("UNPACK,%s,%s,threads=%u,gb_per_s=%.3f,speedup=%.2f,%s\n", output, unpack_utils::isaName(isa), threads,
+	       bytes / seconds / 1e9, reference / seconds, match ? "OK" : "MISMATCH");
+}
+
+/**
+ * @brief Benchmarks unpack_utils against its scalar path.
+ *
+ * The scalar, single-threaded conversion is the reference for speed and for the results; every other run must produce
+ * bit-identical output.
+ *
+ * @return 0 if every run matched the reference, 1 otherwise.
+ */
+int main(int argc, char** argv) {
+	size_t count = 1 << 24;
+	unsigned threads = thread::hardware_concurrency();
+	uint32_t repeat = 5;
+
+	for (int a = 1; a < argc; a++) {
+		string arg = argv[a];
+		bool more = a + 1 < argc;
+		if ((arg == "-n" || arg == "--codes") && more) {count = strtoull(argv[++a], 0, 10);}
+		else if ((arg == "-t" || arg == "--threads") && more) {threads = strtoul(argv[++a], 0, 10);}
+		else if ((arg == "-r" || arg == "--repeat") && more) {repeat = strtoul(argv[++a], 0, 10);}
+		else {
+			usage();
+			return (arg == "-h" || arg == "--help") ? 0 : 1;
+		}
+	}
+	if (threads == 0) {threads = 1;}
+	if (repeat == 0) {repeat = 1;}
+
+	vector<uint8_t> packed(3 * count);
+	uint32_t state = 1;
+	for (size_t i = 0; i < packed.size(); i++) {
+		state = state * 1664525 + 1013904223;
+		packed[i] = (uint8_t) (state >> 24);
+	}
+	size_t bytes = packed.size();
+
+	vector<int32_t> codeReference(count), codeOut(count);
+	vector<float> voltReference(count), voltOut(count);
+
+	double codeTime = fastest(repeat, [&]() { unpack_utils::codes(packed.data(), count, codeReference.data(),
+	                                                              unpack_utils::SCALAR); });
+	double voltTime = fastest(repeat, [&]() { unpack_utils::voltages(packed.data(), count, voltReference.data(),
+	                                                                 unpack_utils::SCALAR); });
+	report("codes", unpack_utils::SCALAR, 1, bytes, codeTime, codeTime, true);
+	report("volts", unpack_utils::SCALAR, 1, bytes, voltTime, voltTime, true);
+
+	bool allMatch = true;
+	for (int i = unpack_utils::SCALAR; i <= unpack_utils::bestIsa(); i++) {
+		unpack_utils::Isa isa = (unpack_utils::Isa) i;
+		vector<unsigned> runs;
+		if (isa != unpack_utils::SCALAR) {runs.push_back(1);}
+		if (threads > 1) {runs.push_back(threads);}
+
+		for (size_t r = 0; r < runs.size(); r++) {
+			unsigned n = runs[r];
+			memset(codeOut.data(), 0, count * sizeof(int32_t));
+			memset(voltOut.data(), 0, count * sizeof(float));
+
+			double seconds = fastest(repeat, [&]() { unpack_utils::codesParallel(packed.data(), count, codeOut.data(),
+			                                                                     n, isa); });
+			bool match = memcmp(codeOut.data(), codeReference.data(), count * sizeof(int32_t)) == 0;
+			report("codes", isa, n, bytes, seconds, codeTime, match);
+			allMatch = allMatch && match;
+
+			seconds = fastest(repeat, [&]() { unpack_utils::voltagesParallel(packed.data(), count, voltOut.data(),
+			                                                                 n, isa); });
+			match = memcmp(voltOut.data(), voltReference.data(), count * sizeof(float)) == 0;
+			report("volts", isa, n, bytes, seconds, voltTime, match);
+			allMatch = allMatch && match;
+		}
+	}
+
+	return allMatch ? 0 : 1;
+}
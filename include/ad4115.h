@@ -15,12 +15,13 @@ protected:
 	virtual spi_utils::Message interfaceModeMsg(void);
 	virtual spi_utils::Message adcModeMsg(void);
 	virtual spi_utils::Message dataReadingMsg(void);
+	virtual spi_utils::Message continuousModeMsg(void);
+	virtual spi_utils::Message standbyModeMsg(void);
 
 private:
 	//Functions
 	uint32_t twoByteToInt(byte db1, byte db2);
 	double threeByteToInt(uint8_t db1, uint8_t db2, uint8_t db3);
-	double voltageMap(double decimal);
 	void waitDrdy(void);
 	
 	//Variables
@@ -61,6 +62,32 @@ public:
 	double fullReading(void);
 	double bufferRampFullReading(void);
 	uint8_t resetAdc(void);
+	///
+	/// Single conversion of all enabled channels without serial output.
+	/// codes[channel] receives the raw 24-bit code of every enabled channel.
+	///
+	uint8_t startConversion(void);
+	uint8_t readConversion(uint32_t codes[16]);
+	uint8_t conversionScan(uint32_t codes[16]);
+	///
+	/// Continuous acquisition. startContinuous() leaves the ADC converting the enabled
+	/// channels in sequence with SYNC low; every readSample() returns the next raw 24-bit
+	/// code (MSB first) at the ADC's native rate until stopContinuous() is called.
+	///
+	uint8_t startContinuous(void);
+	uint8_t readSample(uint8_t sample[3]);
+	uint8_t stopContinuous(void);
+	///
+	/// Copies the enabled channel numbers, in conversion order, into channels[].
+	/// Returns the number of enabled channels.
+	///
+	uint8_t activeChannels(uint8_t channels[16]);
+	///
+	/// Inverse of the voltage mapping: returns the raw 24-bit code for a voltage,
+	/// clamped to the code range.
+	///
+	uint32_t voltageToCode(double voltage);
+	double voltageMap(double decimal);
 
 	//Test functions
 	uint8_t configChannelsTest(void);
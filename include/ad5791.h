@@ -64,6 +64,20 @@ public:
     ///
     ///
     ///
+    /// Converts a voltage to the 20-bit two's complement DAC code, clamped to the full scale.
+    ///
+    uint32_t voltageToCode(double voltage);
+    ///
+    ///
+    ///
+    /// Shifts a 20-bit code into the DAC register of a channel without pulsing LDAC and
+    /// without serial output. The output changes on the next updateAnalogOutputs().
+    /// \returns 0 if successful.
+    ///
+    uint8_t writeCode(uint8_t channel, uint32_t code);
+    ///
+    ///
+    ///
     /// Constructor
     /// \param[in] sync_pin The sync or chip select of the dac chip. Different than spi_bus_config_pin
     /// \param[in] spi_bus_config_pin The pin that identifies the bus. More than one dac can share the same pin.
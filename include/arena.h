@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stdint.h>
+using namespace std;
+
+/**
+ * @namespace arena_utils
+ * @brief Namespace containing the shared sample memory.
+ *
+ * The Due has 96 KiB of SRAM, not enough for a capture buffer and a waveform table of useful size side by side. Since
+ * the firmware runs one operation at a time, they share a single preallocated arena. Every user claims the arena
+ * before writing to it; a user that keeps data in the arena between commands (e.g. a waveform table) checks owner()
+ * before using it again, because any other claim overwrites its data.
+ */
+namespace arena_utils {
+
+	///
+	/// Arena size: 64 KiB rounded down to a whole number of 24-bit samples.
+	///
+	static const uint32_t kBytes = 65535;
+
+	///
+	/// Arena users.
+	///
+	enum Owner : uint8_t {
+		NONE = 0,
+		CAPTURE_BUFFER,
+		AWG_TABLE,
+		SEQUENCE_PROGRAM
+	};
+
+	uint8_t* claim(Owner owner);
+	Owner owner(void);
+	uint8_t* buffer(void);
+}
+
+#endif // ARENA_H
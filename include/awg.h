@@ -0,0 +1,44 @@
+#ifndef AWG_H
+#define AWG_H
+#include <SPI.h>
+#include <stdint.h>
+#include "utils.h"
+#include "ad5791.h"
+#include "ad4115.h"
+#include "arena.h"
+using namespace std;
+
+class AWG
+{
+private:
+	AD5791& dac;
+	AD4115& adc;
+	uint8_t channels[4];
+	uint8_t nChannels = 0;
+	uint32_t nPoints = 0;
+
+	uint8_t loadPoint(uint32_t point);
+
+public:
+	///
+	/// Reads a table of n points from the serial port into the arena. Each point
+	/// holds one 20-bit code per channel set in channelMask (bit 0 = DAC 0), in ascending
+	/// channel order, as 3 bytes MSB first.
+	/// \returns 0 if successful, 1 if the table does not fit, 2 on timeout.
+	///
+	uint8_t load(uint8_t channelMask, uint32_t n);
+	///
+	/// Plays the table 'loops' times (0 = until a byte arrives on the serial port), one
+	/// point every periodUs. With sampleOffsetUs > 0 the ADC is converted that long after
+	/// every point and the raw codes are sent.
+	/// \returns 0 if successful, 1 if there is no valid table or the timing is invalid.
+	///
+	uint8_t run(uint32_t periodUs, uint32_t loops, uint32_t sampleOffsetUs);
+	uint32_t capacity(uint8_t channelMask);
+
+	// Constructor
+	AWG(AD5791& dac, AD4115& adc);
+
+};
+
+#endif // AWG_H
@@ -0,0 +1,45 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <SPI.h>
+#include <stdint.h>
+#include "utils.h"
+#include "ad5791.h"
+#include "ad4115.h"
+using namespace std;
+
+class BATCH
+{
+private:
+	AD5791& dac;
+	AD4115& adc;
+	static const uint16_t kMaxFrameBytes = 256;
+	uint8_t frame[kMaxFrameBytes];
+	uint16_t nBytes = 0;
+
+	uint8_t receive(uint16_t n);
+	int32_t countScans(void);
+
+public:
+	///
+	/// Operations of a binary batch frame: one opcode byte, then the arguments MSB first.
+	///
+	enum Opcode : uint8_t {
+		DAC_CODE = 0x01, // channel, 20-bit code in 3 bytes: loads the DAC register without LDAC
+		LDAC = 0x02,     // updates all DAC outputs
+		ADC_SCAN = 0x03, // converts the enabled ADC channels and sends their raw codes
+		DELAY_US = 0x04  // 4-byte delay in microseconds
+	};
+
+	///
+	/// Reads a binary frame of n bytes (at most 256) sent right after the command line and runs it: prints
+	/// BATCH_BEGIN,nCodes, the 3-byte raw codes of every ADC_SCAN, then BATCH_DONE,ops,elapsed_us.
+	/// \returns 0 if successful, 1 if the frame is too long or malformed, 2 on timeout.
+	///
+	uint8_t run(uint16_t n);
+
+	// Constructor
+	BATCH(AD5791& dac, AD4115& adc);
+
+};
+
+#endif // BATCH_H
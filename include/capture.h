@@ -0,0 +1,57 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include <SPI.h>
+#include <stdint.h>
+#include "utils.h"
+#include "ad4115.h"
+#include "arena.h"
+using namespace std;
+
+class CAPTURE
+{
+private:
+	AD4115& adc;
+	uint32_t nSamples = 0;
+	uint32_t start = 0;
+	double rate = 0;
+
+	uint8_t ringCapture(int16_t channel, uint32_t level, uint8_t edge, uint32_t pre, uint32_t post, uint32_t timeoutMs);
+	uint8_t writeSamples(void);
+
+public:
+	///
+	/// The sample buffer is the shared arena (see arena_utils).
+	///
+	static const uint32_t kCapacity = arena_utils::kBytes / 3;
+
+	///
+	/// Trigger edges for levelTrigger() and pinTrigger().
+	///
+	enum TriggerEdge : uint8_t {
+		RISING_EDGE = 0,
+		FALLING_EDGE = 1,
+		ANY_EDGE = 2
+	};
+
+	uint8_t burst(uint32_t n);
+	uint8_t stream(void);
+	///
+	/// Triggered capture. Samples continuously into a circular history and, when the
+	/// trigger fires, keeps 'pre' samples before the trigger and 'post' samples from the
+	/// trigger sample on. Returns 0 if triggered, 1 on timeout (timeoutMs = 0 waits forever),
+	/// 2 if the trigger channel is not enabled, 3 if no ADC channel is enabled.
+	///
+	uint8_t levelTrigger(uint8_t channel, double level, uint8_t edge, uint32_t pre, uint32_t post, uint32_t timeoutMs);
+	uint8_t pinTrigger(uint8_t pin, uint8_t edge, uint32_t pre, uint32_t post, uint32_t timeoutMs);
+	uint8_t streamTriggered(uint8_t result);
+	uint32_t capacity(void);
+	double achievedRate(void);
+	uint32_t triggerIndex = 0;
+	uint8_t firstChannel = 0;
+
+	// Constructor
+	CAPTURE(AD4115& adc);
+
+};
+
+#endif // CAPTURE_H
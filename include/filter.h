@@ -0,0 +1,62 @@
+#ifndef FILTER_H
+#define FILTER_H
+#include <stdint.h>
+using namespace std;
+
+class FILTER
+{
+public:
+	///
+	/// Filter types. NO_FILTER passes every reading through (subject to the divider).
+	///
+	enum FilterType : uint8_t {
+		NO_FILTER = 0,
+		MOVING_AVERAGE = 1,
+		CIC = 2,
+		IIR = 3
+	};
+
+	static const uint8_t nChannels = 16;
+	static const uint8_t kMaxAverage = 64;
+	static const uint8_t kMaxCicOrder = 4;
+	static const uint8_t kMaxIirShift = 16;
+
+	///
+	/// Configures the filter of one ADC channel.
+	/// type: a FilterType. param: moving average length (1 to 64), CIC order (1 to 4) or
+	/// IIR shift k, alpha = 2^-k (1 to 16). divider: one output every 'divider' readings;
+	/// it is also the CIC decimation ratio (divider^order must stay below 2^39).
+	/// \returns 0 if successful, 1 if a parameter is out of range.
+	///
+	uint8_t configure(uint8_t channel, uint8_t type, uint8_t param, uint16_t divider);
+	///
+	/// Clears the state of every channel, keeping the configuration.
+	///
+	uint8_t reset(void);
+	///
+	/// Feeds one raw 24-bit code. Returns true and writes the filtered code to *out
+	/// when an output is due.
+	///
+	bool push(uint8_t channel, uint32_t code, uint32_t* out);
+	bool enabled(uint8_t channel);
+	bool anyEnabled(void);
+
+private:
+	struct ChannelState {
+		uint8_t type;
+		uint8_t param;
+		uint16_t divider;
+		uint16_t phase;
+		uint8_t head;
+		uint8_t filled;
+		int64_t sum;
+		uint64_t integrators[kMaxCicOrder];
+		uint64_t combs[kMaxCicOrder];
+		int32_t history[kMaxAverage];
+	};
+
+	ChannelState channels[nChannels] = {};
+	bool configured[nChannels] = {};
+};
+
+#endif // FILTER_H
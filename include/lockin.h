@@ -0,0 +1,63 @@
+#ifndef LOCKIN_H
+#define LOCKIN_H
+#include <SPI.h>
+#include <stdint.h>
+#include "utils.h"
+#include "ad5791.h"
+#include "ad4115.h"
+using namespace std;
+
+class LOCKIN
+{
+private:
+	AD5791& dac;
+	AD4115& adc;
+
+	static const uint16_t kMaxPoints = 256;
+	static const uint8_t kMaxOrder = 4;
+	static const uint8_t kMaxShift = 30;
+
+	uint8_t dacChannel = 0;
+	uint16_t nPoints = 0;
+	uint32_t periodUs = 0;
+	uint32_t sampleOffsetUs = 0;
+	uint8_t order = 1;
+	uint8_t shift = 0;
+	uint32_t outputEvery = 1;
+	uint32_t offsetCode = 0;
+
+	uint32_t excitation[kMaxPoints];
+	int16_t refSin[kMaxPoints];
+	int16_t refCos[kMaxPoints];
+	int64_t stateX[16][kMaxOrder];
+	int64_t stateY[16][kMaxOrder];
+
+	uint8_t loadPoint(uint16_t point);
+	uint8_t demodulate(uint8_t channel, int32_t sample, uint16_t point);
+	double toVolts(int64_t state);
+
+public:
+	///
+	/// Configures the excitation and the demodulation. The sinusoid of the given amplitude
+	/// and offset (V) is played on dacChannel from a table of pointsPerCycle points, one
+	/// point per timer period; the ADC converts sampleOffsetUs after each point. X and Y
+	/// are filtered by 'order' cascaded first-order stages of time constant tauMs and
+	/// reported outputRateHz times per second. Returns 1 if a parameter is out of range.
+	///
+	uint8_t configure(uint8_t dacChannel, double amplitude, double offset, double frequency, uint16_t pointsPerCycle,
+	                  uint32_t sampleOffsetUs, double phaseDeg, double tauMs, uint8_t order, double outputRateHz);
+	///
+	/// Runs the lock-in for durationMs (0 = until a byte arrives on the serial port).
+	/// \returns 0 if successful, 1 if it is not configured.
+	///
+	uint8_t run(uint32_t durationMs);
+	double frequency(void);
+	double timeConstantMs(void);
+	uint32_t decimation(void);
+
+	// Constructor
+	LOCKIN(AD5791& dac, AD4115& adc);
+
+};
+
+#endif // LOCKIN_H
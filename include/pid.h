@@ -0,0 +1,82 @@
+#ifndef PID_H
+#define PID_H
+#include <SPI.h>
+#include <stdint.h>
+#include "utils.h"
+#include "ad5791.h"
+#include "ad4115.h"
+using namespace std;
+
+///
+/// Loop statistics of the running controller. Errors are in ADC codes, times in stats_utils ticks.
+///
+struct PidStats {
+	uint32_t loops;
+	uint32_t saturated;
+	uint32_t start;
+	uint32_t maxLoop;
+	uint32_t maxAbsError;
+	int64_t sumError;
+	double sumSquares;
+};
+
+class PID
+{
+private:
+	AD5791& dac;
+	AD4115& adc;
+
+	uint8_t adcChannel = 0;
+	uint8_t dacChannel = 0;
+	uint32_t setpointCode = 8388608;
+	int32_t kp = 0;
+	int32_t ki = 0;
+	int32_t kd = 0;
+	int32_t outMin = -524288;
+	int32_t outMax = 524287;
+	int32_t maxSlew = 1048575;
+	bool running = false;
+
+	int32_t bias = 0;
+	int32_t output = 0;
+	int64_t integral = 0;
+	int32_t lastError = 0;
+
+	int32_t voltageToUnits(double voltage);
+	double unitsToVoltage(int32_t units);
+	bool channelEnabled(uint8_t channel);
+
+public:
+	///
+	/// Fractional bits of the integer gains.
+	///
+	static const uint8_t kGainShift = 16;
+
+	///
+	/// Configures the loop: the error is setpoint - reading of adcChannel and the output
+	/// is written to dacChannel. Gains are in volts of output per volt of error (ki per
+	/// loop, kd per loop), limits in volts and maxSlew in volts per loop.
+	/// Returns 1 if a channel, gain or limit is out of range or adcChannel is not enabled.
+	/// Stops a running loop.
+	///
+	uint8_t configure(uint8_t adcChannel, uint8_t dacChannel, double setpoint, double kp, double ki, double kd,
+	                  double outMin, double outMax, double maxSlew);
+	///
+	/// Starts the loop. Returns 1 if adcChannel is no longer enabled.
+	///
+	uint8_t start(void);
+	uint8_t stop(void);
+	bool active(void);
+	///
+	/// Runs one loop iteration if the controller is running. Called from loop().
+	///
+	uint8_t service(void);
+	uint8_t report(void);
+	PidStats stats;
+
+	// Constructor
+	PID(AD5791& dac, AD4115& adc);
+
+};
+
+#endif // PID_H
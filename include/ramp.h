@@ -5,9 +5,65 @@
 #include "utils.h"
 #include "ad5791.h"
 #include "ad4115.h"
+#include "stats.h"
+#include "filter.h"
 #include <cstdlib>
 using namespace std;
 
+///
+/// Step timing of the last buffered ramp. Times are kept in stats_utils ticks and
+/// reported in microseconds; histograms use stats_utils::histogramBin().
+///
+struct RampTiming {
+	///
+	/// Intended step period in ticks. 0 means free running: the first measured step
+	/// interval is then taken as the reference period.
+	///
+	uint32_t period;
+	uint32_t settle;
+	uint32_t reference;
+	uint32_t anchor;
+	uint32_t lastUpdate;
+	///
+	/// Time from the anchor to the last LDAC pulse, summed per step so that it does not wrap
+	/// with the 32-bit tick counter on long ramps.
+	///
+	uint64_t elapsed;
+	uint32_t steps;
+	uint32_t overruns;
+	uint32_t maxUpdateJitter;
+	uint32_t maxSettleJitter;
+	uint32_t updateJitter[stats_utils::kHistogramBins];
+	uint32_t settleJitter[stats_utils::kHistogramBins];
+
+	void begin(uint32_t periodTicks, uint32_t settleTicks);
+	uint32_t deadline(uint32_t step);
+	void reschedule(uint32_t step, uint32_t now);
+	void markUpdate(uint32_t step, uint32_t now, uint32_t workDone);
+	void markReadout(uint32_t now);
+	void report(void);
+};
+
+///
+/// One vertex of a piecewise-linear path. The segment leading to the vertex takes
+/// nSteps steps; the path then dwells dwellMs at the vertex.
+///
+struct PathVertex {
+	double v[4];
+	uint32_t nSteps;
+	uint32_t dwellMs;
+};
+
+///
+/// One axis of a raster scan: nPoints evenly spaced voltages from vi to vf on one DAC channel.
+///
+struct RasterAxis {
+	uint8_t channel;
+	double vi;
+	double vf;
+	uint32_t nPoints;
+};
+
 class RAMPS
 {
 protected:
@@ -18,6 +74,29 @@ private:
 	uint8_t setVi(uint8_t channelsDAC[4], double vi[4]);
 	double roundToSixDecimalPlaces(double value);
 	double dv[4] = {0, 0, 0, 0};
+	uint32_t stepPeriodUs = 0;
+	uint32_t nAverage = 1;
+	bool averageStats = false;
+	bool pipelined = false;
+	uint32_t timedOffsetUs = 0;
+	uint32_t sweepCycles = 0;
+	int8_t syncPin = -1;
+	uint8_t syncEdge = 0;
+	uint32_t syncTimeoutMs = 0;
+	bool syncDrive = false;
+	uint8_t waitSync(void);
+	static const uint32_t kMinSlewPeriodUs = 20;
+	static const uint32_t kMaxSlewSteps = 10000000;
+	static const uint32_t kMaxSlewPeriodUs = 1000000;
+	static const uint8_t kMaxVertices = 64;
+	PathVertex path[kMaxVertices];
+	uint8_t nVertices = 0;
+	uint8_t loadStep(uint8_t channelsDAC[4], double vi[4], uint32_t step);
+	uint8_t writePoint(uint32_t codes[16], uint8_t channels[16], uint8_t count);
+	uint8_t readPoint(void);
+	uint8_t readPoint(const char* tag);
+	uint8_t oversampledReading(void);
+	uint8_t filteredReading(const char* tag);
     AD5791& dac;
     AD4115& adc;
  	int mValue;
@@ -29,6 +108,77 @@ public:
 	uint8_t simpleRamp(uint8_t channelsDAC[4], double vi[4], double vf[4], double nSteps, double del, bool buffer);
 	uint8_t simpleRampIteration(uint8_t channelsDAC[4], double vi[4], double nSteps, double del);
 	uint8_t bufferRampIteration(uint8_t channelsDAC[4], double vi[4], double nSteps, double del);
+	uint8_t pipelinedRampIteration(uint8_t channelsDAC[4], double vi[4], double nSteps, double del);
+	///
+	/// Enables the pipelined buffered ramp: the next step's DAC codes are loaded while the
+	/// ADC converts, and readings are sent as raw binary codes.
+	/// \returns 0 if successful, 1 if sweep cycles are set.
+	///
+	uint8_t setPipelined(bool enable);
+	uint8_t timedRampIteration(uint8_t channelsDAC[4], double vi[4], double nSteps);
+	uint8_t sweepRampIteration(uint8_t channelsDAC[4], double vi[4], double nSteps, double del, bool buffer);
+	///
+	/// Makes ramps go vi -> vf -> vi 'cycles' times without stopping at the turnaround;
+	/// buffered readings are tagged F (towards vf) or R (towards vi). 0 restores one-way ramps.
+	/// \returns 0 if successful, 1 if the pipelined or hardware-timed ramp is enabled.
+	///
+	uint8_t setSweep(uint32_t cycles);
+	///
+	/// Adaptive buffered ramp: the step along vi -> vf grows where the ADC readings are flat and
+	/// shrinks where they change by more than threshold (V) per step, between minStep and maxStep (V).
+	/// Points are sent as binary records with their DAC codes (see adaptiveRamp in ramp.cpp).
+	///
+	uint8_t adaptiveRamp(uint8_t channelsDAC[4], double vi[4], double vf[4], double minStep, double maxStep, double threshold, double del);
+	///
+	/// Slew-rate limited ramp: the step count and step period are computed from the
+	/// per-channel limits maxSlew (V/s) and maxStep (V) so that the ramp is as short as
+	/// both limits allow on every channel. Returns 1 if a limit of an active channel is not positive
+	/// or the limits need more than kMaxSlewSteps steps.
+	///
+	uint8_t slewRamp(uint8_t channelsDAC[4], double vi[4], double vf[4], double maxSlew[4], double maxStep[4], bool buffer);
+	///
+	/// Enables the hardware-timed buffered ramp: LDAC is pulsed by the step timer every
+	/// step period and the conversion starts offsetUs after each pulse. 0 disables it.
+	/// Requires a step period (setStepPeriod) larger than the offset.
+	/// \returns 0 if successful, 1 if the offset is not shorter than the step period,
+	/// 2 if sweep cycles are set.
+	///
+	uint8_t setTimed(uint32_t offsetUs);
+	///
+	/// Synchronized start across boards sharing a sync line: ramps wait for an edge on pin
+	/// (or, with drive, produce it) after printing SYNC_ARMED, then write '+' and start, or
+	/// '!' on timeout or when a byte from the host aborts the wait. pin -1 disables it.
+	///
+	uint8_t setSync(int8_t pin, uint8_t edge, uint32_t timeoutMs, bool drive);
+	///
+	/// Piecewise-linear paths. The first vertex added is the starting point; each
+	/// following vertex ends a linear segment. pathRun plays the whole path without
+	/// gaps between segments.
+	///
+	uint8_t pathClear(void);
+	uint8_t pathAdd(double v[4], uint32_t nSteps, uint32_t dwellMs);
+	uint8_t pathRun(uint8_t channelsDAC[4], double del, bool buffer);
+	///
+	/// 2D raster scan: the fast axis is swept for every point of the slow axis and the ADC
+	/// is read at each point. Rows are streamed as binary frames (see raster in ramp.cpp).
+	///
+	uint8_t raster(RasterAxis fast, RasterAxis slow, uint32_t settleUs, uint32_t retraceMs, bool serpentine);
+	///
+	/// Sets the intended step period of buffered ramps in microseconds. With a period, each
+	/// LDAC pulse is scheduled on a fixed grid; 0 restores free running steps.
+	/// \returns 0 if successful, 1 if the timed mode is on and the period is not longer than its offset.
+	///
+	uint8_t setStepPeriod(uint32_t periodUs);
+	///
+	/// Sets the number of ADC readings averaged on the device for every point of a
+	/// buffered ramp. With stats, min, max and variance are sent along with the mean.
+	///
+	uint8_t setOversampling(uint32_t n, bool stats);
+	RampTiming timing;
+	///
+	/// Per-channel filter stage applied to buffered ramp readings (see FILTER).
+	///
+	FILTER filter;
 
 	// Constructor
   	RAMPS(AD5791& dac, AD4115& adc);
@@ -0,0 +1,73 @@
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+#include <SPI.h>
+#include <stdint.h>
+#include "utils.h"
+#include "ad5791.h"
+#include "ad4115.h"
+#include "arena.h"
+using namespace std;
+
+class SEQUENCER
+{
+private:
+	AD5791& dac;
+	AD4115& adc;
+	uint16_t nBytes = 0;
+
+	uint8_t validate(const uint8_t* program, uint16_t n);
+
+public:
+	///
+	/// Longest program; the rest of the arena buffers the emitted values.
+	///
+	static const uint16_t kMaxProgramBytes = 4096;
+	static const uint8_t kRegisters = 8;
+
+	///
+	/// Instructions: one opcode byte, then the operands MSB first. r is a register index,
+	/// imm a signed 32-bit immediate, target a 16-bit byte offset of an instruction.
+	///
+	enum Opcode : uint8_t {
+		HALT = 0x00,     // ends the program, as does running past its last byte
+		DAC_CODE = 0x01, // channel, 20-bit code in 3 bytes: loads the DAC register without LDAC
+		LDAC = 0x02,     // updates all DAC outputs
+		ADC_SCAN = 0x03, // converts the enabled ADC channels
+		DELAY_US = 0x04, // 4-byte delay in microseconds
+		SET = 0x10,      // r, imm: r = imm
+		ADD = 0x11,      // r, imm: r += imm
+		ADD_REG = 0x12,  // rd, rs: rd += rs
+		SUB_REG = 0x13,  // rd, rs: rd -= rs
+		MOV = 0x14,      // rd, rs: rd = rs
+		ADC_GET = 0x15,  // r, channel: r = code of the channel at the last ADC_SCAN
+		DAC_REG = 0x16,  // channel, r: loads the DAC register with the low 20 bits of r, without LDAC
+		EMIT = 0x17,     // r: appends the low 24 bits of r to the output
+		CMP = 0x20,      // r, imm: compares r with imm for the next conditional jump
+		JMP = 0x21,      // target
+		JEQ = 0x22,      // target: jumps if r == imm at the last CMP
+		JNE = 0x23,      // target: jumps if r != imm
+		JLT = 0x24,      // target: jumps if r < imm
+		JGE = 0x25,      // target: jumps if r >= imm
+		LOOP = 0x26      // r, target: r -= 1, jumps if r != 0
+	};
+
+	///
+	/// Reads a program of n bytes sent right after the command line into the arena and
+	/// checks every instruction and jump target.
+	/// \returns 0 if successful, 1 if the program is too long or invalid, 2 on timeout.
+	///
+	uint8_t load(uint16_t n);
+	///
+	/// Runs the loaded program with registers r0.. set from initial[] (the others 0), then
+	/// prints SEQ_BEGIN,nValues, the emitted values as 3 bytes MSB first, and
+	/// SEQ_DONE,status,instructions,elapsed_us. A byte arriving on the serial port aborts it.
+	/// \returns 0 if successful, 1 if no program is loaded.
+	///
+	uint8_t run(const int32_t* initial, uint8_t nInitial);
+
+	// Constructor
+	SEQUENCER(AD5791& dac, AD4115& adc);
+
+};
+
+#endif // SEQUENCER_H
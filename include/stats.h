@@ -0,0 +1,79 @@
+#ifndef STATS_H
+#define STATS_H
+#include <stdint.h>
+#include "utils.h"
+
+using namespace std;
+
+/**
+ * @namespace stats_utils
+ * @brief Namespace containing the hot-path counters and timers.
+ *
+ * Every instrumented operation (SPI frames, DRDY waits, conversions, ramp steps and serial writes) owns one Counter.
+ * Durations are measured in ticks: on the Arduino Due a tick is one core clock cycle read from the Cortex-M3 DWT cycle
+ * counter (84 MHz), on the host build a tick is one nanosecond of std::chrono::steady_clock. Ticks are kept in 32 bits,
+ * so a single measured operation must be shorter than ~51 s on the Due (~4.2 s on the host).
+ *
+ * The counters are reported through the STATS? command and cleared through STATS_RESET.
+ */
+namespace stats_utils {
+
+	///
+	/// Instrumented operations. N_OPERATIONS is the number of counters.
+	///
+	enum Operation : uint8_t {
+		DAC_SPI_FRAME = 0,
+		ADC_SPI_FRAME,
+		DRDY_WAIT,
+		ADC_CONVERSION,
+		RAMP_STEP,
+		SERIAL_WRITE,
+		N_OPERATIONS
+	};
+
+	///
+	/// Number of histogram bins. Bin 0 counts durations under 1 us, bin b counts
+	/// durations in [2^(b-1), 2^b) us and the last bin is open ended.
+	///
+	static const uint8_t kHistogramBins = 16;
+
+	struct Counter {
+		uint32_t count;
+		uint32_t min;
+		uint32_t max;
+		uint64_t total;
+		uint32_t histogram[kHistogramBins];
+	};
+
+	///
+	/// Enables the cycle counter and clears every counter. Called once from setup().
+	///
+	void begin(void);
+	uint32_t ticks(void);
+	uint32_t ticksPerMicrosecond(void);
+	double ticksToMicros(uint32_t elapsed);
+	uint8_t histogramBin(uint32_t micros);
+	void record(Operation op, uint32_t elapsed);
+	const Counter& counter(Operation op);
+	const char* operationName(Operation op);
+	void reset(void);
+	///
+	/// Prints one line per operation: STATS,name,count,min_us,mean_us,max_us,hist_0,...,hist_15
+	/// followed by EndOfStats.
+	///
+	void report(void);
+
+	///
+	/// Records the time between its construction and destruction into one counter.
+	///
+	class ScopedTimer {
+	public:
+		ScopedTimer(Operation op) : _op(op), _start(ticks()) {}
+		~ScopedTimer() { record(_op, ticks() - _start); }
+	private:
+		Operation _op;
+		uint32_t _start;
+	};
+}
+
+#endif // STATS_H
@@ -0,0 +1,33 @@
+#ifndef TIMER_H
+#define TIMER_H
+#include <stdint.h>
+using namespace std;
+
+/**
+ * @namespace timer_utils
+ * @brief Namespace containing the hardware step timer.
+ *
+ * The step timer produces two phase-locked events per period from a single counter: an update event at the start of
+ * every period and a sample event a fixed offset later. On the Arduino Due they are the RC and RA compare interrupts of
+ * timer channel TC8 (TC2 channel 2, clocked at MCK/2 = 42 MHz), so the offset between them does not depend on what the
+ * main loop is doing. The callbacks run in interrupt context and must be short.
+ *
+ * On the host build there are no timer interrupts: the events are generated from stats_utils::ticks() by service(),
+ * which the code waiting on the timer must call in its wait loops. On the Due, service() does nothing.
+ */
+namespace timer_utils {
+
+	typedef void (*Callback)(void);
+
+	///
+	/// Starts the timer. The first update event happens one period after the call.
+	/// offsetUs must be smaller than periodUs. Either callback may be null.
+	/// \returns 0 if successful, 1 if the period or offset is invalid.
+	///
+	uint8_t begin(uint32_t periodUs, uint32_t offsetUs, Callback onUpdate, Callback onSample);
+	void stop(void);
+	bool running(void);
+	void service(void);
+}
+
+#endif // TIMER_H
@@ -89,6 +89,13 @@ namespace spi_utils
  *
  * For example, if the serial message is "SET, 1: 4.2", the `cmd` array will be {SET, 1, 4.2}, and the function will return 3.
  *
+ * Several commands can share one message when separated by ";". Each ";" is stored as an element of its own, so
+ * "DAC_WRITE,0,1;ADC_GET,0" becomes {DAC_WRITE, 0, 1, ;, ADC_GET, 0}, and the caller splits the batch at those elements.
+ * A message never fills more than `kMaxFields` elements; further fields are dropped.
+ *
+ * A command may start with a request ID field, "#17, SET, 1: 4.2". `takeRequestId` removes it from the `cmd` array, and
+ * `printEvent` prints the "@17,ACK,SET" and "@17,DONE,elapsed_us" lines that frame the reply of such a command.
+ *
  * This namespace is used in the main `loop` function to process incoming serial commands. It extracts the command and its
  * parameters from the serial message and calls the appropriate router function to handle the command.
  *
@@ -96,9 +103,16 @@ namespace spi_utils
  * extracting individual values for further processing.
  */
 namespace interface_utils {
+    ///
+    /// Size of the cmd[] array passed to querySerial
+    ///
+    static const uint8_t kMaxFields = 64;
+
     ///
     /// Parses and stores values separated by "," or ":" from serial message to cmd[]
-    /// Returns number of values
+    /// A ";" ends the current value and is stored as a value of its own
+    /// Returns number of values, or kMaxFields + 1 when the message holds more values than
+    /// cmd[] can store; cmd[] then keeps the first kMaxFields and the rest of the line is dropped
     /// Example: if Serial message "SET, 1: 4.2"
     /// cmd[] will be {SET, 1, 4.2} and returns 3
     ///
@@ -110,6 +124,8 @@ namespace interface_utils {
 
         uint8_t cmdSize = 0;
 
+        bool overflow = false;
+
         while (received != '\r') {
 
             if(Serial.available()) {
@@ -118,13 +134,17 @@ namespace interface_utils {
 
                 if (received == '\n' || received == ' ') {}
 
-                else if (received == ',' || received == '\r' || received == ':') {
+                else if (received == ',' || received == '\r' || received == ':' || received == ';') {
 
-                    cmd[cmdSize] = cmdElement;
+                    if (cmdSize < kMaxFields) {cmd[cmdSize++] = cmdElement;}
+                    else {overflow = true;}
 
                     cmdElement = "";
 
-                    ++cmdSize;
+                    if (received == ';') {
+                        if (cmdSize < kMaxFields) {cmd[cmdSize++] = ";";}
+                        else {overflow = true;}
+                    }
                 }
 
                 else {
@@ -133,7 +153,60 @@ namespace interface_utils {
                 }
             }
         }
-            return cmdSize;
+            return overflow ? kMaxFields + 1 : cmdSize;
+    }
+
+    ///
+    /// Discards the line that stopped a running command, e.g. the byte sent to abort
+    /// AWG_RUN, so that it is not read as the start of the next command
+    /// Reads up to and including '\r', or until no byte arrives for timeoutMs
+    ///
+    static void discardLine(uint32_t timeoutMs) {
+
+        uint32_t last = millis();
+
+        while (millis() - last < timeoutMs) {
+
+            if (Serial.available()) {
+
+                last = millis();
+
+                if (Serial.read() == '\r') {return;}
+            }
+        }
+    }
+
+    ///
+    /// Removes a leading request ID field from cmd[] and returns it without the '#'
+    /// Returns an empty String when the command carries no ID
+    /// Example: if Serial message "#17, DAC_WRITE, 0, 1.5"
+    /// returns "17", cmd[] becomes {DAC_WRITE, 0, 1.5} and cmdSize 3
+    ///
+    static String takeRequestId(String cmd[], uint8_t& cmdSize) {
+
+        if (cmdSize == 0 || !cmd[0].startsWith("#")) {return "";}
+
+        String id = cmd[0].substring(1);
+
+        for (uint8_t i = 1; i < cmdSize; i++) {
+            cmd[i - 1] = cmd[i];
+        }
+
+        --cmdSize;
+        cmd[cmdSize] = "";
+        return id;
+    }
+
+    ///
+    /// Prints a request event line: "@id,EVENT,detail"
+    ///
+    static void printEvent(const String& id, const char* event, const String& detail) {
+        Serial.print("@");
+        Serial.print(id);
+        Serial.print(",");
+        Serial.print(event);
+        Serial.print(",");
+        Serial.println(detail);
     }
 }
 
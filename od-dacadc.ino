@@ -12,7 +12,14 @@
 #include "include/ad5791.h"
 #include "include/ad4115.h"
 #include "include/ramp.h"
+#include "include/capture.h"
+#include "include/awg.h"
+#include "include/pid.h"
+#include "include/lockin.h"
+#include "include/batch.h"
+#include "include/sequencer.h"
 #include "include/utils.h"
+#include "include/stats.h"
 #include <SPI.h>
 #include <stdint.h>
 #include <cstdlib>
@@ -24,9 +31,14 @@
  * This code snippet initializes the necessary objects for DAC, ADC, and RAMPS functionality. It defines an array
  * 'channels' representing the DAC sync pins. The AD5791 object 'dac' is created using the constructor that takes the
  * sync pins array and an 'ldac' pin as parameters. The AD4115 object 'adc' is created using the constructor that takes
- * the sync pin and 'drdy' (MISO) pin as parameters. Finally, the RAMPS object 'ramp_fs' is created using the constructor
+ * the sync pin and 'drdy' (MISO) pin as parameters. The RAMPS object 'ramp_fs' is created using the constructor
  * that takes the 'dac' and 'adc' objects as parameters, allowing the RAMPS object to utilize the functions from the
- * AD5791 and AD4115 classes.
+ * AD5791 and AD4115 classes. The CAPTURE object 'capture' records bursts of raw samples from 'adc'. Finally, the AWG
+ * object 'awg' plays uploaded waveform tables on 'dac', optionally sampling 'adc', and the PID object 'pid' holds an
+ * 'adc' reading at a setpoint by driving a 'dac' channel. The LOCKIN object 'lockin' excites a 'dac' channel with a
+ * sinusoid and demodulates the 'adc' readings. The BATCH object 'batch' runs binary frames of 'dac' writes and 'adc'
+ * scans sent with BATCH_BIN, and the SEQUENCER object 'sequencer' interprets uploaded bytecode programs that drive 'dac'
+ * and read 'adc' without serial round trips.
  */
 uint8_t channels[4] = {11, 8, 5, 2}; //Dac sync pins
 
@@ -36,6 +48,20 @@ AD4115 adc(32, 28); //Constructor: sync pin, drdy(MISO)
 
 RAMPS ramp_fs(dac, adc); //Constructor: ramp_fs uses AD5791 and AD4115 functions.
 
+CAPTURE capture(adc); //Constructor: capture records raw AD4115 samples.
+
+AWG awg(dac, adc); //Constructor: awg plays waveform tables on the AD5791 channels.
+
+PID pid(dac, adc); //Constructor: pid feeds an AD4115 channel back to an AD5791 channel.
+
+LOCKIN lockin(dac, adc); //Constructor: lockin demodulates the AD4115 channels against an AD5791 excitation.
+
+BATCH batch(dac, adc); //Constructor: batch runs binary frames of AD5791 writes and AD4115 scans.
+
+SEQUENCER sequencer(dac, adc); //Constructor: sequencer runs bytecode programs on the AD5791 and AD4115.
+
+bool deferLdac = false; //Set by an ATOMIC batch: DAC_WRITE loads the DAC register and leaves the LDAC to Batch()
+
 /**
 
 @brief Setup function for the RAMPS application.
@@ -45,6 +71,7 @@ It also resets the ADC.
 */
 void setup() {
   Serial.begin(115200);
+  stats_utils::begin();
   dac.begin(); 
   dac.initialize();
   adc.resetAdc();
@@ -72,8 +99,18 @@ void setup() {
  * the command array and calls the appropriate methods from the RAMPS object to perform the ramp operation. It also prints
  * debugging information if uncommented.
  * 
+ * The WAVEFORM COMMANDS SECTION uploads waveform tables and plays them back through the AWG object, and runs the
+ * lock-in measurement through the LOCKIN object.
+ * 
+ * The BATCH COMMANDS SECTION runs a binary frame of DAC writes, LDAC updates, ADC scans and delays sent with BATCH_BIN.
+ * 
+ * The SEQUENCER COMMANDS SECTION uploads a bytecode program (loops, DAC writes, delays, ADC reads, comparisons,
+ * branches and emitted values) and runs it on the device through the SEQUENCER object.
+ * 
+ * The FEEDBACK COMMANDS SECTION configures, starts and stops the on-device PID loop and reports its statistics.
+ * 
  * The DEBUGGING COMMANDS SECTION handles special debugging commands that perform specific actions, such as printing debug
- * messages or retrieving ID information.
+ * messages or retrieving ID information. It also reports and clears the hot-path timing counters (STATS?, STATS_RESET).
  *
  * Overall, the 'Router' function serves as a central router for interpreting commands and executing the corresponding
  * actions based on the command type. It utilizes the DAC, ADC, and RAMPS objects to perform the required operations.
@@ -86,11 +123,12 @@ uint8_t Router(String cmd[], uint8_t cmdSize) {
 
   //DAC COMMANDS SECTION
   if (command == "DAC_WRITE") {
-    voltage = dac.setVoltage(cmd[1].toInt(), cmd[2].toFloat(), true);
+    voltage = dac.setVoltage(cmd[1].toInt(), cmd[2].toFloat(), !deferLdac);
     
     Serial.print("DAC #");
     Serial.print(cmd[1].toInt());
-    Serial.print(" | UPDATED TO ");
+    //A deferred write has only loaded the DAC register, the output changes at the batch's LDAC
+    Serial.print(deferLdac ? " | LOADED TO " : " | UPDATED TO ");
     Serial.print(voltage, 5);
     Serial.println("V");
   }
@@ -125,6 +163,35 @@ uint8_t Router(String cmd[], uint8_t cmdSize) {
     Serial.println(data);
   }
 
+  else if (command == "BURST") {
+    //BURST, 10000
+    capture.burst(cmd[1].toInt());
+    capture.stream();
+    return 0;
+  }
+
+  else if (command == "TRIG_CAPTURE") {
+    //TRIG_CAPTURE, channel, level, edge, pre, post, timeout_ms
+    //TRIG_CAPTURE, 0, 1.5, 0, 1000, 4000, 10000
+    uint8_t result = capture.levelTrigger(cmd[1].toInt(), std::atof(cmd[2].c_str()), cmd[3].toInt(),
+                                          cmd[4].toInt(), cmd[5].toInt(), cmd[6].toInt());
+    capture.streamTriggered(result);
+    return 0;
+  }
+
+  else if (command == "TRIG_PIN_CAPTURE") {
+    //TRIG_PIN_CAPTURE, pin, edge, pre, post, timeout_ms
+    //TRIG_PIN_CAPTURE, 22, 0, 1000, 4000, 10000
+    uint8_t result = capture.pinTrigger(cmd[1].toInt(), cmd[2].toInt(), cmd[3].toInt(), cmd[4].toInt(), cmd[5].toInt());
+    capture.streamTriggered(result);
+    return 0;
+  }
+
+  else if (command == "BURST_CAPACITY?") {
+    Serial.println(capture.capacity());
+    return 0;
+  }
+
   else if (command == "SETUP_CONFIG") {
     voltage = adc.setupConfig();
   }
@@ -184,7 +251,9 @@ uint8_t Router(String cmd[], uint8_t cmdSize) {
 
 
     //inputs: RAMP, ch1, ch2, ch3, ch4, vi1, vi2, vi3, vi4, vf1, vf2, vf3, vf4, nsteps, delay, buffer
-    ramp_fs.simpleRamp(channelsDac, vi, vf, cmd[13].toInt(), std::atof(cmd[14].c_str()), false);
+    if (ramp_fs.simpleRamp(channelsDac, vi, vf, cmd[13].toInt(), std::atof(cmd[14].c_str()), false) == 1) {
+      Serial.println("SYNC TIMEOUT");
+    }
   }
 
   else if (command == "BUFFER_RAMP") {
@@ -236,7 +305,330 @@ uint8_t Router(String cmd[], uint8_t cmdSize) {
 
 
     //inputs: RAMP, ch1, ch2, ch3, ch4, vi1, vi2, vi3, vi4, vf1, vf2, vf3, vf4, nsteps, delay, buffer
-    ramp_fs.simpleRamp(channelsDac, vi, vf, cmd[13].toInt(), std::atof(cmd[14].c_str()), true);
+    //RAMP_PERIOD and RAMP_TIMED keep the timed offset below the step period; the check in simpleRamp is a safeguard
+    uint8_t result = ramp_fs.simpleRamp(channelsDac, vi, vf, cmd[13].toInt(), std::atof(cmd[14].c_str()), true);
+    if (result == 1) {
+      Serial.println("SYNC TIMEOUT");
+    }
+    else if (result == 2) {
+      Serial.println("INVALID TIMED OFFSET");
+    }
+  }
+
+
+  else if (command == "SLEW_RAMP") {
+    //SLEW_RAMP, ch1, ch2, ch3, ch4, vi1, vi2, vi3, vi4, vf1, vf2, vf3, vf4, slew1, slew2, slew3, slew4, step1, step2, step3, step4, buffer
+    //Slew rates in V/s, step sizes in V
+    //SLEW_RAMP, 1, 1, 0, 0, 0, 0, 0, 0, 2, 1, 0, 0, 0.5, 1, 1, 1, 0.001, 0.001, 1, 1, 1
+    uint8_t channelsDac[4] = {0, 0, 0, 0};
+    double vi[4] = {0, 0, 0, 0};
+    double vf[4] = {0, 0, 0, 0};
+    double maxSlew[4] = {0, 0, 0, 0};
+    double maxStep[4] = {0, 0, 0, 0};
+
+    for (int i = 0; i < 4; i++){
+      channelsDac[i] = cmd[i + 1].toInt();
+      vi[i] = std::atof(cmd[i + 5].c_str());
+      vf[i] = std::atof(cmd[i + 9].c_str());
+      maxSlew[i] = std::atof(cmd[i + 13].c_str());
+      maxStep[i] = std::atof(cmd[i + 17].c_str());
+    }
+
+    uint8_t result = ramp_fs.slewRamp(channelsDac, vi, vf, maxSlew, maxStep, cmd[21].toInt() == 1);
+    if (result == 1) {
+      Serial.println("INVALID SLEW LIMITS");
+    }
+    else if (result == 2) {
+      //vi must be within one step of the present output, see RAMPS::slewRamp
+      Serial.println("INVALID SLEW START");
+    }
+  }
+
+  else if (command == "ADAPTIVE_RAMP") {
+    //ADAPTIVE_RAMP, ch1, ch2, ch3, ch4, vi1, vi2, vi3, vi4, vf1, vf2, vf3, vf4, minStep, maxStep, threshold, delay
+    //Steps and threshold in V, delay in ms
+    //ADAPTIVE_RAMP, 1, 0, 0, 0, -2, 0, 0, 0, 2, 0, 0, 0, 0.0005, 0.05, 0.01, 1
+    uint8_t channelsDac[4] = {0, 0, 0, 0};
+    double vi[4] = {0, 0, 0, 0};
+    double vf[4] = {0, 0, 0, 0};
+
+    for (int i = 0; i < 4; i++){
+      channelsDac[i] = cmd[i + 1].toInt();
+      vi[i] = std::atof(cmd[i + 5].c_str());
+      vf[i] = std::atof(cmd[i + 9].c_str());
+    }
+
+    if (ramp_fs.adaptiveRamp(channelsDac, vi, vf, std::atof(cmd[13].c_str()), std::atof(cmd[14].c_str()),
+                             std::atof(cmd[15].c_str()), std::atof(cmd[16].c_str())) != 0) {
+      Serial.println("INVALID ADAPTIVE RAMP");
+    }
+  }
+
+  else if (command == "PATH_CLEAR") {
+    ramp_fs.pathClear();
+    Serial.println("PATH CLEARED");
+  }
+
+  else if (command == "PATH_ADD") {
+    //PATH_ADD, v1, v2, v3, v4, nSteps, dwell_ms
+    //PATH_ADD, 0, 0, 0, 0, 0, 0
+    //PATH_ADD, 2, 0, 0, 0, 100, 50
+    double v[4] = {0, 0, 0, 0};
+
+    for (int i = 1; i < 5; i++){
+      v[i - 1] = std::atof(cmd[i].c_str());
+    }
+
+    uint8_t n = ramp_fs.pathAdd(v, cmd[5].toInt(), cmd[6].toInt());
+    if (n == 0) {Serial.println("PATH FULL");}
+    else {
+      Serial.print("PATH VERTEX ");
+      Serial.println(n);
+    }
+  }
+
+  else if (command == "PATH_RUN") {
+    //PATH_RUN, ch1, ch2, ch3, ch4, delay, buffer
+    //PATH_RUN, 1, 0, 0, 0, 10, 1
+    uint8_t channelsDac[4] = {0, 0, 0, 0};
+
+    for (int i = 1; i < 5; i++){
+      channelsDac[i - 1] = cmd[i].toInt();
+    }
+
+    ramp_fs.pathRun(channelsDac, std::atof(cmd[5].c_str()), cmd[6].toInt() == 1);
+  }
+
+  else if (command == "RASTER") {
+    //RASTER, fastCh, fastVi, fastVf, fastPoints, slowCh, slowVi, slowVf, slowLines, settle_us, retrace_ms, serpentine
+    //RASTER, 0, -1, 1, 200, 1, -2, 2, 100, 500, 20, 1
+    RasterAxis fast = {(uint8_t) cmd[1].toInt(), std::atof(cmd[2].c_str()), std::atof(cmd[3].c_str()), (uint32_t) cmd[4].toInt()};
+    RasterAxis slow = {(uint8_t) cmd[5].toInt(), std::atof(cmd[6].c_str()), std::atof(cmd[7].c_str()), (uint32_t) cmd[8].toInt()};
+
+    if (ramp_fs.raster(fast, slow, cmd[9].toInt(), cmd[10].toInt(), cmd[11].toInt() == 1) != 0) {
+      Serial.println("INVALID RASTER AXES");
+    }
+  }
+
+  else if (command == "RAMP_PERIOD") {
+    //RAMP_PERIOD, 5000 -- must stay larger than the RAMP_TIMED offset while the timed mode is on
+    if (ramp_fs.setStepPeriod(cmd[1].toInt()) == 0) {
+      Serial.print("RAMP PERIOD SET TO ");
+      Serial.print(cmd[1].toInt());
+      Serial.println("us");
+    }
+    else {
+      Serial.println("INVALID RAMP PERIOD");
+    }
+  }
+
+
+  else if (command == "RAMP_OVERSAMPLE") {
+    //RAMP_OVERSAMPLE, nReadings, stats
+    //RAMP_OVERSAMPLE, 16, 1
+    ramp_fs.setOversampling(cmd[1].toInt(), cmd[2].toInt() == 1);
+    Serial.print("RAMP OVERSAMPLING SET TO ");
+    Serial.println(cmd[1].toInt());
+  }
+
+
+  else if (command == "RAMP_SWEEP") {
+    //RAMP_SWEEP, cycles (0 for one-way ramps)
+    //RAMP_SWEEP, 2
+    //Sweeps have no pipelined or timed variant, RAMP_PIPELINE and RAMP_TIMED must be off
+    if (ramp_fs.setSweep(cmd[1].toInt()) == 0) {
+      Serial.print("RAMP SWEEP CYCLES SET TO ");
+      Serial.println(cmd[1].toInt());
+    }
+    else {
+      Serial.println("INVALID SWEEP MODE");
+    }
+  }
+
+  else if (command == "RAMP_PIPELINE") {
+    //RAMP_PIPELINE, 1
+    //Pipelined BUFFER_RAMP sends 3 raw bytes per enabled ADC channel and point, then RAMP_DONE
+    if (ramp_fs.setPipelined(cmd[1].toInt() == 1) == 0) {
+      Serial.print("RAMP PIPELINE ");
+      Serial.println(cmd[1].toInt() == 1 ? "ON" : "OFF");
+    }
+    else {
+      Serial.println("INVALID SWEEP MODE");
+    }
+  }
+
+  else if (command == "RAMP_TIMED") {
+    //RAMP_TIMED, offset_us (0 disables). Needs RAMP_PERIOD larger than the offset.
+    //RAMP_TIMED, 200
+    uint8_t result = ramp_fs.setTimed(cmd[1].toInt());
+    if (result == 0) {
+      Serial.print("RAMP TIMED OFFSET SET TO ");
+      Serial.print(cmd[1].toInt());
+      Serial.println("us");
+    }
+    else if (result == 2) {
+      Serial.println("INVALID SWEEP MODE");
+    }
+    else {
+      Serial.println("INVALID TIMED OFFSET");
+    }
+  }
+
+  else if (command == "RAMP_SYNC") {
+    //RAMP_SYNC, pin, edge, timeout_ms, drive (pin -1 disables)
+    //edge: 0 rising, 1 falling, 2 any. drive 1 makes this board the leader that produces the edge.
+    //Synced ramps print SYNC_ARMED, wait for the edge, then write '+' and stream, or '!' and a SYNC TIMEOUT line on
+    //timeout or on a host byte
+    //RAMP_SYNC, 22, 0, 10000, 0
+    if (ramp_fs.setSync(cmd[1].toInt(), cmd[2].toInt(), cmd[3].toInt(), cmd[4].toInt() == 1) == 0) {
+      Serial.print("RAMP SYNC ");
+      Serial.println(cmd[1].toInt() >= 0 ? "ON" : "OFF");
+    }
+    else {
+      Serial.println("INVALID SYNC CONFIG");
+    }
+  }
+
+  else if (command == "FILTER_CONFIG") {
+    //FILTER_CONFIG, channel, type, param, divider
+    //type: 0 none, 1 moving average, 2 CIC, 3 IIR
+    //FILTER_CONFIG, 0, 2, 3, 16
+    if (ramp_fs.filter.configure(cmd[1].toInt(), cmd[2].toInt(), cmd[3].toInt(), cmd[4].toInt()) == 0) {
+      Serial.println("FILTER CONFIGURED");
+    }
+    else {
+      Serial.println("INVALID FILTER CONFIG");
+    }
+  }
+
+  else if (command == "FILTER_RESET") {
+    ramp_fs.filter.reset();
+    Serial.println("FILTER RESET");
+  }
+
+
+  //WAVEFORM COMMANDS SECTION
+  else if (command == "AWG_LOAD") {
+    //AWG_LOAD, channelMask, nPoints -- then wait for AWG_READY and send 3 bytes per code
+    //AWG_LOAD, 3, 1000
+    uint8_t result = awg.load(cmd[1].toInt(), cmd[2].toInt());
+    if (result == 0) {
+      Serial.print("AWG_LOADED,");
+      Serial.println(cmd[2].toInt());
+    }
+    else if (result == 1) {Serial.println("AWG TABLE TOO LARGE");}
+    else {Serial.println("AWG LOAD TIMEOUT");}
+  }
+
+  else if (command == "AWG_RUN") {
+    //AWG_RUN, period_us, loops, sample_offset_us
+    //AWG_RUN, 100, 10, 0
+    if (awg.run(cmd[1].toInt(), cmd[2].toInt(), cmd[3].toInt()) != 0) {
+      Serial.println("AWG NOT READY");
+    }
+  }
+
+  else if (command == "AWG_CAPACITY?") {
+    //AWG_CAPACITY?, channelMask
+    Serial.println(awg.capacity(cmd[1].toInt()));
+  }
+
+
+  //BATCH COMMANDS SECTION
+  else if (command == "BATCH_BIN") {
+    //BATCH_BIN, nBytes -- the frame follows the command line at once, see include/batch.h for the opcodes
+    //BATCH_BIN, 12
+    uint8_t result = batch.run(cmd[1].toInt());
+    if (result == 1) {Serial.println("INVALID BATCH");}
+    else if (result == 2) {Serial.println("BATCH TIMEOUT");}
+  }
+
+
+  //SEQUENCER COMMANDS SECTION
+  else if (command == "SEQ_LOAD") {
+    //SEQ_LOAD, nBytes -- the program follows the command line at once, see include/sequencer.h for the opcodes
+    //SEQ_LOAD, 42
+    uint8_t result = sequencer.load(cmd[1].toInt());
+    if (result == 0) {
+      Serial.print("SEQ_LOADED,");
+      Serial.println(cmd[1].toInt());
+    }
+    else if (result == 1) {Serial.println("INVALID SEQ PROGRAM");}
+    else {Serial.println("SEQ LOAD TIMEOUT");}
+  }
+
+  else if (command == "SEQ_RUN") {
+    //SEQ_RUN, r0, r1, ... -- up to 8 initial register values, the others start at 0
+    //SEQ_RUN, 100, -5000
+    int32_t initial[SEQUENCER::kRegisters];
+    uint8_t nInitial = 0;
+    for (uint8_t i = 1; i < cmdSize && nInitial < SEQUENCER::kRegisters; i++) {
+      initial[nInitial++] = cmd[i].toInt();
+    }
+    if (sequencer.run(initial, nInitial) != 0) {
+      Serial.println("SEQ NOT LOADED");
+    }
+  }
+
+
+  else if (command == "LOCKIN_CONFIG") {
+    //LOCKIN_CONFIG, dacChannel, amplitude, offset, frequency_hz, pointsPerCycle, sample_offset_us, phase_deg, tau_ms, order, outputRate_hz
+    //LOCKIN_CONFIG, 0, 0.1, 0, 17.77, 64, 200, 0, 300, 2, 5
+    if (lockin.configure(cmd[1].toInt(), std::atof(cmd[2].c_str()), std::atof(cmd[3].c_str()), std::atof(cmd[4].c_str()),
+                         cmd[5].toInt(), cmd[6].toInt(), std::atof(cmd[7].c_str()), std::atof(cmd[8].c_str()),
+                         cmd[9].toInt(), std::atof(cmd[10].c_str())) == 0) {
+      Serial.print("LOCKIN_CONFIG,");
+      Serial.print(lockin.frequency(), 6);
+      Serial.print(",");
+      Serial.print(lockin.timeConstantMs(), 3);
+      Serial.print(",");
+      Serial.println(lockin.decimation());
+    }
+    else {
+      Serial.println("INVALID LOCKIN CONFIG");
+    }
+  }
+
+  else if (command == "LOCKIN_RUN") {
+    //LOCKIN_RUN, duration_ms (0 runs until any byte is sent)
+    //LOCKIN_RUN, 10000
+    if (lockin.run(cmd[1].toInt()) != 0) {
+      Serial.println("LOCKIN NOT CONFIGURED");
+    }
+  }
+
+
+  //FEEDBACK COMMANDS SECTION
+  else if (command == "PID_CONFIG") {
+    //PID_CONFIG, adcChannel, dacChannel, setpoint, kp, ki, kd, outMin, outMax, maxSlew
+    //Setpoint and limits in V, maxSlew in V per loop (0 for no limit)
+    //PID_CONFIG, 0, 1, 0.5, 0.2, 0.01, 0, -5, 5, 0.01
+    if (pid.configure(cmd[1].toInt(), cmd[2].toInt(), std::atof(cmd[3].c_str()), std::atof(cmd[4].c_str()),
+                      std::atof(cmd[5].c_str()), std::atof(cmd[6].c_str()), std::atof(cmd[7].c_str()),
+                      std::atof(cmd[8].c_str()), std::atof(cmd[9].c_str())) == 0) {
+      Serial.println("PID CONFIGURED");
+    }
+    else {
+      Serial.println("INVALID PID CONFIG");
+    }
+  }
+
+  else if (command == "PID_START") {
+    if (pid.start() == 0) {
+      Serial.println("PID STARTED");
+    }
+    else {
+      Serial.println("PID ADC CHANNEL NOT ENABLED");
+    }
+  }
+
+  else if (command == "PID_STOP") {
+    pid.stop();
+    Serial.println("PID STOPPED");
+  }
+
+  else if (command == "PID_STATS?") {
+    pid.report();
   }
 
 
@@ -266,6 +658,107 @@ uint8_t Router(String cmd[], uint8_t cmdSize) {
     Serial.print("ID code is ");
     Serial.println(id);
   }
+
+  else if (command == "STATS?") {
+    //STATS?
+    stats_utils::report();
+    return 0;
+  }
+
+  else if (command == "STATS_RESET") {
+    stats_utils::reset();
+    Serial.println("STATS RESET");
+    return 0;
+  }
+}
+
+/**
+ * @file main.cpp
+ * @brief Batch function for running several commands received in one message.
+ *
+ * The commands of a message separated by ";" ("DAC_WRITE,0,1;DAC_WRITE,1,-1;ADC_GET,0") are passed to 'Router' one after
+ * the other, each with its own reply, and the batch ends with "BATCH_DONE,commands,elapsed_us". A batch costs the host a
+ * single round trip however many commands it holds.
+ *
+ * When the first command is ATOMIC, consecutive DAC_WRITE commands only load the DAC registers, and the outputs change
+ * together with a single LDAC before the next command of another kind, or at the end of the batch. Each of these
+ * DAC_WRITE replies reads "DAC #n | LOADED TO v V", since the output has not changed yet when it is printed.
+ *
+ * AWG_LOAD, BATCH_BIN and SEQ_LOAD read a payload that follows their command line, which a batch cannot carry. A batch
+ * holding one of them is rejected with "INVALID BATCH COMMAND" before any of its commands runs.
+ */
+void Batch(String cmd[], uint8_t cmdSize) {
+
+  uint32_t start = micros();
+  uint8_t first = 0;
+  uint8_t count = 0;
+  bool atomic = false;
+  bool pendingLdac = false;
+
+  for (uint8_t i = 0; i < cmdSize; i++) {
+    bool head = (i == 0 || cmd[i - 1] == ";");
+    if (head && (cmd[i] == "AWG_LOAD" || cmd[i] == "BATCH_BIN" || cmd[i] == "SEQ_LOAD")) {
+      Serial.print("INVALID BATCH COMMAND ");
+      Serial.println(cmd[i]);
+      return;
+    }
+  }
+
+  for (uint8_t i = 0; i <= cmdSize; i++) {
+    if (i < cmdSize && cmd[i] != ";") {continue;}
+
+    uint8_t n = i - first;
+    if (n > 0 && cmd[first].length() > 0) {
+      if (count == 0 && !atomic && cmd[first] == "ATOMIC") {
+        atomic = true;
+      }
+      else {
+        //Router reads fixed argument positions, so each command gets an array of its own
+        String segment[interface_utils::kMaxFields];
+        for (uint8_t k = 0; k < n; k++) {segment[k] = cmd[first + k];}
+
+        bool write = segment[0] == "DAC_WRITE";
+        if (pendingLdac && !write) {
+          dac.updateAnalogOutputs();
+          pendingLdac = false;
+        }
+        deferLdac = atomic && write;
+        Router(segment, n);
+        pendingLdac = pendingLdac || deferLdac;
+        deferLdac = false;
+        count++;
+      }
+    }
+    first = i + 1;
+  }
+
+  if (pendingLdac) {dac.updateAnalogOutputs();}
+
+  Serial.print("BATCH_DONE,");
+  Serial.print(count);
+  Serial.print(",");
+  Serial.println(micros() - start);
+}
+
+/**
+ * @brief Runs one parsed message: a batch when it holds ";" separators, a single command otherwise.
+ *
+ * A message with more values than 'cmd' can hold (see 'interface_utils::querySerial') is rejected with "MESSAGE TOO
+ * LONG" and none of its commands runs, since its tail has been dropped.
+ */
+void Execute(String cmd[], uint8_t cmdSize, bool overflow) {
+  if (overflow) {
+    Serial.println("MESSAGE TOO LONG");
+    return;
+  }
+
+  for (uint8_t i = 0; i < cmdSize; i++) {
+    if (cmd[i] == ";") {
+      Batch(cmd, cmdSize);
+      return;
+    }
+  }
+  Router(cmd, cmdSize);
 }
 
 /**
@@ -277,11 +770,18 @@ uint8_t Router(String cmd[], uint8_t cmdSize) {
  * the size of the command in the 'cmdSize' variable using the 'interface_utils::querySerial' function.
  *
  * The 'Router' function is then called, passing the 'cmd' array and 'cmdSize' as parameters. The 'Router' function handles the
- * command and performs the corresponding actions based on the command type.
+ * command and performs the corresponding actions based on the command type. A message of several commands separated by ";"
+ * goes through the 'Batch' function instead.
+ *
+ * A command that starts with a request ID ("#17, DAC_WRITE, 0, 1.5") is acknowledged with "@17,ACK,DAC_WRITE" as soon as
+ * it is parsed, and its reply, whatever its shape, is followed by "@17,DONE,elapsed_us". The host can then pipeline any
+ * command and match replies to requests without knowing how many lines each command prints.
  *
  * The loop function also includes a call to 'Serial.flush()' to ensure that any pending data in the Serial buffer is cleared
  * before processing new commands.
  *
+ * After the command, if any, one iteration of the on-device PID loop is run when it has been started with PID_START.
+ *
  * Overall, the loop function continuously listens for commands through the Serial interface and processes them using the
  * 'Router' function.
  */
@@ -291,11 +791,28 @@ void loop() {
   
   if (Serial.available()) {
       
-      String cmd[30];
+      String cmd[interface_utils::kMaxFields];
       uint8_t cmdSize;
       
       cmdSize = interface_utils::querySerial(cmd);
-      
-      Router(cmd, cmdSize);
+
+      bool overflow = cmdSize > interface_utils::kMaxFields;
+      if (overflow) {cmdSize = interface_utils::kMaxFields;}
+
+      String requestId = interface_utils::takeRequestId(cmd, cmdSize);
+
+      if (requestId.length() == 0) {
+        Execute(cmd, cmdSize, overflow);
+      }
+      else {
+        //Tagged command: ack before running it, completion event with the run time after its reply
+        interface_utils::printEvent(requestId, "ACK", cmd[0]);
+        uint32_t start = micros();
+        Execute(cmd, cmdSize, overflow);
+        interface_utils::printEvent(requestId, "DONE", String((unsigned long) (micros() - start)));
+      }
    }
+
+  //The feedback loop runs whenever no command is pending
+  pid.service();
 }
@@ -1,4 +1,5 @@
 #include "../include/ad4115.h"
+#include "../include/stats.h"
 #include <stdint.h>
 #include <SPI.h>
 #include <cstdlib>
@@ -57,6 +58,7 @@ uint8_t AD4115::resetAdc(void) {
  * the state of the DRDY pin. The function exits when the DRDY pin transitions to a LOW state.
  */
 void AD4115::waitDrdy(void) {
+	stats_utils::ScopedTimer timer(stats_utils::DRDY_WAIT);
 	while (digitalRead(_drdy) == HIGH) {} 
 }
 
@@ -576,6 +578,139 @@ void AD4115::adcMode(void) {
     SPI.endTransaction();
 }
 
+/**
+ * @brief Generates a continuous conversion mode message for the AD4115 ADC.
+ *
+ * This function generates an ADC mode message identical to adcModeMsg() except for the operating mode, which is set to
+ * continuous conversion. In this mode the ADC converts the enabled channels one after the other at the configured
+ * output data rate and signals every new result on DRDY.
+ *
+ * @return A spi_utils::Message object containing the generated ADC mode message.
+ */
+spi_utils::Message AD4115::continuousModeMsg(void) {
+
+	spi_utils::Message msg;
+
+    // 000001 -- Address [0:5]
+    // 0 -- WRITE [6]
+    // 0 -- WEN [7]
+    msg.msg[0] = 0x01; // Send 0000 0001
+
+    // Delay [8:10] -- 000 (e.g. 0 microsecs)
+    // Reserved [11:12] -- 00
+    // ON if single channel active [13] -- 0 (e.g. disabled)
+    // Reserved [14] -- 0
+    // REF_EN [15] -- 0 (e.g. disabled)
+    msg.msg[1] = 0x00; // Send 0000 0000
+
+    // Reserved [0:1] -- 00
+    // ADC clock source [2:3] -- 11
+    // Operating mode [4:6] -- 000 (e.g. continuous conversion mode)
+    // Reserved [7] -- 0
+    msg.msg[2] = 0x0C; // Send 0000 1100
+
+    return msg;
+}
+
+/**
+ * @brief Generates a standby mode message for the AD4115 ADC.
+ *
+ * This function generates an ADC mode message that puts the ADC in standby mode, which stops a continuous conversion.
+ * The next call to adcMode() switches the ADC back to single conversion mode.
+ *
+ * @return A spi_utils::Message object containing the generated ADC mode message.
+ */
+spi_utils::Message AD4115::standbyModeMsg(void) {
+
+	spi_utils::Message msg;
+
+    msg.msg[0] = 0x01; // ADC mode register
+    msg.msg[1] = 0x00;
+
+    // ADC clock source [2:3] -- 11
+    // Operating mode [4:6] -- 010 (e.g. standby mode)
+    msg.msg[2] = 0x2C; // Send 0010 1100
+
+    return msg;
+}
+
+/**
+ * @brief Starts continuous conversion of the enabled channels.
+ *
+ * This function sends the continuous conversion mode message and leaves the _adcSync pin LOW so that the DRDY signal
+ * of every new conversion is visible on the MISO line. The ADC sequences through the enabled channels in ascending
+ * order. Results must be collected with readSample() until stopContinuous() is called.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t AD4115::startContinuous(void) {
+
+	spi_utils::Message msg = continuousModeMsg();
+
+	msg.blockSize = 3;
+	msg.nBlocks = 1;
+
+	SPI.beginTransaction(adcSettings);
+
+	digitalWrite(_adcSync, LOW);
+
+	for (uint8_t db = 0; db < msg.blockSize; db++) {
+		SPI.transfer(msg.msg[db]);
+	}
+	SPI.endTransaction();
+
+	return 0;
+}
+
+/**
+ * @brief Reads the next conversion result in continuous conversion mode.
+ *
+ * This function waits for DRDY and reads the data register. The three raw bytes of the result are copied, most
+ * significant byte first, into 'sample'. No voltage conversion is done so that the call stays short enough to keep up
+ * with the ADC's native output data rate.
+ *
+ * @param sample Array of 3 bytes receiving the raw 24-bit result.
+ * @return 0 indicating successful execution.
+ */
+uint8_t AD4115::readSample(uint8_t sample[3]) {
+
+	waitDrdy();
+	dataReading();
+
+	sample[0] = _dataRead[0];
+	sample[1] = _dataRead[1];
+	sample[2] = _dataRead[2];
+
+	return 0;
+}
+
+/**
+ * @brief Stops continuous conversion.
+ *
+ * This function puts the ADC in standby mode and sets the _adcSync pin HIGH, ending a continuous acquisition started
+ * with startContinuous().
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t AD4115::stopContinuous(void) {
+
+	spi_utils::Message msg = standbyModeMsg();
+
+	msg.blockSize = 3;
+	msg.nBlocks = 1;
+
+	SPI.beginTransaction(adcSettings);
+
+	for (uint8_t db = 0; db < msg.blockSize; db++) {
+		SPI.transfer(msg.msg[db]);
+	}
+
+	digitalWrite(_adcSync, HIGH);
+	SPI.endTransaction();
+
+	return 0;
+}
+
 /**
  * @brief Updates the channel states based on the ADC response.
  *
@@ -641,6 +776,46 @@ double AD4115::voltageMap(double decimal) {
 	return ((double) ((decimal / 8388608-1) * 25));
 }
 
+/**
+ * @brief Maps a voltage to the corresponding raw code.
+ *
+ * This function is the inverse of voltageMap(). It divides the voltage by 25, adds 1 and multiplies the result by
+ * 8388608, so that 0 V maps to the mid-scale code 0x800000. The result is clamped to the 24-bit code range. It is used
+ * to compare raw samples against voltage thresholds without converting every sample to voltage.
+ *
+ * @param voltage The voltage to be mapped.
+ * @return The raw 24-bit code.
+ */
+uint32_t AD4115::voltageToCode(double voltage) {
+	double decimal = (voltage / 25 + 1) * 8388608;
+
+	if (decimal < 0) {return 0;}
+	if (decimal > 16777215) {return 16777215;}
+	return (uint32_t) decimal;
+}
+
+/**
+ * @brief Lists the enabled channels.
+ *
+ * This function copies the numbers of the enabled channels, in ascending order, into the 'channels' array. This is the
+ * order in which the ADC sequences them in continuous conversion mode, so the channel of the k-th sample of an
+ * acquisition is channels[k % count].
+ *
+ * @param channels Array of 16 elements receiving the enabled channel numbers.
+ * @return The number of enabled channels.
+ */
+uint8_t AD4115::activeChannels(uint8_t channels[16]) {
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < 16; i++) {
+		if (_channelStates[i] == 1) {
+			channels[count] = i;
+			count++;
+		}
+	}
+	return count;
+}
+
 /**
  * @brief Converts three bytes to a double precision integer.
  *
@@ -695,6 +870,7 @@ spi_utils::Message AD4115::dataReadingMsg(void) {
  */
 void AD4115::dataReading(void) {
 
+	stats_utils::ScopedTimer timer(stats_utils::ADC_SPI_FRAME);
 	spi_utils::Message msg = dataReadingMsg();
 
 	msg.blockSize = 4;
@@ -728,12 +904,14 @@ void AD4115::dataReading(void) {
  *   3. Converts the read data to a decimal value using the `threeByteToInt()` function and stores it in the `_channelDecimals` array.
  *   4. Maps the decimal value to voltage using the `voltageMap()` function and stores it in the `_channelVoltages` array.
  * After processing all active channels, the function sets the _adcSync pin to HIGH. Finally, it iterates through all active
- * channels again and prints the channel number and corresponding voltage to the serial monitor. The function returns 0
+ * channels again and prints the channel number and corresponding voltage to the serial monitor. The conversion and the
+ * serial output are timed into the ADC_CONVERSION and SERIAL_WRITE counters of stats_utils. The function returns 0
  * indicating successful execution.
  *
  * @return 0 indicating successful execution.
  */
 double AD4115::fullReading(void) {
+	uint32_t start = stats_utils::ticks();
 	adcMode();
 	Serial.println("EndOfAdcMode");
 
@@ -751,7 +929,9 @@ double AD4115::fullReading(void) {
 	}
 
 	digitalWrite(_adcSync, HIGH);
+	stats_utils::record(stats_utils::ADC_CONVERSION, stats_utils::ticks() - start);
 
+	stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
 	for (int i = 0; i < 16; i++) {
 		if (_channelStates[i] == 1) {
 			Serial.print("Channel ");
@@ -765,6 +945,84 @@ double AD4115::fullReading(void) {
 	return 0;
 }
 
+/**
+ * @brief Starts a single conversion of the enabled channels.
+ *
+ * This function sends the ADC mode message generated by adcModeMsg(), like adcMode(), but without any serial output so
+ * that it can be used inside acquisition loops. The _adcSync pin is set HIGH after the message: the conversion keeps
+ * running while the SPI bus is free for other devices (e.g. loading the next DAC codes), and readConversion() takes
+ * _adcSync LOW again to watch DRDY and collect the results.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t AD4115::startConversion(void) {
+
+	spi_utils::Message msg = adcModeMsg();
+
+	msg.blockSize = 3;
+	msg.nBlocks = 1;
+
+	SPI.beginTransaction(adcSettings);
+
+	digitalWrite(_adcSync, LOW);
+
+	for (uint8_t db = 0; db < msg.blockSize; db++) {
+		SPI.transfer(msg.msg[db]);
+	}
+
+	digitalWrite(_adcSync, HIGH);
+	SPI.endTransaction();
+
+	return 0;
+}
+
+/**
+ * @brief Collects the results of a conversion started with startConversion().
+ *
+ * This function takes the _adcSync pin LOW so that DRDY is visible on the MISO line. For every enabled channel, it
+ * waits for DRDY, reads the data register and stores the raw code in codes[channel] as well as in the
+ * `_channelDecimals` and `_channelVoltages` arrays. Entries of disabled channels are left untouched. The _adcSync pin
+ * is set HIGH at the end.
+ *
+ * @param codes Array of 16 elements receiving the raw codes, indexed by channel.
+ * @return 0 indicating successful execution.
+ */
+uint8_t AD4115::readConversion(uint32_t codes[16]) {
+
+	digitalWrite(_adcSync, LOW);
+
+	for (int i = 0; i < 16; i++) {
+		if (_channelStates[i] == 1) {
+			waitDrdy();
+			dataReading();
+
+			codes[i] = ((uint32_t) _dataRead[0] << 16) | ((uint32_t) _dataRead[1] << 8) | _dataRead[2];
+			_channelDecimals[i] = codes[i];
+			_channelVoltages[i] = voltageMap(_channelDecimals[i]);
+		}
+	}
+
+	digitalWrite(_adcSync, HIGH);
+	return 0;
+}
+
+/**
+ * @brief Performs a single conversion of all enabled channels without serial output.
+ *
+ * Equivalent to startConversion() followed by readConversion(). The conversion is timed into the ADC_CONVERSION
+ * counter of stats_utils.
+ *
+ * @param codes Array of 16 elements receiving the raw codes, indexed by channel.
+ * @return 0 indicating successful execution.
+ */
+uint8_t AD4115::conversionScan(uint32_t codes[16]) {
+
+	stats_utils::ScopedTimer timer(stats_utils::ADC_CONVERSION);
+
+	startConversion();
+	return readConversion(codes);
+}
+
 /**
  * @brief Performs a buffer ramp full reading from the AD4115 ADC.
  *
@@ -777,11 +1035,13 @@ double AD4115::fullReading(void) {
  *   4. Maps the decimal value to voltage using the `voltageMap()` function and stores it in the `_channelVoltages` array.
  * After processing all active channels, the function sets the `_adcSync` pin to HIGH. Finally, it iterates through all active
  * channels again and prints the channel number and corresponding voltage to the serial monitor using the `Serial.write()`
- * function. The function returns 0 indicating successful execution.
+ * function. The conversion and the serial output are timed into the ADC_CONVERSION and SERIAL_WRITE counters of
+ * stats_utils. The function returns 0 indicating successful execution.
  *
  * @return 0 indicating successful execution.
  */
 double AD4115::bufferRampFullReading(void) {
+	uint32_t start = stats_utils::ticks();
 	adcMode();
 
 	for (int i = 0; i < 16; i++) {
@@ -795,7 +1055,9 @@ double AD4115::bufferRampFullReading(void) {
 	}
 
 	digitalWrite(_adcSync, HIGH);
+	stats_utils::record(stats_utils::ADC_CONVERSION, stats_utils::ticks() - start);
 
+	stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
 	//uint8_t buf[3] = {_dataRead[0], _dataRead[1], _dataRead[2]};
 
 	for (int i = 0; i < 16; i++) {
@@ -1,4 +1,5 @@
 #include "../include/ad5791.h"
+#include "../include/stats.h"
 #include <stdint.h>
 #include <SPI.h>
 
@@ -129,6 +130,7 @@ double AD5791::setVoltage(uint8_t channel, double voltage, bool updateOutputs) {
     else {
 
         for (uint8_t block = 0; block < msg.nBlocks; block++) {
+            stats_utils::ScopedTimer timer(stats_utils::DAC_SPI_FRAME);
             digitalWrite(dacSyncPins[channel], LOW);
             
             for (uint8_t db = 0; db < msg.blockSize; db++) {
@@ -464,3 +466,61 @@ double AD5791::threeByteToVoltage(uint8_t DB1, uint8_t DB2, uint8_t DB3) {
 }
 
 
+
+/**
+ * @brief Converts a voltage to the 20-bit DAC code.
+ *
+ * This function applies the same two's complement conversion as setVoltageMsg(): negative voltages map to
+ * voltage * 524288 / DAC_FULL_SCALE + 1048576 and positive voltages to voltage * 524287 / DAC_FULL_SCALE. Voltages
+ * outside the full scale are clamped to it instead of being rejected, so that precomputed ramp tables never hold an
+ * invalid code.
+ *
+ * @param voltage The desired voltage.
+ * @return The 20-bit DAC code.
+ */
+uint32_t AD5791::voltageToCode(double voltage) {
+
+    if (voltage < -1 * DAC_FULL_SCALE) {voltage = -1 * DAC_FULL_SCALE;}
+    if (voltage > DAC_FULL_SCALE) {voltage = DAC_FULL_SCALE;}
+
+    if (voltage < 0) {
+        return ((uint32_t) (voltage * 524288 / DAC_FULL_SCALE + 1048576)) & 0xFFFFF;
+    }
+    return (uint32_t) (voltage * 524287 / DAC_FULL_SCALE);
+}
+
+/**
+ * @brief Writes a code to the DAC register of a channel.
+ *
+ * This function is the quiet counterpart of setVoltage(channel, voltage, false) used in timing critical loops. It
+ * performs the following steps:
+ *   1. Begins a SPI transaction with the DAC settings.
+ *   2. Brings the sync pin of the channel LOW, transfers the write command and the 20-bit code, and brings it HIGH.
+ *   3. Ends the SPI transaction and stores the corresponding voltage in the `vReadings` array.
+ * The analog output only changes on the next call to updateAnalogOutputs(), so several channels can be loaded and
+ * updated together.
+ *
+ * @param channel The channel number of the AD5791 DAC.
+ * @param code The 20-bit two's complement DAC code.
+ * @return 0 indicating successful execution.
+ */
+uint8_t AD5791::writeCode(uint8_t channel, uint32_t code) {
+
+    byte db1 = (byte)((code >> 16) | 16);  // Writes to dac register
+    byte db2 = (byte)((code >> 8) & 255);
+    byte db3 = (byte)(code & 255);
+
+    SPI.beginTransaction(dacSettings);
+    {
+        stats_utils::ScopedTimer timer(stats_utils::DAC_SPI_FRAME);
+        digitalWrite(dacSyncPins[channel], LOW);
+        SPI.transfer(db1);
+        SPI.transfer(db2);
+        SPI.transfer(db3);
+        digitalWrite(dacSyncPins[channel], HIGH);
+    }
+    SPI.endTransaction();
+
+    vReadings[channel] = threeByteToVoltage(db1, db2, db3);
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include "../include/arena.h"
+#include <stdint.h>
+using namespace std;
+
+namespace arena_utils {
+
+static uint8_t _arena[kBytes];
+static Owner _owner = NONE;
+
+/**
+ * @brief Claims the arena for a user.
+ *
+ * @param owner The new user of the arena.
+ * @return A pointer to the kBytes bytes of the arena.
+ */
+uint8_t* claim(Owner owner) {
+	_owner = owner;
+	return _arena;
+}
+
+/**
+ * @brief Returns the last user that claimed the arena.
+ *
+ * @return The current owner, NONE if the arena was never claimed.
+ */
+Owner owner(void) {
+	return _owner;
+}
+
+/**
+ * @brief Returns the arena without claiming it.
+ *
+ * @return A pointer to the kBytes bytes of the arena.
+ */
+uint8_t* buffer(void) {
+	return _arena;
+}
+
+}
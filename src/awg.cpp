@@ -0,0 +1,228 @@
+#include "../include/awg.h"
+#include "../include/stats.h"
+#include "../include/timer.h"
+#include <stdint.h>
+#include <SPI.h>
+#include <Arduino.h>
+using namespace std;
+
+// Milliseconds without a byte after which a table upload is abandoned.
+static const uint32_t kLoadTimeoutMs = 1000;
+
+// Milliseconds without a byte after which the rest of the line that stopped playback is no longer awaited.
+static const uint32_t kAbortTimeoutMs = 10;
+
+// State shared with the step timer callbacks, which run in interrupt context.
+static AD5791* _awgDac = 0;
+static AD4115* _awgAdc = 0;
+static volatile bool _awgArmed = false;
+static volatile bool _awgUpdated = false;
+static volatile bool _awgSampled = false;
+static volatile bool _awgSampling = false;
+static volatile uint32_t _awgSkipped = 0;
+
+/**
+ * @brief Step timer update event of the playback.
+ *
+ * Pulses LDAC if the next point is loaded, otherwise counts a skipped period; the point is then output one period later.
+ */
+static void awgUpdate(void) {
+	if (!_awgArmed) {
+		_awgSkipped++;
+		return;
+	}
+	_awgArmed = false;
+	_awgDac->updateAnalogOutputs();
+	_awgUpdated = true;
+}
+
+/**
+ * @brief Step timer sample event of the playback.
+ *
+ * Starts the ADC conversion of the point output at the last update event when sampling is enabled.
+ */
+static void awgSample(void) {
+	if (!_awgSampling || !_awgUpdated) {return;}
+	_awgAdc->startConversion();
+	_awgSampled = true;
+}
+
+/**
+ * @brief Constructs an AWG object.
+ *
+ * @param dac The AD5791 DAC object that plays the table.
+ * @param adc The AD4115 ADC object sampled during playback.
+ */
+AWG::AWG(AD5791& dac, AD4115& adc) : dac(dac), adc(adc) {}
+
+/**
+ * @brief Returns the number of points that fit in the arena.
+ *
+ * @param channelMask The channels of the table, bit 0 for DAC 0.
+ * @return The maximum number of points.
+ */
+uint32_t AWG::capacity(uint8_t channelMask) {
+	uint8_t count = 0;
+	for (uint8_t j = 0; j < 4; j++) {
+		if (channelMask & (1 << j)) {count++;}
+	}
+	return (count > 0) ? arena_utils::kBytes / (3 * count) : 0;
+}
+
+/**
+ * @brief Uploads a waveform table from the serial port.
+ *
+ * The table is received as raw bytes after the command line: nPoints points, each holding a 20-bit two's complement code
+ * for every channel of 'channelMask' in ascending channel order, as 3 bytes MSB first. The function performs the
+ * following steps:
+ *   1. Checks that the table fits in the arena and claims it.
+ *   2. Discards any byte still pending after the command (e.g. a trailing newline) and prints AWG_READY,bytes; the host
+ *      must wait for this line before sending the table.
+ *   3. Reads exactly 3 * nPoints * channels bytes, giving up after kLoadTimeoutMs without data.
+ *
+ * @param channelMask The channels of the table, bit 0 for DAC 0.
+ * @param n The number of points.
+ * @return 0 if successful, 1 if the table is empty or does not fit, 2 on timeout.
+ */
+uint8_t AWG::load(uint8_t channelMask, uint32_t n) {
+
+	nChannels = 0;
+	nPoints = 0;
+	for (uint8_t j = 0; j < 4; j++) {
+		if (channelMask & (1 << j)) {channels[nChannels++] = j;}
+	}
+
+	if (nChannels == 0 || n == 0 || n > capacity(channelMask)) {return 1;}
+
+	uint8_t* table = arena_utils::claim(arena_utils::AWG_TABLE);
+	uint32_t bytes = 3 * n * nChannels;
+
+	delay(2);
+	while (Serial.available()) {Serial.read();}
+
+	Serial.print("AWG_READY,");
+	Serial.println(bytes);
+
+	uint32_t received = 0;
+	uint32_t last = millis();
+
+	while (received < bytes) {
+		if (Serial.available()) {
+			table[received++] = Serial.read();
+			last = millis();
+		}
+		else if (millis() - last > kLoadTimeoutMs) {
+			return 2;
+		}
+	}
+
+	nPoints = n;
+	return 0;
+}
+
+/**
+ * @brief Loads the codes of one table point into the DAC registers without updating the outputs.
+ *
+ * @param point The index of the point in the table.
+ * @return 0 indicating successful execution.
+ */
+uint8_t AWG::loadPoint(uint32_t point) {
+
+	const uint8_t* codes = arena_utils::buffer() + 3 * point * nChannels;
+
+	for (uint8_t c = 0; c < nChannels; c++) {
+		uint32_t code = ((uint32_t) codes[3 * c] << 16) | ((uint32_t) codes[3 * c + 1] << 8) | codes[3 * c + 2];
+		dac.writeCode(channels[c], code & 0xFFFFF);
+	}
+	return 0;
+}
+
+/**
+ * @brief Plays the uploaded table.
+ *
+ * Playback is paced by the step timer (see timer_utils): every period the update event outputs the point loaded by the
+ * main loop with a single LDAC pulse, and the main loop then loads the next point. When sampling is enabled, the sample
+ * event starts an ADC conversion 'sampleOffsetUs' after each update and the raw codes of the enabled ADC channels are
+ * sent, 3 bytes MSB first per channel in ascending channel order, for every point played. A point that is not loaded
+ * in time is output one period late and counted as skipped. Playback ends after 'loops' passes over the table or, for
+ * loops = 0, when a byte arrives on the serial port; that byte and the rest of its line up to '\r' are discarded. An
+ * AWG_DONE,points,skipped line is printed at the end.
+ *
+ * @param periodUs The time between points in microseconds.
+ * @param loops The number of passes over the table, 0 to play until interrupted.
+ * @param sampleOffsetUs The delay from each point to its ADC conversion in microseconds, 0 to disable sampling.
+ * @return 0 if successful, 1 if there is no valid table or the timing is invalid.
+ */
+uint8_t AWG::run(uint32_t periodUs, uint32_t loops, uint32_t sampleOffsetUs) {
+
+	if (nPoints == 0 || arena_utils::owner() != arena_utils::AWG_TABLE) {return 1;}
+	if (periodUs == 0 || sampleOffsetUs >= periodUs) {return 1;}
+
+	uint8_t adcChannels[16];
+	uint8_t count = adc.activeChannels(adcChannels);
+	uint32_t codes[16];
+	uint8_t buf[48];
+	uint32_t played = 0;
+
+	_awgDac = &dac;
+	_awgAdc = &adc;
+	_awgArmed = false;
+	_awgUpdated = false;
+	_awgSampled = false;
+	_awgSampling = (sampleOffsetUs > 0);
+	_awgSkipped = 0;
+
+	loadPoint(0);
+	_awgArmed = true;
+
+	timer_utils::begin(periodUs, sampleOffsetUs, awgUpdate, awgSample);
+
+	for (uint32_t loop = 0; loops == 0 || loop < loops; loop++) {
+		if (loops == 0 && Serial.available()) {break;}
+
+		for (uint32_t point = 0; point < nPoints; point++) {
+			stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+
+			while (!_awgUpdated) {timer_utils::service();}
+
+			if (_awgSampling) {
+				while (!_awgSampled) {timer_utils::service();}
+				_awgSampled = false;
+				adc.readConversion(codes);
+			}
+			_awgUpdated = false;
+			played++;
+
+			//Load the next point, wrapping to the start of the table
+			bool last = (point + 1 == nPoints) && loops != 0 && loop + 1 == loops;
+			if (!last) {
+				loadPoint((point + 1 == nPoints) ? 0 : point + 1);
+				_awgArmed = true;
+			}
+
+			if (_awgSampling) {
+				for (uint8_t c = 0; c < count; c++) {
+					uint32_t code = codes[adcChannels[c]];
+					buf[3 * c] = (uint8_t) (code >> 16);
+					buf[3 * c + 1] = (uint8_t) (code >> 8);
+					buf[3 * c + 2] = (uint8_t) code;
+				}
+				stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
+				Serial.write(buf, 3 * count);
+			}
+		}
+	}
+
+	timer_utils::stop();
+	_awgArmed = false;
+
+	//The byte that stopped an endless playback is not the start of a command
+	if (loops == 0) {interface_utils::discardLine(kAbortTimeoutMs);}
+
+	Serial.println("");
+	Serial.print("AWG_DONE,");
+	Serial.print(played);
+	Serial.print(",");
+	Serial.println(_awgSkipped);
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include "../include/batch.h"
+#include "../include/stats.h"
+#include <stdint.h>
+#include <SPI.h>
+#include <Arduino.h>
+using namespace std;
+
+// Milliseconds without a byte after which a frame is abandoned.
+static const uint32_t kFrameTimeoutMs = 1000;
+
+/**
+ * @brief Returns the length of an operation including its opcode.
+ *
+ * @param opcode The opcode.
+ * @return The number of bytes, or 0 for an unknown opcode.
+ */
+static uint8_t operationBytes(uint8_t opcode) {
+	switch (opcode) {
+		case BATCH::DAC_CODE: return 5;
+		case BATCH::LDAC: return 1;
+		case BATCH::ADC_SCAN: return 1;
+		case BATCH::DELAY_US: return 5;
+		default: return 0;
+	}
+}
+
+/**
+ * @brief Constructs a BATCH object.
+ *
+ * @param dac The AD5791 DAC object written by DAC_CODE and LDAC operations.
+ * @param adc The AD4115 ADC object read by ADC_SCAN operations.
+ */
+BATCH::BATCH(AD5791& dac, AD4115& adc) : dac(dac), adc(adc) {}
+
+/**
+ * @brief Reads the frame that follows the command line.
+ *
+ * Unlike AWG_LOAD there is no ready line: the host sends the frame together with the command, so a batch costs a single
+ * round trip. All n bytes are consumed even when the frame is too long, so that none of them is taken for a command.
+ *
+ * @param n The frame length in bytes.
+ * @return 0 if successful, 1 if the frame is too long, 2 on timeout.
+ */
+uint8_t BATCH::receive(uint16_t n) {
+
+	uint16_t received = 0;
+	uint32_t last = millis();
+
+	while (received < n) {
+		if (Serial.available()) {
+			uint8_t byte = Serial.read();
+			if (received < kMaxFrameBytes) {frame[received] = byte;}
+			received++;
+			last = millis();
+		}
+		else if (millis() - last > kFrameTimeoutMs) {
+			return 2;
+		}
+	}
+
+	nBytes = n;
+	return (n > kMaxFrameBytes) ? 1 : 0;
+}
+
+/**
+ * @brief Checks the frame and counts its ADC scans.
+ *
+ * @return The number of ADC_SCAN operations, or -1 if an opcode is unknown, an operation is cut off or a DAC channel
+ * does not exist.
+ */
+int32_t BATCH::countScans(void) {
+
+	int32_t scans = 0;
+	uint16_t i = 0;
+
+	while (i < nBytes) {
+		uint8_t length = operationBytes(frame[i]);
+		if (length == 0 || i + length > nBytes) {return -1;}
+		if (frame[i] == DAC_CODE && frame[i + 1] > 3) {return -1;}
+		if (frame[i] == ADC_SCAN) {scans++;}
+		i += length;
+	}
+	return scans;
+}
+
+/**
+ * @brief Reads and runs a binary batch frame.
+ *
+ * The function performs the following steps:
+ *   1. Reads the frame and checks every operation before running any, so a malformed frame changes nothing.
+ *   2. Prints BATCH_BEGIN,nCodes, where nCodes is the number of ADC scans times the enabled channels.
+ *   3. Runs the operations back to back. DAC codes are only loaded into the DAC registers; the outputs change together
+ *      at the next LDAC operation, which makes the writes between two LDACs atomic. Every ADC scan sends the raw codes
+ *      of the enabled channels, 3 bytes MSB first, in ascending channel order.
+ *   4. Prints an empty line and BATCH_DONE,ops,elapsed_us.
+ *
+ * @param n The frame length in bytes.
+ * @return 0 if successful, 1 if the frame is too long or malformed, 2 on timeout.
+ */
+uint8_t BATCH::run(uint16_t n) {
+
+	uint8_t result = receive(n);
+	if (result != 0) {return result;}
+
+	int32_t scans = countScans();
+	if (scans < 0) {return 1;}
+
+	uint8_t channels[16];
+	uint8_t count = adc.activeChannels(channels);
+	uint32_t codes[16];
+	uint8_t record[48];
+
+	Serial.print("BATCH_BEGIN,");
+	Serial.println(scans * count);
+
+	uint32_t start = micros();
+	uint32_t ops = 0;
+	uint16_t i = 0;
+
+	while (i < nBytes) {
+		const uint8_t* op = &frame[i];
+		i += operationBytes(op[0]);
+		ops++;
+
+		if (op[0] == DAC_CODE) {
+			uint32_t code = ((uint32_t) op[2] << 16) | ((uint32_t) op[3] << 8) | op[4];
+			dac.writeCode(op[1], code & 0xFFFFF);
+		}
+		else if (op[0] == LDAC) {
+			dac.updateAnalogOutputs();
+		}
+		else if (op[0] == ADC_SCAN) {
+			adc.conversionScan(codes);
+			for (uint8_t c = 0; c < count; c++) {
+				uint32_t code = codes[channels[c]];
+				record[3 * c] = (uint8_t) (code >> 16);
+				record[3 * c + 1] = (uint8_t) (code >> 8);
+				record[3 * c + 2] = (uint8_t) code;
+			}
+			stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
+			Serial.write(record, 3 * count);
+		}
+		else {
+			delayMicroseconds(((uint32_t) op[1] << 24) | ((uint32_t) op[2] << 16) | ((uint32_t) op[3] << 8) | op[4]);
+		}
+	}
+
+	Serial.println("");
+	Serial.print("BATCH_DONE,");
+	Serial.print(ops);
+	Serial.print(",");
+	Serial.println(micros() - start);
+	return 0;
+}
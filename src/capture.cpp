@@ -0,0 +1,328 @@
+#include "../include/capture.h"
+#include "../include/ad4115.h"
+#include "../include/stats.h"
+#include <stdint.h>
+#include <SPI.h>
+#include <Arduino.h>
+using namespace std;
+
+// Raw 24-bit samples, MSB first, kept in the shared arena.
+static uint8_t* const _sampleBuffer = arena_utils::buffer();
+
+// Set by the external trigger interrupt, polled by ringCapture().
+static volatile bool _pinTriggered = false;
+
+static void pinTriggerIsr(void) {
+	_pinTriggered = true;
+}
+
+/**
+ * @brief Constructs a CAPTURE object.
+ *
+ * @param adc The AD4115 ADC object that the samples are read from.
+ */
+CAPTURE::CAPTURE(AD4115& adc) : adc(adc) {}
+
+/**
+ * @brief Returns the number of samples the buffer can hold.
+ *
+ * @return The buffer capacity in 24-bit samples.
+ */
+uint32_t CAPTURE::capacity(void) {
+	return kCapacity;
+}
+
+/**
+ * @brief Returns the sample rate achieved by the last capture.
+ *
+ * @return The rate in samples per second, measured between the first and the last sample.
+ */
+double CAPTURE::achievedRate(void) {
+	return rate;
+}
+
+/**
+ * @brief Records a burst of raw samples into the sample buffer.
+ *
+ * This function puts the AD4115 in continuous conversion mode and stores the raw 24-bit result of every conversion in
+ * the preallocated sample buffer (the shared arena), without any conversion or serial traffic in between, so the acquisition runs at the
+ * ADC's native output data rate. When several channels are enabled the samples are interleaved in the order in which
+ * the ADC sequences them (ascending channel number). The achieved rate is measured with micros() between the first
+ * and the last sample.
+ *
+ * @param n The number of samples to record. Values above the buffer capacity are clamped to the capacity.
+ * @return 0 indicating successful execution.
+ */
+uint8_t CAPTURE::burst(uint32_t n) {
+
+	arena_utils::claim(arena_utils::CAPTURE_BUFFER);
+
+	if (n > kCapacity) {n = kCapacity;}
+	nSamples = n;
+	start = 0;
+	rate = 0;
+
+	if (n == 0) {return 0;}
+
+	adc.startContinuous();
+
+	adc.readSample(&_sampleBuffer[0]);
+	uint32_t first = micros();
+
+	for (uint32_t i = 1; i < n; i++) {
+		adc.readSample(&_sampleBuffer[3 * i]);
+	}
+	uint32_t last = micros();
+
+	adc.stopContinuous();
+
+	if (n > 1 && last != first) {
+		rate = (n - 1) * 1000000.0 / (uint32_t) (last - first);
+	}
+	return 0;
+}
+
+/**
+ * @brief Sends the last burst to the host.
+ *
+ * Prints a header line BURST_BEGIN,n,capacity,rate_sps, then writes the n samples as 3n raw bytes (MSB first) and
+ * finishes with a BURST_END line.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t CAPTURE::stream(void) {
+
+	Serial.print("BURST_BEGIN,");
+	Serial.print(nSamples);
+	Serial.print(",");
+	Serial.print(kCapacity);
+	Serial.print(",");
+	Serial.println(rate, 3);
+
+	writeSamples();
+
+	Serial.println("");
+	Serial.println("BURST_END");
+	return 0;
+}
+
+/**
+ * @brief Writes the captured samples to the serial port, oldest first.
+ *
+ * The buffer is used as a ring by triggered captures, so the samples are written in two parts: from 'start' to the
+ * end of the captured region, then from the beginning of the buffer up to 'start'.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t CAPTURE::writeSamples(void) {
+
+	stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
+
+	Serial.write(&_sampleBuffer[3 * start], 3 * (nSamples - start));
+	if (start > 0) {
+		Serial.write(_sampleBuffer, 3 * start);
+	}
+	return 0;
+}
+
+/**
+ * @brief Runs a triggered capture on the level of an ADC channel.
+ *
+ * The trigger fires when two consecutive samples of 'channel' cross 'level' in the direction given by 'edge'. The
+ * level is converted once to a raw code so that every sample is compared as an integer.
+ *
+ * @param channel The ADC channel that is monitored. It must be enabled.
+ * @param level The trigger level in volts.
+ * @param edge RISING_EDGE, FALLING_EDGE or ANY_EDGE.
+ * @param pre The number of samples kept before the trigger sample.
+ * @param post The number of samples kept from the trigger sample on (at least 1).
+ * @param timeoutMs The maximum time to wait for the trigger in milliseconds, 0 to wait forever.
+ * @return 0 if the trigger fired, 1 on timeout, 2 if the channel is not enabled, 3 if no channel is enabled.
+ */
+uint8_t CAPTURE::levelTrigger(uint8_t channel, double level, uint8_t edge, uint32_t pre, uint32_t post, uint32_t timeoutMs) {
+	return ringCapture(channel, adc.voltageToCode(level), edge, pre, post, timeoutMs);
+}
+
+/**
+ * @brief Runs a triggered capture on an external digital pin.
+ *
+ * The edge on 'pin' is latched by an interrupt, so pulses shorter than a conversion are not missed. The trigger sample
+ * is the first sample read after the edge.
+ *
+ * @param pin The digital pin used as trigger input.
+ * @param edge RISING_EDGE, FALLING_EDGE or ANY_EDGE.
+ * @param pre The number of samples kept before the trigger sample.
+ * @param post The number of samples kept from the trigger sample on (at least 1).
+ * @param timeoutMs The maximum time to wait for the trigger in milliseconds, 0 to wait forever.
+ * @return 0 if the trigger fired, 1 on timeout, 3 if no ADC channel is enabled.
+ */
+uint8_t CAPTURE::pinTrigger(uint8_t pin, uint8_t edge, uint32_t pre, uint32_t post, uint32_t timeoutMs) {
+
+	uint32_t mode = (edge == RISING_EDGE) ? RISING : (edge == FALLING_EDGE) ? FALLING : CHANGE;
+
+	pinMode(pin, INPUT);
+	_pinTriggered = false;
+	attachInterrupt(digitalPinToInterrupt(pin), pinTriggerIsr, mode);
+
+	uint8_t result = ringCapture(-1, 0, edge, pre, post, timeoutMs);
+
+	detachInterrupt(digitalPinToInterrupt(pin));
+	return result;
+}
+
+/**
+ * @brief Records samples into a circular history until the trigger fires.
+ *
+ * This function puts the AD4115 in continuous conversion mode and writes every sample into a ring of pre + post
+ * samples. The trigger is only armed once 'pre' samples have been recorded, so the pre-trigger history is always
+ * complete. After the trigger sample, post - 1 more samples are recorded and the acquisition stops, leaving the ring
+ * full with the oldest sample at 'start'. The timeout is checked every 256 samples to keep the per-sample work small.
+ *
+ * @param channel The monitored ADC channel, or -1 for the external pin trigger.
+ * @param level The trigger level as a raw code (ignored for the pin trigger).
+ * @param edge RISING_EDGE, FALLING_EDGE or ANY_EDGE.
+ * @param pre The number of samples kept before the trigger sample.
+ * @param post The number of samples kept from the trigger sample on.
+ * @param timeoutMs The maximum time to wait for the trigger in milliseconds, 0 to wait forever.
+ * @return 0 if the trigger fired, 1 on timeout, 2 if the trigger channel is not enabled, 3 if no channel is enabled.
+ */
+uint8_t CAPTURE::ringCapture(int16_t channel, uint32_t level, uint8_t edge, uint32_t pre, uint32_t post, uint32_t timeoutMs) {
+
+	uint8_t channels[16];
+	uint8_t count = adc.activeChannels(channels);
+
+	arena_utils::claim(arena_utils::CAPTURE_BUFFER);
+
+	if (post == 0) {post = 1;}
+	if (post > kCapacity) {post = kCapacity;}
+	if (pre > kCapacity - post) {pre = kCapacity - post;}
+
+	uint32_t ringSize = pre + post;
+	uint32_t head = 0;
+	uint32_t total = 0;
+	uint32_t remaining = 0;
+	uint8_t seq = 0;
+	uint32_t previous = 0;
+	bool havePrevious = false;
+	bool triggered = false;
+
+	nSamples = 0;
+	start = 0;
+	rate = 0;
+
+	if (count == 0) {return 3;}
+
+	//A trigger channel that is not converted would never fire
+	bool monitored = (channel < 0);
+	for (uint8_t c = 0; c < count; c++) {
+		if (channels[c] == channel) {monitored = true;}
+	}
+	if (!monitored) {return 2;}
+
+	uint32_t began = millis();
+	uint32_t first = micros();
+
+	adc.startContinuous();
+
+	while (true) {
+		uint8_t* sample = &_sampleBuffer[3 * head];
+		adc.readSample(sample);
+		total++;
+		if (++head == ringSize) {head = 0;}
+
+		if (triggered) {
+			if (--remaining == 0) {break;}
+			continue;
+		}
+
+		bool armed = (total > pre);
+		bool fire = false;
+
+		if (channel < 0) {
+			if (_pinTriggered) {
+				_pinTriggered = false;
+				fire = armed;
+			}
+		}
+		else if (channels[seq] == channel) {
+			uint32_t code = ((uint32_t) sample[0] << 16) | ((uint32_t) sample[1] << 8) | sample[2];
+
+			if (havePrevious) {
+				bool rising = (previous < level && code >= level);
+				bool falling = (previous >= level && code < level);
+				fire = armed && ((edge == RISING_EDGE && rising) || (edge == FALLING_EDGE && falling) ||
+				                 (edge == ANY_EDGE && (rising || falling)));
+			}
+			previous = code;
+			havePrevious = true;
+		}
+		if (++seq == count) {seq = 0;}
+
+		if (fire) {
+			triggered = true;
+			remaining = post;
+			if (--remaining == 0) {break;}
+		}
+		else if (timeoutMs > 0 && (total & 0xFF) == 0 && millis() - began > timeoutMs) {
+			break;
+		}
+	}
+	uint32_t last = micros();
+
+	adc.stopContinuous();
+
+	if (total > 1 && last != first) {
+		rate = (total - 1) * 1000000.0 / (uint32_t) (last - first);
+	}
+
+	if (!triggered) {return 1;}
+
+	nSamples = ringSize;
+	start = head;
+	triggerIndex = pre;
+	firstChannel = channels[(total - ringSize) % count];
+	return 0;
+}
+
+/**
+ * @brief Sends the result of a triggered capture to the host.
+ *
+ * On timeout prints TRIG_TIMEOUT, TRIG CHANNEL NOT ENABLED if the trigger channel is not enabled and NO CHANNELS
+ * ENABLED if no ADC channel is enabled. Otherwise prints
+ * a header line TRIG_BEGIN,n,trigger_index,rate_sps,first_channel, writes the n samples oldest first as 3n raw bytes
+ * and finishes with a TRIG_END line. 'trigger_index' is the position of the trigger sample and 'first_channel' the
+ * channel of the first sample; later samples follow the ADC's channel sequence.
+ *
+ * @param result The value returned by levelTrigger() or pinTrigger().
+ * @return 0 indicating successful execution.
+ */
+uint8_t CAPTURE::streamTriggered(uint8_t result) {
+
+	if (result == 2) {
+		Serial.println("TRIG CHANNEL NOT ENABLED");
+		return 1;
+	}
+	if (result == 3) {
+		Serial.println("NO CHANNELS ENABLED");
+		return 1;
+	}
+	if (result != 0) {
+		Serial.println("TRIG_TIMEOUT");
+		return 1;
+	}
+
+	Serial.print("TRIG_BEGIN,");
+	Serial.print(nSamples);
+	Serial.print(",");
+	Serial.print(triggerIndex);
+	Serial.print(",");
+	Serial.print(rate, 3);
+	Serial.print(",");
+	Serial.println(firstChannel);
+
+	writeSamples();
+
+	Serial.println("");
+	Serial.println("TRIG_END");
+	return 0;
+}
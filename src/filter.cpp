@@ -0,0 +1,176 @@
+#include "../include/filter.h"
+#include <stdint.h>
+using namespace std;
+
+/**
+ * @brief Configures the filter of one ADC channel.
+ *
+ * The filter works on raw codes converted to signed values around mid-scale (code - 0x800000) so that all arithmetic
+ * is integer. The parameter meaning depends on the type:
+ *   - MOVING_AVERAGE: length of the window, from 1 to kMaxAverage readings.
+ *   - CIC: order of the cascaded integrator-comb decimator, from 1 to kMaxCicOrder. The decimation ratio is 'divider'
+ *     and divider^order must be below 2^39 so that the output fits in 64 bits.
+ *   - IIR: shift k of the single-pole low pass y += (x - y) / 2^k, from 1 to kMaxIirShift.
+ *   - NO_FILTER: ignored. A NO_FILTER channel with a divider of 1 is considered disabled.
+ * The channel state is cleared.
+ *
+ * @param channel The ADC channel, from 0 to 15.
+ * @param type The filter type (FilterType).
+ * @param param The type dependent parameter.
+ * @param divider The output rate divider: one output every 'divider' readings (at least 1).
+ * @return 0 if successful, 1 if a parameter is out of range.
+ */
+uint8_t FILTER::configure(uint8_t channel, uint8_t type, uint8_t param, uint16_t divider) {
+
+	if (channel >= nChannels || divider < 1) {return 1;}
+
+	if ((type == MOVING_AVERAGE && (param < 1 || param > kMaxAverage)) ||
+	    (type == CIC && (param < 1 || param > kMaxCicOrder)) ||
+	    (type == IIR && (param < 1 || param > kMaxIirShift)) ||
+	    type > IIR) {
+		return 1;
+	}
+
+	if (type == CIC) {
+		// 24-bit input plus a gain of divider^order must fit in the 64-bit output
+		uint64_t gain = 1;
+		for (uint8_t i = 0; i < param; i++) {
+			gain *= divider;
+			if (gain >= ((uint64_t) 1 << 39)) {return 1;}
+		}
+	}
+
+	ChannelState& state = channels[channel];
+	state = ChannelState();
+	state.type = type;
+	state.param = param;
+	state.divider = divider;
+
+	configured[channel] = !(type == NO_FILTER && divider == 1);
+	return 0;
+}
+
+/**
+ * @brief Clears the state of every channel.
+ *
+ * Accumulators, histories and divider phases are set to zero; the configuration is kept. Called at the start of every
+ * acquisition so that no state leaks from one ramp into the next.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t FILTER::reset(void) {
+
+	for (uint8_t i = 0; i < nChannels; i++) {
+		ChannelState& state = channels[i];
+		uint8_t type = state.type;
+		uint8_t param = state.param;
+		uint16_t divider = state.divider;
+
+		state = ChannelState();
+		state.type = type;
+		state.param = param;
+		state.divider = divider;
+	}
+	return 0;
+}
+
+/**
+ * @brief Returns whether a channel has a filter or a divider configured.
+ *
+ * @param channel The ADC channel, from 0 to 15.
+ * @return True if readings of the channel go through the filter stage.
+ */
+bool FILTER::enabled(uint8_t channel) {
+	return channel < nChannels && configured[channel];
+}
+
+/**
+ * @brief Returns whether any channel has a filter or a divider configured.
+ *
+ * @return True if at least one channel is enabled.
+ */
+bool FILTER::anyEnabled(void) {
+	for (uint8_t i = 0; i < nChannels; i++) {
+		if (configured[i]) {return true;}
+	}
+	return false;
+}
+
+/**
+ * @brief Feeds one reading into the filter of a channel.
+ *
+ * The reading is processed at the input rate (moving average window update, CIC integrators, IIR update). Every
+ * 'divider' readings an output is produced: the window mean, the CIC comb output scaled by 1 / divider^order, the
+ * current IIR value or, for NO_FILTER, the reading itself. Outputs are clamped back to the 24-bit code range. Until the
+ * window is full, the moving average is the mean of the readings received so far, and the IIR starts from the first
+ * reading, so that the first outputs after a reset are not pulled towards mid-scale.
+ *
+ * @param channel The ADC channel, from 0 to 15.
+ * @param code The raw 24-bit code.
+ * @param out Receives the filtered raw code when an output is produced.
+ * @return True if an output was produced.
+ */
+bool FILTER::push(uint8_t channel, uint32_t code, uint32_t* out) {
+
+	ChannelState& state = channels[channel];
+	int32_t x = (int32_t) code - 0x800000;
+	int64_t y = x;
+
+	switch (state.type) {
+		case MOVING_AVERAGE:
+			state.sum += x - state.history[state.head];
+			state.history[state.head] = x;
+			if (++state.head == state.param) {state.head = 0;}
+			if (state.filled < state.param) {state.filled++;}
+			break;
+
+		case CIC:
+			// Integrators wrap around; the comb differences are exact as long as the output fits
+			state.integrators[0] += (uint64_t) (int64_t) x;
+			for (uint8_t i = 1; i < state.param; i++) {
+				state.integrators[i] += state.integrators[i - 1];
+			}
+			break;
+
+		case IIR:
+			// sum holds y * 2^k, starting from the first reading
+			if (state.filled == 0) {
+				state.sum = x * ((int64_t) 1 << state.param);
+				state.filled = 1;
+			}
+			state.sum += x - (state.sum >> state.param);
+			break;
+	}
+
+	if (++state.phase < state.divider) {return false;}
+	state.phase = 0;
+
+	switch (state.type) {
+		case MOVING_AVERAGE:
+			y = state.sum / state.filled;
+			break;
+
+		case CIC: {
+			uint64_t value = state.integrators[state.param - 1];
+			for (uint8_t i = 0; i < state.param; i++) {
+				uint64_t delayed = state.combs[i];
+				state.combs[i] = value;
+				value -= delayed;
+			}
+			int64_t gain = 1;
+			for (uint8_t i = 0; i < state.param; i++) {gain *= state.divider;}
+			y = (int64_t) value / gain;
+			break;
+		}
+
+		case IIR:
+			y = state.sum >> state.param;
+			break;
+	}
+
+	y += 0x800000;
+	if (y < 0) {y = 0;}
+	if (y > 0xFFFFFF) {y = 0xFFFFFF;}
+	*out = (uint32_t) y;
+	return true;
+}
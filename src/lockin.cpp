@@ -0,0 +1,292 @@
+#include "../include/lockin.h"
+#include "../include/stats.h"
+#include "../include/timer.h"
+#include <stdint.h>
+#include <math.h>
+#include <SPI.h>
+#include <Arduino.h>
+using namespace std;
+
+// Milliseconds without a byte after which the rest of the line that stopped a run is no longer awaited.
+static const uint32_t kAbortTimeoutMs = 10;
+
+// State shared with the step timer callbacks, which run in interrupt context.
+static AD5791* _lockinDac = 0;
+static AD4115* _lockinAdc = 0;
+static volatile bool _lockinArmed = false;
+static volatile bool _lockinUpdated = false;
+static volatile bool _lockinSampled = false;
+static volatile uint32_t _lockinSkipped = 0;
+
+/**
+ * @brief Step timer update event of the lock-in.
+ *
+ * Pulses LDAC if the next excitation point is loaded, otherwise counts a skipped period.
+ */
+static void lockinUpdate(void) {
+	if (!_lockinArmed) {
+		_lockinSkipped++;
+		return;
+	}
+	_lockinArmed = false;
+	_lockinDac->updateAnalogOutputs();
+	_lockinUpdated = true;
+}
+
+/**
+ * @brief Step timer sample event of the lock-in.
+ *
+ * Starts the ADC conversion of the excitation point output at the last update event.
+ */
+static void lockinSample(void) {
+	if (!_lockinUpdated) {return;}
+	_lockinAdc->startConversion();
+	_lockinSampled = true;
+}
+
+/**
+ * @brief Constructs a LOCKIN object.
+ *
+ * @param dac The AD5791 DAC object that outputs the excitation.
+ * @param adc The AD4115 ADC object whose enabled channels are demodulated.
+ */
+LOCKIN::LOCKIN(AD5791& dac, AD4115& adc) : dac(dac), adc(adc) {}
+
+/**
+ * @brief Configures the excitation and the demodulation.
+ *
+ * This function precomputes everything the sample loop needs, so that a sample costs only integer operations:
+ *   1. The timer period is 1 / (frequency * pointsPerCycle) rounded to whole microseconds; the played frequency is
+ *      therefore 1 / (period * pointsPerCycle) and is returned by frequency().
+ *   2. The excitation table holds the DAC code of offset + amplitude * sin(2 pi k / pointsPerCycle) for every point.
+ *   3. The reference tables hold sin and cos of 2 pi k / pointsPerCycle + phase as Q15 integers. The phase compensates
+ *      the delay between the excitation and the measured response, including the sample offset.
+ *   4. The time constant is rounded to the nearest power of two of the sample period, so every filter stage is
+ *      y += (x - y) >> shift; the actual value is returned by timeConstantMs().
+ *   5. An output is reported every round(sample rate / outputRateHz) samples, at least every sample.
+ *
+ * @param dacChannel The AD5791 channel of the excitation.
+ * @param amplitude The peak amplitude of the excitation in volts.
+ * @param offset The DC offset of the excitation in volts.
+ * @param frequency The excitation frequency in Hz.
+ * @param pointsPerCycle The number of table points per cycle, from 4 to kMaxPoints.
+ * @param sampleOffsetUs The delay from each excitation point to its conversion in microseconds.
+ * @param phaseDeg The reference phase in degrees.
+ * @param tauMs The filter time constant in milliseconds.
+ * @param order The number of cascaded filter stages, from 1 to kMaxOrder.
+ * @param outputRateHz The number of X/Y outputs per second.
+ * @return 0 on success, 1 if a parameter is out of range.
+ */
+uint8_t LOCKIN::configure(uint8_t dacChannel, double amplitude, double offset, double frequency, uint16_t pointsPerCycle,
+                          uint32_t sampleOffsetUs, double phaseDeg, double tauMs, uint8_t order, double outputRateHz) {
+
+	nPoints = 0;
+
+	if (dacChannel > 3 || pointsPerCycle < 4 || pointsPerCycle > kMaxPoints) {return 1;}
+	if (frequency <= 0 || tauMs <= 0 || outputRateHz <= 0 || order < 1 || order > kMaxOrder) {return 1;}
+
+	double period = round(1e6 / (frequency * pointsPerCycle));
+	if (period < 1 || period > 4294967295.0 || sampleOffsetUs >= period) {return 1;}
+
+	double tauSamples = tauMs * 1000 / period;
+	double bits = round(log(tauSamples) / log(2.0));
+	double every = round(1e6 / (period * outputRateHz));
+
+	this->dacChannel = dacChannel;
+	this->periodUs = (uint32_t) period;
+	this->sampleOffsetUs = sampleOffsetUs;
+	this->order = order;
+	this->shift = (bits < 0) ? 0 : (bits > kMaxShift) ? kMaxShift : (uint8_t) bits;
+	this->outputEvery = (every < 1) ? 1 : (uint32_t) every;
+	this->offsetCode = dac.voltageToCode(offset);
+
+	double phase = phaseDeg * M_PI / 180;
+	for (uint16_t k = 0; k < pointsPerCycle; k++) {
+		double angle = 2 * M_PI * k / pointsPerCycle;
+		excitation[k] = dac.voltageToCode(offset + amplitude * sin(angle));
+		refSin[k] = (int16_t) lround(32767 * sin(angle + phase));
+		refCos[k] = (int16_t) lround(32767 * cos(angle + phase));
+	}
+
+	nPoints = pointsPerCycle;
+	return 0;
+}
+
+/**
+ * @brief Returns the excitation frequency actually played.
+ *
+ * @return The frequency in Hz, or 0 if the lock-in is not configured.
+ */
+double LOCKIN::frequency(void) {
+	return (nPoints > 0) ? 1e6 / ((double) periodUs * nPoints) : 0;
+}
+
+/**
+ * @brief Returns the time constant actually used by each filter stage.
+ *
+ * @return The time constant in milliseconds.
+ */
+double LOCKIN::timeConstantMs(void) {
+	return (double) periodUs * (1UL << shift) / 1000;
+}
+
+/**
+ * @brief Returns the number of samples between two outputs.
+ *
+ * @return The output decimation.
+ */
+uint32_t LOCKIN::decimation(void) {
+	return outputEvery;
+}
+
+/**
+ * @brief Loads one excitation point into the DAC register without updating the output.
+ *
+ * @param point The index of the point in the excitation table.
+ * @return 0 indicating successful execution.
+ */
+uint8_t LOCKIN::loadPoint(uint16_t point) {
+	dac.writeCode(dacChannel, excitation[point]);
+	return 0;
+}
+
+/**
+ * @brief Mixes one sample with the references and feeds the filter stages.
+ *
+ * The sample, relative to mid-scale, is multiplied by the Q15 sin and cos references of its excitation point. Each
+ * product is shifted up by 16 bits to keep fractional precision and passed through 'order' first-order stages
+ * y += (x - y) >> shift, all in 64-bit integers (|x| < 2^55).
+ *
+ * @param channel The ADC channel of the sample.
+ * @param sample The sample as a signed code relative to mid-scale.
+ * @param point The index of the excitation point the sample belongs to.
+ * @return 0 indicating successful execution.
+ */
+uint8_t LOCKIN::demodulate(uint8_t channel, int32_t sample, uint16_t point) {
+	int64_t x = ((int64_t) sample * refSin[point]) * 65536;
+	int64_t y = ((int64_t) sample * refCos[point]) * 65536;
+
+	for (uint8_t s = 0; s < order; s++) {
+		stateX[channel][s] += (x - stateX[channel][s]) >> shift;
+		stateY[channel][s] += (y - stateY[channel][s]) >> shift;
+		x = stateX[channel][s];
+		y = stateY[channel][s];
+	}
+	return 0;
+}
+
+/**
+ * @brief Converts a filter output to volts.
+ *
+ * The filtered product is half the in-phase amplitude times the reference scale, so the amplitude in volts is
+ * 2 * state / (2^16 * 32767) ADC codes of 25 / 2^23 V.
+ *
+ * @param state The output of the last filter stage.
+ * @return The amplitude in volts.
+ */
+double LOCKIN::toVolts(int64_t state) {
+	return 2 * (double) state / (65536.0 * 32767) * 25 / 8388608;
+}
+
+/**
+ * @brief Runs the lock-in.
+ *
+ * The excitation is paced by the step timer (see timer_utils) like AWG playback: every period the update event outputs
+ * the table point loaded by the main loop, and the sample event starts a conversion of the enabled ADC channels
+ * 'sampleOffsetUs' later. For every sample the main loop reads the conversion, loads the next point and demodulates
+ * each enabled channel against the reference of the point that was output, so a skipped period only delays the sample
+ * and never shifts its phase. The output starts with LOCKIN_BEGIN,frequency_hz,tau_ms,channels; every 'outputEvery'
+ * samples a line LI,sample,X,Y,... with X and Y in volts (peak) for each enabled channel in ascending order is printed.
+ * The run ends after durationMs or, for durationMs = 0, when a byte arrives on the serial port, which is discarded with
+ * the rest of its line; the excitation is then returned to its offset and LOCKIN_DONE,samples,skipped is printed.
+ *
+ * @param durationMs The duration in milliseconds, 0 to run until interrupted.
+ * @return 0 if successful, 1 if the lock-in is not configured.
+ */
+uint8_t LOCKIN::run(uint32_t durationMs) {
+
+	if (nPoints == 0) {return 1;}
+
+	uint8_t channels[16];
+	uint8_t count = adc.activeChannels(channels);
+	uint32_t codes[16];
+
+	for (uint8_t c = 0; c < 16; c++) {
+		for (uint8_t s = 0; s < kMaxOrder; s++) {
+			stateX[c][s] = 0;
+			stateY[c][s] = 0;
+		}
+	}
+
+	Serial.print("LOCKIN_BEGIN,");
+	Serial.print(frequency(), 6);
+	Serial.print(",");
+	Serial.print(timeConstantMs(), 3);
+	Serial.print(",");
+	Serial.println(count);
+
+	_lockinDac = &dac;
+	_lockinAdc = &adc;
+	_lockinArmed = false;
+	_lockinUpdated = false;
+	_lockinSampled = false;
+	_lockinSkipped = 0;
+
+	uint16_t point = 0;
+	uint32_t samples = 0;
+	uint32_t start = millis();
+
+	loadPoint(point);
+	_lockinArmed = true;
+	timer_utils::begin(periodUs, sampleOffsetUs, lockinUpdate, lockinSample);
+
+	while (true) {
+		if (durationMs == 0 ? Serial.available() > 0 : millis() - start >= durationMs) {break;}
+
+		stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+
+		while (!_lockinSampled) {timer_utils::service();}
+		_lockinSampled = false;
+		_lockinUpdated = false;
+		adc.readConversion(codes);
+
+		//Load the next point while the current sample is demodulated
+		uint16_t played = point;
+		point = (point + 1 == nPoints) ? 0 : point + 1;
+		loadPoint(point);
+		_lockinArmed = true;
+
+		for (uint8_t c = 0; c < count; c++) {
+			demodulate(channels[c], (int32_t) codes[channels[c]] - 8388608, played);
+		}
+		samples++;
+
+		if (samples % outputEvery == 0) {
+			stats_utils::ScopedTimer serial(stats_utils::SERIAL_WRITE);
+			Serial.print("LI,");
+			Serial.print(samples);
+			for (uint8_t c = 0; c < count; c++) {
+				Serial.print(",");
+				Serial.print(toVolts(stateX[channels[c]][order - 1]), 9);
+				Serial.print(",");
+				Serial.print(toVolts(stateY[channels[c]][order - 1]), 9);
+			}
+			Serial.println("");
+		}
+	}
+
+	timer_utils::stop();
+	_lockinArmed = false;
+
+	dac.writeCode(dacChannel, offsetCode);
+	dac.updateAnalogOutputs();
+
+	//The byte that stopped an open-ended run is not the start of a command
+	if (durationMs == 0) {interface_utils::discardLine(kAbortTimeoutMs);}
+
+	Serial.print("LOCKIN_DONE,");
+	Serial.print(samples);
+	Serial.print(",");
+	Serial.println(_lockinSkipped);
+	return 0;
+}
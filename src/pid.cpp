@@ -0,0 +1,262 @@
+#include "../include/pid.h"
+#include "../include/ad5791.h"
+#include "../include/ad4115.h"
+#include "../include/stats.h"
+#include <stdint.h>
+#include <math.h>
+#include <SPI.h>
+#include <Arduino.h>
+using namespace std;
+
+// Volts per AD4115 code in the +-25 V input range.
+static const double kAdcVoltsPerCode = 25.0 / 8388608;
+
+/**
+ * @brief Constructs a PID object.
+ *
+ * @param dac The AD5791 DAC object driving the controlled output.
+ * @param adc The AD4115 ADC object reading the controlled quantity.
+ */
+PID::PID(AD5791& dac, AD4115& adc) : dac(dac), adc(adc) {}
+
+/**
+ * @brief Converts a voltage to signed DAC units.
+ *
+ * One unit is one AD5791 LSB; the unit range -524288 to 524287 spans -DAC_FULL_SCALE to +DAC_FULL_SCALE, and the low 20
+ * bits of a unit value are the two's complement DAC code.
+ *
+ * @param voltage The voltage to be converted.
+ * @return The voltage in DAC units, clamped to the code range.
+ */
+int32_t PID::voltageToUnits(double voltage) {
+	double units = voltage * 524288 / dac.DAC_FULL_SCALE;
+
+	if (units < -524288) {return -524288;}
+	if (units > 524287) {return 524287;}
+	return (int32_t) units;
+}
+
+/**
+ * @brief Converts signed DAC units to a voltage.
+ *
+ * @param units The value in DAC units.
+ * @return The corresponding voltage.
+ */
+double PID::unitsToVoltage(int32_t units) {
+	return (double) units * dac.DAC_FULL_SCALE / 524288;
+}
+
+/**
+ * @brief Returns whether an ADC channel is converted by conversionScan.
+ *
+ * @param channel The AD4115 channel.
+ * @return True if the channel is enabled.
+ */
+bool PID::channelEnabled(uint8_t channel) {
+	uint8_t channels[16];
+	uint8_t count = adc.activeChannels(channels);
+
+	for (uint8_t c = 0; c < count; c++) {
+		if (channels[c] == channel) {return true;}
+	}
+	return false;
+}
+
+/**
+ * @brief Configures the feedback loop.
+ *
+ * The loop runs entirely in integers. The setpoint is stored as an ADC code and the error of every iteration is the
+ * setpoint code minus the measured code. The gains are converted once from volts of output per volt of error into
+ * fixed-point factors with kGainShift fractional bits that map ADC codes to DAC units, so an iteration needs no
+ * floating point. The limits and the slew limit are stored in DAC units. A running loop is stopped so the new
+ * configuration takes effect on the next PID_START.
+ *
+ * @param adcChannel The AD4115 channel read every iteration. It must be enabled with CONFIG_CHANNEL.
+ * @param dacChannel The AD5791 channel updated every iteration.
+ * @param setpoint The target reading in volts.
+ * @param kp The proportional gain.
+ * @param ki The integral gain per iteration.
+ * @param kd The derivative gain per iteration.
+ * @param outMin The lowest output voltage.
+ * @param outMax The highest output voltage.
+ * @param maxSlew The largest output change per iteration in volts; 0 disables the slew limit.
+ * @return 0 on success, 1 if a channel is out of range, the ADC channel is not enabled, a gain does not fit the
+ *         fixed-point format or outMin > outMax.
+ */
+uint8_t PID::configure(uint8_t adcChannel, uint8_t dacChannel, double setpoint, double kp, double ki, double kd,
+                       double outMin, double outMax, double maxSlew) {
+
+	if (adcChannel > 15 || dacChannel > 3 || outMin > outMax || maxSlew < 0) {return 1;}
+	if (!channelEnabled(adcChannel)) {return 1;}
+
+	//Gain from ADC codes to DAC units, with kGainShift fractional bits
+	double scale = kAdcVoltsPerCode * 524288 / dac.DAC_FULL_SCALE * (1UL << kGainShift);
+	double gains[3] = {kp * scale, ki * scale, kd * scale};
+	for (uint8_t g = 0; g < 3; g++) {
+		if (fabs(gains[g]) > 2147483647.0) {return 1;}
+	}
+
+	stop();
+	this->adcChannel = adcChannel;
+	this->dacChannel = dacChannel;
+	this->setpointCode = adc.voltageToCode(setpoint);
+	this->kp = (int32_t) lround(gains[0]);
+	this->ki = (int32_t) lround(gains[1]);
+	this->kd = (int32_t) lround(gains[2]);
+	this->outMin = voltageToUnits(outMin);
+	this->outMax = voltageToUnits(outMax);
+	this->maxSlew = (maxSlew > 0) ? voltageToUnits(maxSlew) : 1048575;
+	if (this->maxSlew < 1) {this->maxSlew = 1;}
+	return 0;
+}
+
+/**
+ * @brief Starts the feedback loop.
+ *
+ * The transfer is bumpless: the present output of the DAC channel, clamped to the output limits, becomes the bias that
+ * the controller terms are added to, and the integral starts from zero. The loop statistics are cleared. The ADC
+ * channel is checked again, since the ADC configuration may have changed since PID_CONFIG.
+ *
+ * @return 0 if the loop started, 1 if the ADC channel is not enabled.
+ */
+uint8_t PID::start(void) {
+	if (!channelEnabled(adcChannel)) {return 1;}
+
+	bias = voltageToUnits(dac.vReadings[dacChannel]);
+	if (bias < outMin) {bias = outMin;}
+	if (bias > outMax) {bias = outMax;}
+	output = bias;
+	integral = 0;
+	lastError = 0;
+
+	stats.loops = 0;
+	stats.saturated = 0;
+	stats.maxLoop = 0;
+	stats.maxAbsError = 0;
+	stats.sumError = 0;
+	stats.sumSquares = 0;
+	stats.start = millis();
+
+	running = true;
+	return 0;
+}
+
+/**
+ * @brief Stops the feedback loop. The output keeps its last value.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t PID::stop(void) {
+	running = false;
+	return 0;
+}
+
+/**
+ * @brief Returns whether the feedback loop is running.
+ *
+ * @return True while the loop is running.
+ */
+bool PID::active(void) {
+	return running;
+}
+
+/**
+ * @brief Runs one iteration of the feedback loop.
+ *
+ * Called on every pass of loop(), between serial commands, so the controller runs whenever the board is idle and
+ * commands are still served. One iteration:
+ *   1. Converts the enabled ADC channels once with conversionScan (no serial output) and takes the error of adcChannel.
+ *   2. Adds the error to the integral and computes output = bias + (kp * e + ki * integral + kd * (e - e_prev)) >>
+ *      kGainShift in 64-bit integers.
+ *   3. Anti-windup: if the output is beyond a limit and the new error pushes it further, the integration of this
+ *      iteration is undone (conditional integration), so the integral never winds up while saturated.
+ *   4. Clamps the output to the limits, then limits its change to maxSlew units.
+ *   5. Writes the code to dacChannel and pulses LDAC, then updates the loop statistics.
+ * The iteration time is the conversion time of the enabled channels plus two SPI frames, so only adcChannel should be
+ * enabled for the shortest loop. If adcChannel has been disabled since PID_START, the loop stops instead of driving
+ * the output from a reading that was never taken.
+ *
+ * @return 0 if an iteration ran, 1 if the loop is not running.
+ */
+uint8_t PID::service(void) {
+	if (!running) {return 1;}
+	if (!channelEnabled(adcChannel)) {
+		stop();
+		return 1;
+	}
+
+	uint32_t begin = stats_utils::ticks();
+	uint32_t codes[16] = {0};
+	adc.conversionScan(codes);
+
+	int32_t error = (int32_t) setpointCode - (int32_t) codes[adcChannel];
+	int32_t delta = (stats.loops > 0) ? error - lastError : 0;
+	lastError = error;
+
+	int64_t previous = integral;
+	integral += error;
+
+	int64_t sum = (int64_t) kp * error + (int64_t) ki * integral + (int64_t) kd * delta;
+	int64_t target = bias + (sum >> kGainShift);
+
+	if ((target > outMax && (int64_t) ki * error > 0) || (target < outMin && (int64_t) ki * error < 0)) {
+		integral = previous;
+		sum = (int64_t) kp * error + (int64_t) ki * integral + (int64_t) kd * delta;
+		target = bias + (sum >> kGainShift);
+	}
+
+	if (target > outMax) {target = outMax; stats.saturated++;}
+	else if (target < outMin) {target = outMin; stats.saturated++;}
+
+	if (target > output + maxSlew) {target = output + maxSlew;}
+	else if (target < output - maxSlew) {target = output - maxSlew;}
+
+	output = (int32_t) target;
+	dac.writeCode(dacChannel, (uint32_t) output & 0xFFFFF);
+	dac.updateAnalogOutputs();
+
+	uint32_t magnitude = (error < 0) ? -error : error;
+	if (magnitude > stats.maxAbsError) {stats.maxAbsError = magnitude;}
+	stats.sumError += error;
+	stats.sumSquares += (double) error * error;
+	stats.loops++;
+
+	uint32_t elapsed = stats_utils::ticks() - begin;
+	if (elapsed > stats.maxLoop) {stats.maxLoop = elapsed;}
+	return 0;
+}
+
+/**
+ * @brief Prints the loop statistics to the serial port.
+ *
+ * Prints PID_STATS,running,loops,rate_hz,mean_error_V,rms_error_V,max_abs_error_V,max_loop_us,saturated,output_V. The
+ * rate is the number of iterations per second since PID_START, and the errors are converted from ADC codes to volts.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t PID::report(void) {
+	double elapsed = (millis() - stats.start) / 1000.0;
+	double rate = (elapsed > 0) ? stats.loops / elapsed : 0;
+	double mean = (stats.loops > 0) ? (double) stats.sumError / stats.loops : 0;
+	double rms = (stats.loops > 0) ? sqrt(stats.sumSquares / stats.loops) : 0;
+
+	Serial.print("PID_STATS,");
+	Serial.print(running ? 1 : 0);
+	Serial.print(",");
+	Serial.print(stats.loops);
+	Serial.print(",");
+	Serial.print(rate, 1);
+	Serial.print(",");
+	Serial.print(mean * kAdcVoltsPerCode, 9);
+	Serial.print(",");
+	Serial.print(rms * kAdcVoltsPerCode, 9);
+	Serial.print(",");
+	Serial.print(stats.maxAbsError * kAdcVoltsPerCode, 9);
+	Serial.print(",");
+	Serial.print(stats_utils::ticksToMicros(stats.maxLoop), 3);
+	Serial.print(",");
+	Serial.print(stats.saturated);
+	Serial.print(",");
+	Serial.println(unitsToVoltage(output), 6);
+	return 0;
+}
@@ -1,14 +1,78 @@
 #include "../include/ramp.h"
 #include "../include/ad5791.h"
 #include "../include/ad4115.h"
+#include "../include/stats.h"
+#include "../include/timer.h"
 #include <stdint.h>
 #include <SPI.h>
 #include <cstdlib>
+#include <math.h>
 #include <WString.h>
 #include <Arduino.h>
 #include <string>
 using namespace std;
 
+// State shared with the step timer callbacks of timedRampIteration, which run in interrupt context.
+static AD5791* _timedDac = 0;
+static AD4115* _timedAdc = 0;
+static volatile bool _timedArmed = false;
+static volatile bool _timedUpdated = false;
+static volatile bool _timedSampled = false;
+static volatile uint32_t _timedUpdateTick = 0;
+static volatile uint32_t _timedSampleTick = 0;
+
+// Set by the interrupt on the sync line of a synchronized ramp start.
+static volatile bool _syncTriggered = false;
+
+// Milliseconds without a byte after which the rest of the line that aborted a sync wait is no longer awaited.
+static const uint32_t kSyncAbortTimeoutMs = 10;
+
+/**
+ * @brief Converts the settling delay of a ramp to ticks for RampTiming.
+ *
+ * The product is formed in 64 bits and clamped to the 32-bit tick range (about 51 s at 84 MHz), beyond which the tick
+ * counter wraps and no settle time can be measured anyway.
+ *
+ * @param del The delay in milliseconds.
+ * @return The delay in ticks.
+ */
+static uint32_t settleTicks(double del) {
+  uint64_t ticks = (uint64_t) (del * 1000) * stats_utils::ticksPerMicrosecond();
+  return (ticks > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t) ticks;
+}
+
+static void syncIsr(void) {
+  _syncTriggered = true;
+}
+
+/**
+ * @brief Step timer update event of the hardware-timed ramp.
+ *
+ * Pulses LDAC if the next step's codes are loaded. Otherwise the main loop is late: the period is skipped, and so is its
+ * sample event, which keeps the settling time of every applied step exact.
+ */
+static void timedUpdate(void) {
+  if (!_timedArmed) {return;}
+  _timedArmed = false;
+  _timedDac->updateAnalogOutputs();
+  _timedUpdateTick = stats_utils::ticks();
+  _timedUpdated = true;
+}
+
+/**
+ * @brief Step timer sample event of the hardware-timed ramp.
+ *
+ * Starts the ADC conversion of the step applied at the last update event. The main loop does not touch the SPI bus
+ * between arming a step and seeing the conversion started, so the bus is always free here.
+ */
+static void timedSample(void) {
+  if (!_timedUpdated) {return;}
+  _timedUpdated = false;
+  _timedSampleTick = stats_utils::ticks();
+  _timedAdc->startConversion();
+  _timedSampled = true;
+}
+
 /**
  * @brief Constructs a RAMPS object.
  *
@@ -92,6 +156,7 @@ uint8_t RAMPS::simpleRampIteration(uint8_t channelsDac[4], double vi[4], double
   delay(del);
   
   for (int i = 0; i < nSteps; i++) {
+    stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
     for (int j = 0; j < 4; j++) {
       if (channelsDac[j] == 1) {
         dv_j = dv[j];
@@ -122,8 +187,12 @@ uint8_t RAMPS::simpleRampIteration(uint8_t channelsDac[4], double vi[4], double
  * voltage step size previously calculated and stored in the 'dv' array. The updated voltage values are applied to
  * the DAC channels using the 'setVoltage' function. The LDAC pin is set to low to update all channels simultaneously
  * after each step of the ramp. The function includes calls to the 'bufferRampFullReading' function to read the ADC
- * values after each step of the ramp. Optional Serial print statements can be uncommented for debugging or logging
- * purposes.
+ * values after each step of the ramp. Every LDAC pulse and ADC readout is timestamped into 'timing', and the ramp
+ * completion record (see RampTiming::report) is printed after the last reading. When oversampling is set with
+ * 'setOversampling', each point is the on-device reduction of several readings instead of a single reading. When a
+ * filter is configured in 'filter', readings go through the filter stage and only its decimated outputs are sent.
+ * When a step period is set with 'setStepPeriod', LDAC pulses are issued on that fixed schedule. Optional Serial print
+ * statements can be uncommented for debugging or logging purposes.
  *
  * @param channelsDac An array indicating which channels to perform the ramp iteration on.
  * @param vi An array of initial voltage values for each corresponding channel.
@@ -135,14 +204,19 @@ uint8_t RAMPS::bufferRampIteration(uint8_t channelsDac[4], double vi[4], double
 
   double dv_j;
 
+  filter.reset();
+  timing.begin(stepPeriodUs * stats_utils::ticksPerMicrosecond(), settleTicks(del));
+
   //Initial delay before first step
   delay(del);
 
   //Initial reading before first step
-  adc.bufferRampFullReading();
+  timing.markReadout(stats_utils::ticks());
+  readPoint();
 
 
   for (int i = 0; i < nSteps; i++) {
+    stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
     for (int j = 0; j < 4; j++) {
       if (channelsDac[j] == 1) {
         dv_j = dv[j];
@@ -153,18 +227,1109 @@ uint8_t RAMPS::bufferRampIteration(uint8_t channelsDac[4], double vi[4], double
         //Serial.println(dac.vReadings[j]);
       }
     }
+    uint32_t workDone = stats_utils::ticks();
+
+    //Wait for the scheduled update time of this step
+    if (stepPeriodUs > 0) {
+      uint32_t deadline = timing.deadline(i + 1);
+      while ((int32_t) (stats_utils::ticks() - deadline) < 0) {}
+    }
+
     //set LDAC pin to low to update all channels simultaneously
+    uint32_t update = stats_utils::ticks();
     dac.updateAnalogOutputs();
+    timing.markUpdate(i + 1, update, workDone);
     
     //delay of input delay
     delay(del);
 
     //Read
-    adc.bufferRampFullReading();
+    timing.markReadout(stats_utils::ticks());
+    readPoint();
+  }
+
+  timing.report();
+  return 0;
+}
+
+/**
+ * @brief Performs a pipelined buffer ramp iteration for the specified channels on the RAMPS board.
+ *
+ * This function produces the same points as 'bufferRampIteration' but overlaps the stages of consecutive steps instead
+ * of running them one after the other. For step k:
+ *   1. The DAC codes of step k, loaded during the previous step, are applied with a single LDAC pulse (on the fixed
+ *      schedule when a step period is set).
+ *   2. After the settling delay 'del', the ADC conversion is started and the SPI bus is released.
+ *   3. While the ADC converts, the codes of step k + 1 are shifted into the AD5791 input registers (no LDAC).
+ *   4. The conversion results are collected and written to the serial port, whose transmit buffer drains while step
+ *      k + 1 settles.
+ * The step period therefore approaches the settling delay plus the longest stage rather than the sum of all stages.
+ * Readings are sent as raw 24-bit codes, 3 bytes MSB first per enabled channel in ascending channel order, for the
+ * initial point and each of the nSteps steps; they are followed by the completion record, whose mean period is the
+ * achieved step period. Oversampling and the filter stage are not applied in this mode.
+ *
+ * @param channelsDac An array indicating which channels to perform the ramp iteration on.
+ * @param vi An array of initial voltage values for each corresponding channel.
+ * @param nSteps The number of steps in the ramp iteration.
+ * @param del The settling delay in milliseconds between the update and the conversion of each step.
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::pipelinedRampIteration(uint8_t channelsDac[4], double vi[4], double nSteps, double del) {
+
+  uint8_t channels[16];
+  uint8_t count = adc.activeChannels(channels);
+  uint32_t codes[16];
+  uint32_t steps = (uint32_t) nSteps;
+
+  timing.begin(stepPeriodUs * stats_utils::ticksPerMicrosecond(), settleTicks(del));
+
+  //Initial point, overlapped with loading the first step
+  delay(del);
+  timing.markReadout(stats_utils::ticks());
+  adc.startConversion();
+  if (steps > 0) {loadStep(channelsDac, vi, 1);}
+  adc.readConversion(codes);
+  writePoint(codes, channels, count);
+
+  for (uint32_t i = 1; i <= steps; i++) {
+    stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+    uint32_t workDone = stats_utils::ticks();
+
+    if (stepPeriodUs > 0) {
+      uint32_t deadline = timing.deadline(i);
+      while ((int32_t) (stats_utils::ticks() - deadline) < 0) {}
+    }
+
+    uint32_t update = stats_utils::ticks();
+    dac.updateAnalogOutputs();
+    timing.markUpdate(i, update, workDone);
+
+    delay(del);
+
+    timing.markReadout(stats_utils::ticks());
+    uint32_t start = stats_utils::ticks();
+    adc.startConversion();
+
+    //Load the next step while the ADC converts
+    if (i < steps) {loadStep(channelsDac, vi, i + 1);}
+
+    adc.readConversion(codes);
+    stats_utils::record(stats_utils::ADC_CONVERSION, stats_utils::ticks() - start);
+
+    writePoint(codes, channels, count);
+  }
+
+  timing.report();
+  return 0;
+}
+
+/**
+ * @brief Performs a hardware-timed buffer ramp iteration for the specified channels on the RAMPS board.
+ *
+ * The update and the sampling of every step are driven by the step timer (see timer_utils) instead of software delays:
+ * the update event pulses LDAC every step period, and the sample event starts the ADC conversion exactly
+ * 'timedOffsetUs' later, so the settle-to-sample time does not depend on serial traffic or loop timing. The main loop
+ * only loads the codes of the next step, arms it, waits for its conversion to start, collects the results and writes
+ * them. A step that is not loaded by the update event is applied one period later and counts as an overrun in the
+ * completion record; the schedule of the following steps moves with it (see RampTiming::reschedule). Readings are
+ * sent as raw codes like in 'pipelinedRampIteration'.
+ *
+ * @param channelsDac An array indicating which channels to perform the ramp iteration on.
+ * @param vi An array of initial voltage values for each corresponding channel.
+ * @param nSteps The number of steps in the ramp iteration.
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::timedRampIteration(uint8_t channelsDac[4], double vi[4], double nSteps) {
+
+  uint8_t channels[16];
+  uint8_t count = adc.activeChannels(channels);
+  uint32_t codes[16];
+  uint32_t steps = (uint32_t) nSteps;
+
+  _timedDac = &dac;
+  _timedAdc = &adc;
+  _timedArmed = false;
+  _timedUpdated = false;
+  _timedSampled = false;
+
+  //Initial point, sampled with the same settling time as the timed steps
+  delayMicroseconds(timedOffsetUs);
+  adc.conversionScan(codes);
+  writePoint(codes, channels, count);
+
+  if (steps > 0) {loadStep(channelsDac, vi, 1);}
+
+  timing.begin(stepPeriodUs * stats_utils::ticksPerMicrosecond(), timedOffsetUs * stats_utils::ticksPerMicrosecond());
+  timer_utils::begin(stepPeriodUs, timedOffsetUs, timedUpdate, timedSample);
+
+  for (uint32_t i = 1; i <= steps; i++) {
+    stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+
+    uint32_t workDone = stats_utils::ticks();
+    _timedArmed = true;
+
+    while (!_timedSampled) {timer_utils::service();}
+    _timedSampled = false;
+
+    timing.markUpdate(i, _timedUpdateTick, workDone);
+    timing.reschedule(i, _timedUpdateTick);
+    timing.markReadout(_timedSampleTick);
+
+    adc.readConversion(codes);
+    stats_utils::record(stats_utils::ADC_CONVERSION, stats_utils::ticks() - _timedSampleTick);
+
+    if (i < steps) {loadStep(channelsDac, vi, i + 1);}
+
+    writePoint(codes, channels, count);
+  }
+
+  timer_utils::stop();
+  timing.report();
+  return 0;
+}
+
+/**
+ * @brief Performs a bidirectional (hysteresis) sweep for the specified channels on the RAMPS board.
+ *
+ * The outputs go from 'vi' to 'vf' in nSteps steps and back to 'vi' in nSteps steps, 'sweepCycles' times, as one
+ * continuous sequence of steps: the turnaround step is an ordinary step of size dv, so there is no command round trip,
+ * no jump back to 'vi' and no repeated point between the legs. For buffered sweeps every reading goes through
+ * 'readPoint' and is preceded by a direction tag, "F," for points of the forward leg (including the initial point and
+ * the point at 'vf') and "R," for points of the reverse leg; readings dropped by the filter stage carry no tag. Steps
+ * follow the step period when one is set and the completion record counts all 2 * nSteps * cycles steps. Sweeps have
+ * no pipelined or hardware-timed variant, so setSweep, setPipelined and setTimed refuse to combine them.
+ *
+ * @param channelsDac An array indicating which channels to sweep.
+ * @param vi An array of initial voltage values for each corresponding channel.
+ * @param nSteps The number of steps of each leg.
+ * @param del The delay in milliseconds after each step.
+ * @param buffer Indicates whether to read the ADC after each step.
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::sweepRampIteration(uint8_t channelsDac[4], double vi[4], double nSteps, double del, bool buffer) {
+
+  uint32_t steps = (uint32_t) nSteps;
+  uint32_t step = 0;
+
+  filter.reset();
+  timing.begin(stepPeriodUs * stats_utils::ticksPerMicrosecond(), settleTicks(del));
+
+  delay(del);
+  if (buffer) {
+    timing.markReadout(stats_utils::ticks());
+    readPoint("F,");
+  }
+
+  for (uint32_t cycle = 0; cycle < sweepCycles; cycle++) {
+    for (uint32_t k = 1; k <= 2 * steps; k++) {
+      stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+      bool forward = (k <= steps);
+
+      //Position along the leg: up to nSteps on the way out, back down to 0 on the way back
+      loadStep(channelsDac, vi, forward ? k : 2 * steps - k);
+      uint32_t workDone = stats_utils::ticks();
+      step++;
+
+      if (stepPeriodUs > 0) {
+        uint32_t deadline = timing.deadline(step);
+        while ((int32_t) (stats_utils::ticks() - deadline) < 0) {}
+      }
+
+      uint32_t update = stats_utils::ticks();
+      dac.updateAnalogOutputs();
+      timing.markUpdate(step, update, workDone);
+
+      delay(del);
+
+      if (buffer) {
+        timing.markReadout(stats_utils::ticks());
+        readPoint(forward ? "F," : "R,");
+      }
+    }
+  }
+
+  if (buffer) {timing.report();}
+  return 0;
+}
+
+/**
+ * @brief Sets the number of bidirectional sweep cycles.
+ *
+ * @param cycles The number of vi -> vf -> vi cycles of each ramp, or 0 for one-way ramps.
+ * @return 0 if successful, 1 if cycles are set while the pipelined or hardware-timed ramp is enabled.
+ */
+uint8_t RAMPS::setSweep(uint32_t cycles) {
+  if (cycles > 0 && (pipelined || timedOffsetUs > 0)) {return 1;}
+  sweepCycles = cycles;
+  return 0;
+}
+
+/**
+ * @brief Configures the synchronized start of ramps across boards.
+ *
+ * With a sync pin set, every ramp started by simpleRamp waits for an edge on that pin before its first step (follower),
+ * or produces the edge itself (leader). Several boards sharing the line then start their ramps together. The leader
+ * drives the line to its idle level right away, so the followers' edge detectors see a clean transition later.
+ *
+ * @param pin The sync line, or -1 to start ramps immediately.
+ * @param edge The start edge: 0 rising, 1 falling, 2 any (as CAPTURE::TriggerEdge).
+ * @param timeoutMs The longest time a follower waits for the edge, 0 to wait until the edge or a byte from the host.
+ * @param drive True if this board is the leader and drives the line.
+ * @return 0 if successful, 1 if the edge is invalid.
+ */
+uint8_t RAMPS::setSync(int8_t pin, uint8_t edge, uint32_t timeoutMs, bool drive) {
+  if (edge > 2) {return 1;}
+  syncPin = pin;
+  syncEdge = edge;
+  syncTimeoutMs = timeoutMs;
+  syncDrive = drive;
+
+  if (pin >= 0 && drive) {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, (edge == 1) ? HIGH : LOW);
+  }
+  return 0;
+}
+
+/**
+ * @brief Waits for the synchronized start of a ramp.
+ *
+ * Does nothing without a sync pin. Otherwise it works as follows:
+ *   1. Prints "SYNC_ARMED", so the host knows this board is ready for the start edge.
+ *   2. The leader pulses the line (10 us at the start level, or a single toggle for any edge); a follower arms the
+ *      pin interrupt and waits for the edge, the timeout or a byte from the host, which is discarded with the rest of
+ *      its line. A follower with a timeout of 0 can therefore always be stopped from the host.
+ *   3. Writes a single status byte: '+' when the ramp starts, '!' on timeout or abort. One byte keeps the delay between
+ *      the edge and the first step short and equal on all boards. After '!' the Router ends the reply with a
+ *      "SYNC TIMEOUT" line, so the reply of an aborted ramp still has an end.
+ *
+ * @return 0 if the ramp may start, 1 on timeout or abort.
+ */
+uint8_t RAMPS::waitSync(void) {
+  if (syncPin < 0) {return 0;}
+
+  Serial.println("SYNC_ARMED");
+
+  if (syncDrive) {
+    if (syncEdge == 2) {digitalWrite(syncPin, digitalRead(syncPin) == HIGH ? LOW : HIGH);}
+    else {
+      digitalWrite(syncPin, (syncEdge == 1) ? LOW : HIGH);
+      delayMicroseconds(10);
+      digitalWrite(syncPin, (syncEdge == 1) ? HIGH : LOW);
+    }
+    Serial.write('+');
+    return 0;
+  }
+
+  uint32_t mode = (syncEdge == 0) ? RISING : (syncEdge == 1) ? FALLING : CHANGE;
+  pinMode(syncPin, INPUT);
+  _syncTriggered = false;
+  attachInterrupt(digitalPinToInterrupt(syncPin), syncIsr, mode);
+
+  //A byte from the host aborts the wait, so a follower without a leader never hangs the board
+  uint32_t start = millis();
+  while (!_syncTriggered) {
+    bool aborted = Serial.available() > 0;
+    if (aborted || (syncTimeoutMs > 0 && millis() - start >= syncTimeoutMs)) {
+      detachInterrupt(digitalPinToInterrupt(syncPin));
+      if (aborted) {interface_utils::discardLine(kSyncAbortTimeoutMs);}
+      Serial.write('!');
+      return 1;
+    }
+  }
+  detachInterrupt(digitalPinToInterrupt(syncPin));
+  Serial.write('+');
+  return 0;
+}
+
+/**
+ * @brief Performs an adaptive buffered ramp for the specified channels on the RAMPS board.
+ *
+ * The outputs move along the straight line v(s) = vi + s * (vf - vi) from s = 0 to s = 1, but instead of nSteps equal
+ * steps the step size follows the measured signal. Step sizes are given in volts along the channel with the largest
+ * span. After each point:
+ *   1. The largest change of any enabled ADC channel since the previous point is compared with 'threshold'.
+ *   2. The next step is scaled by threshold / change, limited to halving or doubling per point, so that every step
+ *      changes the signal by about 'threshold': steps shrink on sharp features and grow on flat regions.
+ *   3. The step is clamped to [minStep, maxStep] and the last step ends exactly on vf.
+ * The first step is minStep. Every point settles for 'del' milliseconds before a single quiet conversion of the enabled
+ * ADC channels (oversampling and the filter stage are not applied). Since the positions are not known beforehand, each
+ * point carries its DAC codes. The output starts with ADAPTIVE_BEGIN,dacChannels,adcChannels followed by one binary
+ * record per point: a 0x01 byte, the 20-bit code of each active DAC channel and the 24-bit code of each enabled ADC
+ * channel, 3 bytes MSB first each, in ascending channel order. A 0x00 byte ends the records and is followed by
+ * ADAPTIVE_DONE,points,elapsed_us.
+ *
+ * @param channelsDac An array indicating which channels to ramp.
+ * @param vi An array of initial voltage values for each corresponding channel.
+ * @param vf An array of final voltage values for each corresponding channel.
+ * @param minStep The smallest step in volts along the channel with the largest span.
+ * @param maxStep The largest step in volts along the channel with the largest span.
+ * @param threshold The intended ADC change in volts per step.
+ * @param del The settling delay in milliseconds before each reading.
+ * @return 0 on success, 1 if the span is zero or the step bounds or threshold are invalid.
+ */
+uint8_t RAMPS::adaptiveRamp(uint8_t channelsDac[4], double vi[4], double vf[4], double minStep, double maxStep, double threshold, double del) {
+
+  double span = 0;
+  uint8_t dacCount = 0;
+  for (int j = 0; j < 4; j++) {
+    if (channelsDac[j] == 1) {
+      span = max(span, fabs(vf[j] - vi[j]));
+      dacCount++;
+    }
+  }
+  if (span == 0 || minStep <= 0 || maxStep < minStep || threshold <= 0) {return 1;}
+
+  uint8_t channels[16];
+  uint8_t count = adc.activeChannels(channels);
+  uint32_t codes[16];
+  uint32_t previous[16];
+  uint8_t record[1 + 3 * 4 + 3 * 16];
+
+  //Step bounds as fractions of the path, threshold in ADC code units
+  double dsMin = minStep / span;
+  double dsMax = maxStep / span;
+  double limit = threshold * 8388608 / 25;
+  double ds = dsMin;
+  double s = 0;
+  uint32_t points = 0;
+
+  Serial.print("ADAPTIVE_BEGIN,");
+  Serial.print(dacCount);
+  Serial.print(",");
+  Serial.println(count);
+
+  uint32_t start = micros();
+
+  while (true) {
+    stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+    uint8_t n = 0;
+    record[n++] = 0x01;
+
+    for (int j = 0; j < 4; j++) {
+      if (channelsDac[j] == 1) {
+        uint32_t code = dac.voltageToCode(vi[j] + s * (vf[j] - vi[j]));
+        dac.writeCode(j, code);
+        record[n++] = (uint8_t) (code >> 16);
+        record[n++] = (uint8_t) (code >> 8);
+        record[n++] = (uint8_t) code;
+      }
+    }
+    dac.updateAnalogOutputs();
+    delay(del);
+
+    adc.conversionScan(codes);
+    double change = 0;
+    for (uint8_t c = 0; c < count; c++) {
+      uint32_t code = codes[channels[c]];
+      if (points > 0) {change = max(change, fabs((double) code - (double) previous[channels[c]]));}
+      previous[channels[c]] = code;
+      record[n++] = (uint8_t) (code >> 16);
+      record[n++] = (uint8_t) (code >> 8);
+      record[n++] = (uint8_t) code;
+    }
+
+    {
+      stats_utils::ScopedTimer serial(stats_utils::SERIAL_WRITE);
+      Serial.write(record, n);
+    }
+    points++;
+
+    if (s >= 1) {break;}
+
+    //Aim for a change of 'threshold' on the next step, at most halving or doubling the step
+    if (points > 1) {
+      double scale = (change > 0) ? limit / change : 2;
+      ds *= (scale < 0.5) ? 0.5 : (scale > 2) ? 2 : scale;
+      ds = (ds < dsMin) ? dsMin : (ds > dsMax) ? dsMax : ds;
+    }
+    s = (s + ds > 1) ? 1 : s + ds;
+  }
+
+  uint8_t end = 0x00;
+  Serial.write(&end, 1);
+  Serial.print("ADAPTIVE_DONE,");
+  Serial.print(points);
+  Serial.print(",");
+  Serial.println(micros() - start);
+  return 0;
+}
+
+/**
+ * @brief Performs a slew-rate limited ramp for the specified channels on the RAMPS board.
+ *
+ * Instead of a step count and a delay, every active channel gets a maximum slew rate and a maximum step size. The
+ * schedule is computed so that all channels move together and the ramp lasts exactly as long as the most constrained
+ * channel requires:
+ *   1. The step count is the smallest one that keeps every channel's step within its maxStep.
+ *   2. The duration is the longest |vf - vi| / maxSlew over the active channels, and the step period is the duration
+ *      divided by the step count. Each step of dv every period then moves no channel faster than its limit.
+ *   3. A period below kMinSlewPeriodUs, the time needed to load and apply one step, is raised to it; a period above
+ *      kMaxSlewPeriodUs is brought down by adding steps, which only makes the steps smaller.
+ * Limits that need more than kMaxSlewSteps steps, e.g. a tiny maxStep, are rejected before any output changes.
+ * The schedule is printed as SLEW_RAMP,nSteps,period_us,duration_ms before the first step. The steps are paced on the
+ * step timing grid without settling delay; for buffered ramps each step is followed by one reading through 'readPoint'
+ * and by the completion record, whose overrun count shows steps whose reading did not fit into the period. The outputs
+ * are set to 'vi' at once, so a 'vi' farther than maxStep from the last voltage written to its channel is rejected:
+ * that first jump would break the slew limit before the ramp starts.
+ *
+ * @param channelsDac An array indicating which channels to ramp.
+ * @param vi An array of initial voltage values for each corresponding channel.
+ * @param vf An array of final voltage values for each corresponding channel.
+ * @param maxSlew An array of maximum slew rates in V/s for each corresponding channel.
+ * @param maxStep An array of maximum step sizes in V for each corresponding channel.
+ * @param buffer Indicates whether to read the ADC after each step.
+ * @return 0 on success, 1 if the slew rate or step size of an active channel is not positive or the step count exceeds
+ *         kMaxSlewSteps, 2 if 'vi' is more than maxStep away from the present output of an active channel.
+ */
+uint8_t RAMPS::slewRamp(uint8_t channelsDac[4], double vi[4], double vf[4], double maxSlew[4], double maxStep[4], bool buffer) {
+
+  double nSteps = 1;
+  double durationUs = 0;
+
+  for (int j = 0; j < 4; j++) {
+    if (channelsDac[j] == 1) {
+      if (maxSlew[j] <= 0 || maxStep[j] <= 0) {return 1;}
+      if (fabs(vi[j] - dac.vReadings[j]) > maxStep[j]) {return 2;}
+      double span = fabs(vf[j] - vi[j]);
+      nSteps = max(nSteps, ceil(span / maxStep[j]));
+      durationUs = max(durationUs, 1e6 * span / maxSlew[j]);
+    }
+  }
+
+  double periodUs = ceil(durationUs / nSteps);
+  if (periodUs > kMaxSlewPeriodUs) {
+    nSteps = ceil(durationUs / kMaxSlewPeriodUs);
+    periodUs = ceil(durationUs / nSteps);
+  }
+  if (periodUs < kMinSlewPeriodUs) {periodUs = kMinSlewPeriodUs;}
+
+  //The step count is stored in 32 bits
+  if (nSteps > kMaxSlewSteps) {return 1;}
+
+  uint32_t steps = (uint32_t) nSteps;
+  uint32_t period = (uint32_t) periodUs;
+
+  Serial.print("SLEW_RAMP,");
+  Serial.print(steps);
+  Serial.print(",");
+  Serial.print(period);
+  Serial.print(",");
+  Serial.println((double) steps * period / 1000, 3);
+
+  calcDv(channelsDac, vi, vf, nSteps);
+  loadStep(channelsDac, vi, 0);
+  dac.updateAnalogOutputs();
+
+  filter.reset();
+  timing.begin(period * stats_utils::ticksPerMicrosecond(), 0);
+
+  if (buffer) {
+    timing.markReadout(stats_utils::ticks());
+    readPoint();
+  }
+
+  for (uint32_t i = 1; i <= steps; i++) {
+    stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+
+    //The last step lands exactly on vf
+    if (i == steps) {loadStep(channelsDac, vf, 0);}
+    else {loadStep(channelsDac, vi, i);}
+    uint32_t workDone = stats_utils::ticks();
+
+    uint32_t deadline = timing.deadline(i);
+    while ((int32_t) (stats_utils::ticks() - deadline) < 0) {}
+
+    uint32_t update = stats_utils::ticks();
+    dac.updateAnalogOutputs();
+    timing.markUpdate(i, update, workDone);
+
+    if (buffer) {
+      timing.markReadout(stats_utils::ticks());
+      readPoint();
+    }
+  }
+
+  if (buffer) {timing.report();}
+  return 0;
+}
+
+/**
+ * @brief Enables or disables the hardware-timed buffered ramp.
+ *
+ * The conversion of a step must start before the next LDAC pulse, so the offset must be shorter than the step period
+ * set with setStepPeriod().
+ *
+ * @param offsetUs The delay from each LDAC pulse to the start of the conversion in microseconds, or 0 to disable.
+ * @return 0 if successful, 1 if the offset is not shorter than the step period, 2 if sweep cycles are set.
+ */
+uint8_t RAMPS::setTimed(uint32_t offsetUs) {
+  if (offsetUs > 0 && sweepCycles > 0) {return 2;}
+  if (offsetUs > 0 && offsetUs >= stepPeriodUs) {return 1;}
+  timedOffsetUs = offsetUs;
+  return 0;
+}
+
+/**
+ * @brief Clears the stored path.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::pathClear(void) {
+  nVertices = 0;
+  return 0;
+}
+
+/**
+ * @brief Appends a vertex to the stored path.
+ *
+ * The first vertex is the starting point of the path and its step count is ignored. Every following vertex ends a
+ * linear segment from the previous vertex, divided into nSteps steps. Vertices are kept in a fixed buffer of
+ * kMaxVertices entries.
+ *
+ * @param v The voltages of the vertex for each of the 4 DAC channels.
+ * @param nSteps The number of steps of the segment ending at this vertex (at least 1).
+ * @param dwellMs The time to stay at this vertex before the next segment, in milliseconds.
+ * @return The number of stored vertices, or 0 if the buffer is full.
+ */
+uint8_t RAMPS::pathAdd(double v[4], uint32_t nSteps, uint32_t dwellMs) {
+
+  if (nVertices >= kMaxVertices) {return 0;}
+
+  PathVertex& vertex = path[nVertices];
+  for (int j = 0; j < 4; j++) {
+    vertex.v[j] = v[j];
+  }
+  vertex.nSteps = (nSteps < 1) ? 1 : nSteps;
+  vertex.dwellMs = dwellMs;
+
+  return ++nVertices;
+}
+
+/**
+ * @brief Plays the stored path on the specified channels.
+ *
+ * The outputs are set to the first vertex, then every segment is stepped in turn. Segment step sizes are computed with
+ * 'calcDv' and the codes are loaded with 'loadStep' without serial output, so there is no host round trip and no
+ * re-initialisation between segments: the last step of a segment lands exactly on its vertex and the next segment
+ * starts from there. Each step is followed by the settling delay 'del' and, for buffered paths, one reading through
+ * 'readPoint' (oversampling and the filter stage apply). After the last vertex a PATH_DONE,segments,points,elapsed_us
+ * line is printed.
+ *
+ * @param channelsDac An array indicating which channels follow the path.
+ * @param del The delay in milliseconds after each step.
+ * @param buffer Indicates whether to read the ADC after each step.
+ * @return 0 if successful, 1 if fewer than two vertices are stored.
+ */
+uint8_t RAMPS::pathRun(uint8_t channelsDac[4], double del, bool buffer) {
+
+  if (nVertices < 2) {
+    Serial.println("PATH NEEDS 2 VERTICES");
+    return 1;
+  }
+
+  uint32_t points = 0;
+  uint32_t start = micros();
+
+  filter.reset();
+  loadStep(channelsDac, path[0].v, 0);
+  dac.updateAnalogOutputs();
+  delay(del);
+  if (buffer) {readPoint(); points++;}
+  delay(path[0].dwellMs);
+
+  for (uint8_t s = 1; s < nVertices; s++) {
+    double* from = path[s - 1].v;
+    calcDv(channelsDac, from, path[s].v, path[s].nSteps);
+
+    for (uint32_t i = 1; i <= path[s].nSteps; i++) {
+      stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+
+      //The last step uses the vertex itself so rounding never accumulates across segments
+      if (i == path[s].nSteps) {loadStep(channelsDac, path[s].v, 0);}
+      else {loadStep(channelsDac, from, i);}
+      dac.updateAnalogOutputs();
+
+      delay(del);
+      if (buffer) {readPoint(); points++;}
+    }
+    delay(path[s].dwellMs);
+  }
+
+  Serial.print("PATH_DONE,");
+  Serial.print(nVertices - 1);
+  Serial.print(",");
+  Serial.print(points);
+  Serial.print(",");
+  Serial.println((uint32_t) (micros() - start));
+  return 0;
+}
+
+/**
+ * @brief Performs a 2D raster scan.
+ *
+ * For every point of the slow axis, the fast axis is swept over its nPoints points and the enabled ADC channels are
+ * read at each of them, without any command round trip between lines. The output is:
+ *   - a RASTER_BEGIN,lines,points,adc_channels line,
+ *   - one binary frame per line: 0xA5 0x5A, line index (2 bytes, MSB first), direction (0 = vi to vf, 1 = vf to vi),
+ *     number of points (2 bytes, MSB first), then for every point 3 bytes MSB first per enabled ADC channel in
+ *     ascending channel order, in the order the points were taken,
+ *   - a RASTER_DONE,lines,elapsed_us line.
+ * At the start of each line the slow axis and the first fast point are applied together and the scan waits
+ * 'retraceMs' for the retrace to settle. With 'serpentine', odd lines sweep the fast axis backwards so there is no
+ * retrace jump. Every point waits 'settleUs' after its update; the ADC conversion of a point then overlaps loading the
+ * next fast point, as in 'pipelinedRampIteration'.
+ *
+ * @param fast The fast axis, swept along each line.
+ * @param slow The slow axis, stepped once per line.
+ * @param settleUs The settling time after each point update in microseconds.
+ * @param retraceMs The settling time at the start of each line in milliseconds.
+ * @param serpentine If true, odd lines are swept from vf to vi.
+ * @return 0 if successful, 1 if an axis is invalid.
+ */
+uint8_t RAMPS::raster(RasterAxis fast, RasterAxis slow, uint32_t settleUs, uint32_t retraceMs, bool serpentine) {
+
+  if (fast.channel > 3 || slow.channel > 3 || fast.channel == slow.channel ||
+      fast.nPoints < 1 || slow.nPoints < 1 || fast.nPoints > 65535 || slow.nPoints > 65535) {
+    return 1;
+  }
+
+  uint8_t channels[16];
+  uint8_t count = adc.activeChannels(channels);
+  uint32_t codes[16];
+
+  double fastDv = (fast.nPoints > 1) ? (fast.vf - fast.vi) / (fast.nPoints - 1) : 0;
+  double slowDv = (slow.nPoints > 1) ? (slow.vf - slow.vi) / (slow.nPoints - 1) : 0;
+
+  Serial.print("RASTER_BEGIN,");
+  Serial.print(slow.nPoints);
+  Serial.print(",");
+  Serial.print(fast.nPoints);
+  Serial.print(",");
+  Serial.println(count);
+
+  uint32_t start = micros();
+
+  for (uint32_t line = 0; line < slow.nPoints; line++) {
+    bool reverse = serpentine && (line % 2 == 1);
+
+    //Line start: slow axis and first fast point together, then retrace settling
+    dac.writeCode(slow.channel, dac.voltageToCode(slow.vi + line * slowDv));
+    uint32_t first = reverse ? fast.nPoints - 1 : 0;
+    dac.writeCode(fast.channel, dac.voltageToCode(fast.vi + first * fastDv));
+    dac.updateAnalogOutputs();
+    delay(retraceMs);
+
+    uint8_t header[7] = {0xA5, 0x5A, (uint8_t) (line >> 8), (uint8_t) line, (uint8_t) reverse,
+                         (uint8_t) (fast.nPoints >> 8), (uint8_t) fast.nPoints};
+    Serial.write(header, 7);
+
+    for (uint32_t k = 0; k < fast.nPoints; k++) {
+      stats_utils::ScopedTimer timer(stats_utils::RAMP_STEP);
+
+      //Points after the first were loaded during the previous conversion
+      if (k > 0) {dac.updateAnalogOutputs();}
+      delayMicroseconds(settleUs);
+
+      adc.startConversion();
+      if (k + 1 < fast.nPoints) {
+        uint32_t next = reverse ? fast.nPoints - 2 - k : k + 1;
+        dac.writeCode(fast.channel, dac.voltageToCode(fast.vi + next * fastDv));
+      }
+      adc.readConversion(codes);
+
+      writePoint(codes, channels, count);
+    }
+  }
+
+  Serial.println("");
+  Serial.print("RASTER_DONE,");
+  Serial.print(slow.nPoints);
+  Serial.print(",");
+  Serial.println((uint32_t) (micros() - start));
+  return 0;
+}
+
+/**
+ * @brief Loads the DAC codes of one ramp step without updating the outputs.
+ *
+ * @param channelsDac An array indicating which channels take part in the ramp.
+ * @param vi An array of initial voltage values for each corresponding channel.
+ * @param step The step number, starting at 1; step 0 loads the initial voltages.
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::loadStep(uint8_t channelsDac[4], double vi[4], uint32_t step) {
+  for (int j = 0; j < 4; j++) {
+    if (channelsDac[j] == 1) {
+      dac.writeCode(j, dac.voltageToCode(vi[j] + step * dv[j]));
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Writes the raw codes of one point to the serial port.
+ *
+ * Sends 3 bytes, MSB first, per enabled channel in ascending channel order as a single write, so that the transfer is
+ * queued in the serial transmit buffer and drains while the next step runs.
+ *
+ * @param codes Array of 16 raw codes indexed by channel.
+ * @param channels The enabled channels, as returned by AD4115::activeChannels.
+ * @param count The number of enabled channels.
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::writePoint(uint32_t codes[16], uint8_t channels[16], uint8_t count) {
+
+  uint8_t buf[48];
+
+  for (uint8_t c = 0; c < count; c++) {
+    uint32_t code = codes[channels[c]];
+    buf[3 * c] = (uint8_t) (code >> 16);
+    buf[3 * c + 1] = (uint8_t) (code >> 8);
+    buf[3 * c + 2] = (uint8_t) code;
+  }
+
+  stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
+  Serial.write(buf, 3 * count);
+  return 0;
+}
+
+/**
+ * @brief Enables or disables the pipelined buffered ramp.
+ *
+ * @param enable If true, buffered ramps use 'pipelinedRampIteration'.
+ * @return 0 if successful, 1 if sweep cycles are set.
+ */
+uint8_t RAMPS::setPipelined(bool enable) {
+  if (enable && sweepCycles > 0) {return 1;}
+  pipelined = enable;
+  return 0;
+}
+
+/**
+ * @brief Sets the intended step period of buffered ramps.
+ *
+ * With a non-zero period, bufferRampIteration() schedules the LDAC pulse of step k at k periods after the start of the
+ * ramp instead of issuing it as soon as the previous step is done, and counts a step as an overrun when its work was
+ * not finished by its scheduled time. With a period of 0 the ramp runs free and only the jitter is recorded. While the
+ * hardware-timed mode is enabled, the period must stay longer than the timed offset, so that a timed ramp, whose raw
+ * stream has no room for an error line, is never rejected once it has been configured.
+ *
+ * @param periodUs The step period in microseconds, or 0 for free running steps.
+ * @return 0 if successful, 1 if the period is not longer than the timed offset.
+ */
+uint8_t RAMPS::setStepPeriod(uint32_t periodUs) {
+  if (timedOffsetUs > 0 && periodUs <= timedOffsetUs) {return 1;}
+  stepPeriodUs = periodUs;
+  return 0;
+}
+
+/**
+ * @brief Sets the on-device oversampling of buffered ramps.
+ *
+ * With n greater than 1, every point of a buffered ramp takes n readings of each enabled ADC channel and only the
+ * reduced result is sent (see oversampledReading). With n equal to 1 the ramp sends every reading as before.
+ *
+ * @param n The number of readings per point and channel, from 1 to 65535.
+ * @param stats If true, min, max and variance are sent along with the mean.
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::setOversampling(uint32_t n, bool stats) {
+  nAverage = (n < 1) ? 1 : (n > 65535) ? 65535 : n;
+  averageStats = stats;
+  return 0;
+}
+
+/**
+ * @brief Reads and sends one point of a buffered ramp.
+ *
+ * Dispatches to 'filteredReading' when a filter is configured, to 'oversampledReading' when oversampling is enabled, or
+ * to 'bufferRampFullReading' for a single reading per point. The filter stage takes precedence over oversampling.
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::readPoint(void) {
+  return readPoint("");
+}
+
+/**
+ * @brief Reads and sends one point of a buffered ramp, preceded by a tag.
+ *
+ * Like readPoint(void), but prints 'tag' right before the point. The tag is only printed when a point is actually sent,
+ * so a reading that the filter stage decimates away leaves no orphan tag in the stream.
+ *
+ * @param tag The text printed before the point, e.g. "F,".
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::readPoint(const char* tag) {
+  if (filter.anyEnabled()) {return filteredReading(tag);}
+  Serial.print(tag);
+  if (nAverage > 1) {return oversampledReading();}
+  adc.bufferRampFullReading();
+  return 0;
+}
+
+/**
+ * @brief Takes nAverage readings of every enabled channel and sends their reduction.
+ *
+ * The ADC is run in continuous conversion mode for nAverage conversions of each enabled channel. Readings are
+ * accumulated in integer as offsets from the first reading of the channel, which keeps the sum of squares inside
+ * 64 bits for any number of readings up to 2^16, and the minimum and maximum codes are tracked. Only the reduced result
+ * is converted to voltage and sent, as one line per point with, for each enabled channel in ascending order, the mean
+ * or, when stats are enabled, mean,min,max,variance (volts and volts squared).
+ *
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::oversampledReading(void) {
+
+  uint8_t channels[16];
+  uint8_t count = adc.activeChannels(channels);
+
+  uint32_t first[16];
+  uint32_t minCode[16];
+  uint32_t maxCode[16];
+  int64_t sum[16];
+  uint64_t sumSq[16];
+
+  {
+    uint32_t start = stats_utils::ticks();
+    adc.startContinuous();
+
+    for (uint32_t k = 0; k < nAverage; k++) {
+      for (uint8_t c = 0; c < count; c++) {
+        uint8_t sample[3];
+        adc.readSample(sample);
+        uint32_t code = ((uint32_t) sample[0] << 16) | ((uint32_t) sample[1] << 8) | sample[2];
+
+        if (k == 0) {
+          first[c] = code;
+          minCode[c] = code;
+          maxCode[c] = code;
+          sum[c] = 0;
+          sumSq[c] = 0;
+        }
+
+        int32_t d = (int32_t) code - (int32_t) first[c];
+        sum[c] += d;
+        sumSq[c] += (int64_t) d * d;
+
+        if (code < minCode[c]) {minCode[c] = code;}
+        if (code > maxCode[c]) {maxCode[c] = code;}
+      }
+    }
+
+    adc.stopContinuous();
+    stats_utils::record(stats_utils::ADC_CONVERSION, stats_utils::ticks() - start);
+  }
+
+  stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
+  double lsb = 25.0 / 8388608;
+
+  for (uint8_t c = 0; c < count; c++) {
+    double meanOffset = (double) sum[c] / nAverage;
+
+    if (c > 0) {Serial.print(",");}
+    Serial.print(adc.voltageMap(first[c] + meanOffset), 6);
+
+    if (averageStats) {
+      double variance = (nAverage > 1) ? ((double) sumSq[c] - (double) sum[c] * meanOffset) / (nAverage - 1) : 0;
+
+      Serial.print(",");
+      Serial.print(adc.voltageMap(minCode[c]), 6);
+      Serial.print(",");
+      Serial.print(adc.voltageMap(maxCode[c]), 6);
+      Serial.print(",");
+      Serial.print(variance * lsb * lsb, 12);
+    }
+  }
+  Serial.println("");
+  return 0;
+}
+
+/**
+ * @brief Reads one point of a buffered ramp through the filter stage.
+ *
+ * Converts all enabled channels once and feeds each raw code into the channel's filter. Channels without a configured
+ * filter pass every reading. Only the outputs due at this reading are sent, as one line of channel:voltage pairs
+ * separated by commas, after 'tag'; nothing is sent when no channel produced an output, so the serial traffic drops by
+ * the output rate divider.
+ *
+ * @param tag The text printed before the line when one is sent.
+ * @return 0 indicating successful execution.
+ */
+uint8_t RAMPS::filteredReading(const char* tag) {
+
+  uint8_t channels[16];
+  uint8_t count = adc.activeChannels(channels);
+  uint32_t codes[16];
+  bool first = true;
+
+  adc.conversionScan(codes);
+
+  stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
+
+  for (uint8_t c = 0; c < count; c++) {
+    uint8_t ch = channels[c];
+    uint32_t out = codes[ch];
+
+    if (filter.enabled(ch) && !filter.push(ch, codes[ch], &out)) {continue;}
+
+    Serial.print(first ? tag : ",");
+    Serial.print(ch);
+    Serial.print(":");
+    Serial.print(adc.voltageMap(out), 6);
+    first = false;
   }
+  if (!first) {Serial.println("");}
   return 0;
 }
 
+/**
+ * @brief Starts recording the step timing of a buffered ramp.
+ *
+ * Clears all counters and histograms and takes the current time as the anchor of the ramp, i.e. the time at which the
+ * initial voltages were applied.
+ *
+ * @param periodTicks The intended step period in ticks, or 0 for free running steps.
+ * @param settleTicks The intended time between an LDAC pulse and the following ADC readout in ticks.
+ */
+void RampTiming::begin(uint32_t periodTicks, uint32_t settleTicks) {
+  period = periodTicks;
+  settle = settleTicks;
+  reference = 0;
+  steps = 0;
+  overruns = 0;
+  maxUpdateJitter = 0;
+  maxSettleJitter = 0;
+  for (uint8_t bin = 0; bin < stats_utils::kHistogramBins; bin++) {
+    updateJitter[bin] = 0;
+    settleJitter[bin] = 0;
+  }
+  anchor = stats_utils::ticks();
+  lastUpdate = anchor;
+  elapsed = 0;
+}
+
+/**
+ * @brief Returns the scheduled LDAC time of a step.
+ *
+ * @param step The step number, starting at 1 for the first step after the initial point.
+ * @return The scheduled time in ticks. Only meaningful when a step period is set.
+ */
+uint32_t RampTiming::deadline(uint32_t step) {
+  return anchor + step * period;
+}
+
+/**
+ * @brief Moves the schedule after a step that missed its update event.
+ *
+ * In the hardware-timed mode a step that is not loaded in time is applied at a later update event of the step timer,
+ * and every following event keeps that delay. Called after markUpdate, which counts the late step as an overrun: when
+ * the pulse lies a period or more after the scheduled time, the anchor is moved by the whole missed periods, so that
+ * later steps are compared with the events the timer actually produces.
+ *
+ * @param step The step number, starting at 1.
+ * @param now The time of the LDAC pulse in ticks.
+ */
+void RampTiming::reschedule(uint32_t step, uint32_t now) {
+  if (period == 0) {return;}
+
+  int32_t late = (int32_t) (now - deadline(step));
+  if (late < (int32_t) period) {return;}
+
+  anchor += (uint32_t) late / period * period;
+}
+
+/**
+ * @brief Records the LDAC pulse of a step.
+ *
+ * With a step period, the intended time is the fixed schedule anchor + step * period and the step is counted as an
+ * overrun when its work finished after that time. Without a step period, the first step interval becomes the
+ * reference and the intended time of every later step is the previous pulse plus the reference. The absolute
+ * difference between the actual and intended time is added to the update jitter histogram.
+ *
+ * @param step The step number, starting at 1.
+ * @param now The time of the LDAC pulse in ticks.
+ * @param workDone The time at which the step was ready to be applied, in ticks.
+ */
+void RampTiming::markUpdate(uint32_t step, uint32_t now, uint32_t workDone) {
+  uint32_t intended;
+
+  if (period > 0) {
+    intended = deadline(step);
+    if ((int32_t) (workDone - intended) > 0) {overruns++;}
+  }
+  else {
+    if (step == 1) {reference = now - anchor;}
+    intended = lastUpdate + reference;
+  }
+
+  int32_t jitter = (int32_t) (now - intended);
+  uint32_t absJitter = (jitter < 0) ? -jitter : jitter;
+
+  if (absJitter > maxUpdateJitter) {maxUpdateJitter = absJitter;}
+  updateJitter[stats_utils::histogramBin(absJitter / stats_utils::ticksPerMicrosecond())]++;
+
+  elapsed += now - lastUpdate;
+  lastUpdate = now;
+  steps++;
+}
+
+/**
+ * @brief Records the start of an ADC readout.
+ *
+ * The intended readout time is the last LDAC pulse plus the settling delay of the ramp. The absolute difference is
+ * added to the settle jitter histogram.
+ *
+ * @param now The time at which the readout starts, in ticks.
+ */
+void RampTiming::markReadout(uint32_t now) {
+  int32_t jitter = (int32_t) (now - (lastUpdate + settle));
+  uint32_t absJitter = (jitter < 0) ? -jitter : jitter;
+
+  if (absJitter > maxSettleJitter) {maxSettleJitter = absJitter;}
+  settleJitter[stats_utils::histogramBin(absJitter / stats_utils::ticksPerMicrosecond())]++;
+}
+
+/**
+ * @brief Prints the ramp completion record.
+ *
+ * Prints three lines after the last reading of a buffered ramp:
+ *   - RAMP_DONE,steps,period_us,mean_period_us,overruns,max_update_jitter_us,max_settle_jitter_us
+ *   - UPDATE_JITTER,hist_0,...,hist_15
+ *   - SETTLE_JITTER,hist_0,...,hist_15
+ */
+void RampTiming::report(void) {
+  double meanPeriod = (steps > 0) ? stats_utils::ticksToMicros(1) * ((double) elapsed / steps) : 0;
+
+  Serial.print("RAMP_DONE,");
+  Serial.print(steps);
+  Serial.print(",");
+  Serial.print(stats_utils::ticksToMicros(period), 3);
+  Serial.print(",");
+  Serial.print(meanPeriod, 3);
+  Serial.print(",");
+  Serial.print(overruns);
+  Serial.print(",");
+  Serial.print(stats_utils::ticksToMicros(maxUpdateJitter), 3);
+  Serial.print(",");
+  Serial.println(stats_utils::ticksToMicros(maxSettleJitter), 3);
+
+  Serial.print("UPDATE_JITTER");
+  for (uint8_t bin = 0; bin < stats_utils::kHistogramBins; bin++) {
+    Serial.print(",");
+    Serial.print(updateJitter[bin]);
+  }
+  Serial.println("");
+
+  Serial.print("SETTLE_JITTER");
+  for (uint8_t bin = 0; bin < stats_utils::kHistogramBins; bin++) {
+    Serial.print(",");
+    Serial.print(settleJitter[bin]);
+  }
+  Serial.println("");
+}
+
 /**
  * @brief Performs a simple ramp for the specified channels on the RAMPS board.
  *
@@ -174,9 +1339,13 @@ uint8_t RAMPS::bufferRampIteration(uint8_t channelsDac[4], double vi[4], double
  * specifies the delay in milliseconds between each step of the ramp. The ramp iteration updates the voltage of each
  * channel incrementally based on the voltage step size previously calculated and stored in the 'dv' array. The updated
  * voltage values are applied to the DAC channels using the 'setVi' function. If the 'buffer' parameter is set to true,
- * the ramp iteration will use the 'bufferRampIteration' function, which includes ADC readings after each step. If set
- * to false, the 'simpleRampIteration' function will be used instead. Optional Serial print statements can be uncommented
- * for debugging or logging purposes.
+ * the ramp iteration will use the 'bufferRampIteration' function, which includes ADC readings after each step, or the
+ * 'pipelinedRampIteration' function when pipelining is enabled, or the 'timedRampIteration' function when the
+ * hardware-timed mode is enabled (the delay is then replaced by the timed offset, which must be shorter than the step
+ * period; otherwise the ramp is rejected before any output changes). If set to false, the 'simpleRampIteration'
+ * function will be used instead. When sweep cycles are set, the 'sweepRampIteration' function runs the bidirectional
+ * sweep for both buffered and simple ramps. When a sync line is set with 'setSync', the iteration starts on the shared
+ * start edge (see waitSync). Optional Serial print statements can be uncommented for debugging or logging purposes.
  *
  * @param channelsDac An array indicating which channels to perform the ramp on.
  * @param vi An array of initial voltage values for each corresponding channel.
@@ -184,7 +1353,7 @@ uint8_t RAMPS::bufferRampIteration(uint8_t channelsDac[4], double vi[4], double
  * @param nSteps The number of steps in the ramp.
  * @param del The delay in milliseconds between each step of the ramp.
  * @param buffer Indicates whether to use buffer ramp iteration (true) or simple ramp iteration (false).
- * @return void
+ * @return 0 if successful, 1 on a sync timeout, 2 if the timed offset is not shorter than the step period.
  */
 uint8_t RAMPS::simpleRamp(uint8_t channelsDac[4], double vi[4], double vf[4], double nSteps, double del, bool buffer) {
   
@@ -192,6 +1361,9 @@ uint8_t RAMPS::simpleRamp(uint8_t channelsDac[4], double vi[4], double vf[4], do
 
   //double prevVoltage;
 
+  bool timed = buffer && sweepCycles == 0 && timedOffsetUs > 0;
+  if (timed && stepPeriodUs <= timedOffsetUs) {return 2;}
+
   calcDv(channelsDac, vi, vf, nSteps);
 
   // Serial.print("dv : ");
@@ -200,7 +1372,12 @@ uint8_t RAMPS::simpleRamp(uint8_t channelsDac[4], double vi[4], double vf[4], do
   //      Serial.print(", ");
   //   } 
 
-  setVi(channelsDac, vi);
+  //The pipelined ramp streams binary data, so its initial voltages are set without serial output
+  if (sweepCycles > 0 || (buffer && (pipelined || timedOffsetUs > 0))) {
+    loadStep(channelsDac, vi, 0);
+    dac.updateAnalogOutputs();
+  }
+  else {setVi(channelsDac, vi);}
   // Serial.println("");
 
   // Serial.print("Initial voltages: ");
@@ -209,10 +1386,17 @@ uint8_t RAMPS::simpleRamp(uint8_t channelsDac[4], double vi[4], double vf[4], do
   //      Serial.print(", ");
   //   } 
 
-  if (buffer) {bufferRampIteration(channelsDac, vi, nSteps, del);}
+  //With a sync line set, the ramp starts on the shared edge, after the initial voltages are applied
+  if (waitSync() != 0) {return 1;}
+
+  if (sweepCycles > 0) {sweepRampIteration(channelsDac, vi, nSteps, del, buffer);}
+  else if (timed) {timedRampIteration(channelsDac, vi, nSteps);}
+  else if (buffer && pipelined) {pipelinedRampIteration(channelsDac, vi, nSteps, del);}
+  else if (buffer) {bufferRampIteration(channelsDac, vi, nSteps, del);}
   else {simpleRampIteration(channelsDac, vi, nSteps, del);}
 
   
   //Serial.println("");
 
+  return 0;
 }
@@ -0,0 +1,256 @@
+#include "../include/sequencer.h"
+#include "../include/stats.h"
+#include <stdint.h>
+#include <string.h>
+#include <SPI.h>
+#include <Arduino.h>
+using namespace std;
+
+// Milliseconds without a byte after which a program upload is abandoned.
+static const uint32_t kLoadTimeoutMs = 1000;
+
+// Milliseconds without a byte after which the rest of the line that aborted a run is no longer awaited.
+static const uint32_t kAbortTimeoutMs = 10;
+
+/**
+ * @brief Returns the length of an instruction including its opcode.
+ *
+ * @param opcode The opcode.
+ * @return The number of bytes, or 0 for an unknown opcode.
+ */
+static uint8_t instructionBytes(uint8_t opcode) {
+	switch (opcode) {
+		case SEQUENCER::HALT: case SEQUENCER::LDAC: case SEQUENCER::ADC_SCAN: return 1;
+		case SEQUENCER::EMIT: return 2;
+		case SEQUENCER::ADD_REG: case SEQUENCER::SUB_REG: case SEQUENCER::MOV: case SEQUENCER::ADC_GET:
+		case SEQUENCER::DAC_REG: return 3;
+		case SEQUENCER::JMP: case SEQUENCER::JEQ: case SEQUENCER::JNE: case SEQUENCER::JLT: case SEQUENCER::JGE: return 3;
+		case SEQUENCER::LOOP: return 4;
+		case SEQUENCER::DAC_CODE: case SEQUENCER::DELAY_US: return 5;
+		case SEQUENCER::SET: case SEQUENCER::ADD: case SEQUENCER::CMP: return 6;
+		default: return 0;
+	}
+}
+
+static int32_t immediate(const uint8_t* p) {
+	return (int32_t) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3]);
+}
+
+static uint16_t target(const uint8_t* p) {
+	return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief Returns the offset of the jump target of an instruction.
+ *
+ * @param p The instruction.
+ * @return The target offset, or 0xFFFF if the instruction does not jump.
+ */
+static uint16_t jumpTarget(const uint8_t* p) {
+	if (p[0] >= SEQUENCER::JMP && p[0] <= SEQUENCER::JGE) {return target(p + 1);}
+	if (p[0] == SEQUENCER::LOOP) {return target(p + 2);}
+	return 0xFFFF;
+}
+
+/**
+ * @brief Constructs a SEQUENCER object.
+ *
+ * @param dac The AD5791 DAC object written by the DAC instructions.
+ * @param adc The AD4115 ADC object read by ADC_SCAN.
+ */
+SEQUENCER::SEQUENCER(AD5791& dac, AD4115& adc) : dac(dac), adc(adc) {}
+
+/**
+ * @brief Checks a program before it can run.
+ *
+ * Every instruction must be complete, name existing registers and channels, and jump to the start of an instruction, so
+ * that the interpreter needs no checks of its own.
+ *
+ * @param program The program.
+ * @param n The program length in bytes.
+ * @return 0 if the program is valid, 1 otherwise.
+ */
+uint8_t SEQUENCER::validate(const uint8_t* program, uint16_t n) {
+
+	static uint8_t starts[kMaxProgramBytes / 8];
+	memset(starts, 0, sizeof(starts));
+
+	uint16_t pc = 0;
+	while (pc < n) {
+		const uint8_t* p = program + pc;
+		uint8_t length = instructionBytes(p[0]);
+		if (length == 0 || pc + length > n) {return 1;}
+
+		switch (p[0]) {
+			case SET: case ADD: case CMP: case EMIT: case LOOP:
+				if (p[1] >= kRegisters) {return 1;}
+				break;
+			case ADD_REG: case SUB_REG: case MOV:
+				if (p[1] >= kRegisters || p[2] >= kRegisters) {return 1;}
+				break;
+			case ADC_GET:
+				if (p[1] >= kRegisters || p[2] >= 16) {return 1;}
+				break;
+			case DAC_REG:
+				if (p[1] > 3 || p[2] >= kRegisters) {return 1;}
+				break;
+			case DAC_CODE:
+				if (p[1] > 3) {return 1;}
+				break;
+			default:
+				break;
+		}
+
+		starts[pc >> 3] |= 1 << (pc & 7);
+		pc += length;
+	}
+
+	for (pc = 0; pc < n; pc += instructionBytes(program[pc])) {
+		uint16_t to = jumpTarget(program + pc);
+		if (to == 0xFFFF) {continue;}
+		if (to >= n || !(starts[to >> 3] & (1 << (to & 7)))) {return 1;}
+	}
+	return 0;
+}
+
+/**
+ * @brief Uploads a program from the serial port.
+ *
+ * The program is received as raw bytes right after the command line, like a BATCH_BIN frame, and kept at the start of
+ * the arena. All n bytes are consumed even when the program is too long, so that none of them is taken for a command.
+ * The program is checked with validate() once received; a rejected program leaves no program loaded.
+ *
+ * @param n The program length in bytes.
+ * @return 0 if successful, 1 if the program is empty, too long or invalid, 2 on timeout.
+ */
+uint8_t SEQUENCER::load(uint16_t n) {
+
+	nBytes = 0;
+	uint8_t* program = arena_utils::claim(arena_utils::SEQUENCE_PROGRAM);
+
+	uint16_t received = 0;
+	uint32_t last = millis();
+
+	while (received < n) {
+		if (Serial.available()) {
+			uint8_t byte = Serial.read();
+			if (received < kMaxProgramBytes) {program[received] = byte;}
+			received++;
+			last = millis();
+		}
+		else if (millis() - last > kLoadTimeoutMs) {
+			return 2;
+		}
+	}
+
+	if (n == 0 || n > kMaxProgramBytes || validate(program, n) != 0) {return 1;}
+
+	nBytes = n;
+	return 0;
+}
+
+/**
+ * @brief Runs the loaded program.
+ *
+ * The interpreter executes the program from its first byte until HALT, the end of the program, an EMIT that finds the
+ * output full, or a byte arriving on the serial port, which is checked at every backward jump so that any loop can be
+ * stopped; that byte is discarded with the rest of its line up to '\r'. Emitted values are buffered in the arena behind
+ * the program and sent at the end, so that the serial port never delays the program. The function prints:
+ *   1. SEQ_BEGIN,nValues, followed by the emitted values, 3 bytes MSB first each.
+ *   2. An empty line and SEQ_DONE,status,instructions,elapsed_us, where status is HALT, ABORTED or OUTPUT_FULL and the
+ *      elapsed time covers the program only.
+ *
+ * @param initial The initial values of registers r0 to r(nInitial - 1); the other registers start at 0.
+ * @param nInitial The number of initial values, at most kRegisters.
+ * @return 0 if successful, 1 if no program is loaded.
+ */
+uint8_t SEQUENCER::run(const int32_t* initial, uint8_t nInitial) {
+
+	if (nBytes == 0 || arena_utils::owner() != arena_utils::SEQUENCE_PROGRAM) {return 1;}
+
+	const uint8_t* program = arena_utils::buffer();
+	uint8_t* output = arena_utils::buffer() + nBytes;
+	uint32_t capacity = (arena_utils::kBytes - nBytes) / 3;
+
+	int32_t r[kRegisters];
+	for (uint8_t i = 0; i < kRegisters; i++) {r[i] = (i < nInitial) ? initial[i] : 0;}
+	uint32_t scan[16] = {0};
+	int8_t compare = 0;
+
+	const char* status = "HALT";
+	bool aborted = false;
+	uint32_t executed = 0;
+	uint32_t emitted = 0;
+	uint16_t pc = 0;
+	uint32_t start = micros();
+
+	while (pc < nBytes) {
+		const uint8_t* p = program + pc;
+		uint16_t next = pc + instructionBytes(p[0]);
+		executed++;
+
+		switch (p[0]) {
+			case HALT: next = nBytes; break;
+			case DAC_CODE: dac.writeCode(p[1], (((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 8) | p[4]) & 0xFFFFF); break;
+			case LDAC: dac.updateAnalogOutputs(); break;
+			case ADC_SCAN: adc.conversionScan(scan); break;
+			case DELAY_US: delayMicroseconds((uint32_t) immediate(p + 1)); break;
+			case SET: r[p[1]] = immediate(p + 2); break;
+			case ADD: r[p[1]] += immediate(p + 2); break;
+			case ADD_REG: r[p[1]] += r[p[2]]; break;
+			case SUB_REG: r[p[1]] -= r[p[2]]; break;
+			case MOV: r[p[1]] = r[p[2]]; break;
+			case ADC_GET: r[p[1]] = (int32_t) scan[p[2]]; break;
+			case DAC_REG: dac.writeCode(p[1], (uint32_t) r[p[2]] & 0xFFFFF); break;
+			case EMIT:
+				if (emitted == capacity) {
+					status = "OUTPUT_FULL";
+					next = nBytes;
+					break;
+				}
+				output[3 * emitted] = (uint8_t) (r[p[1]] >> 16);
+				output[3 * emitted + 1] = (uint8_t) (r[p[1]] >> 8);
+				output[3 * emitted + 2] = (uint8_t) r[p[1]];
+				emitted++;
+				break;
+			case CMP: {
+				int32_t value = immediate(p + 2);
+				compare = (r[p[1]] < value) ? -1 : (r[p[1]] > value) ? 1 : 0;
+				break;
+			}
+			case JMP: next = target(p + 1); break;
+			case JEQ: if (compare == 0) {next = target(p + 1);} break;
+			case JNE: if (compare != 0) {next = target(p + 1);} break;
+			case JLT: if (compare < 0) {next = target(p + 1);} break;
+			case JGE: if (compare >= 0) {next = target(p + 1);} break;
+			case LOOP: if (--r[p[1]] != 0) {next = target(p + 2);} break;
+		}
+
+		if (next <= pc && Serial.available()) {
+			status = "ABORTED";
+			aborted = true;
+			break;
+		}
+		pc = next;
+	}
+
+	uint32_t elapsed = micros() - start;
+
+	//The byte that aborted the run is not the start of a command
+	if (aborted) {interface_utils::discardLine(kAbortTimeoutMs);}
+
+	Serial.print("SEQ_BEGIN,");
+	Serial.println(emitted);
+	{
+		stats_utils::ScopedTimer timer(stats_utils::SERIAL_WRITE);
+		Serial.write(output, 3 * emitted);
+	}
+	Serial.println("");
+	Serial.print("SEQ_DONE,");
+	Serial.print(status);
+	Serial.print(",");
+	Serial.print(executed);
+	Serial.print(",");
+	Serial.println(elapsed);
+	return 0;
+}
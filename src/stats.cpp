@@ -0,0 +1,179 @@
+#include "../include/stats.h"
+#include <stdint.h>
+#include <Arduino.h>
+#ifndef ARDUINO_ARCH_SAM
+#include <chrono>
+#endif
+using namespace std;
+
+namespace stats_utils {
+
+static Counter _counters[N_OPERATIONS];
+
+static const char* const _operationNames[N_OPERATIONS] = {
+	"DAC_SPI_FRAME",
+	"ADC_SPI_FRAME",
+	"DRDY_WAIT",
+	"ADC_CONVERSION",
+	"RAMP_STEP",
+	"SERIAL_WRITE"
+};
+
+/**
+ * @brief Enables the tick source and clears all counters.
+ *
+ * On the Arduino Due this turns on the trace unit and the DWT cycle counter, which are disabled after reset. On the
+ * host build std::chrono::steady_clock is always available and nothing has to be enabled.
+ */
+void begin(void) {
+#ifdef ARDUINO_ARCH_SAM
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	reset();
+}
+
+/**
+ * @brief Returns the current tick count.
+ *
+ * @return The DWT cycle counter on the Due, or steady_clock nanoseconds truncated to 32 bits on the host.
+ */
+uint32_t ticks(void) {
+#ifdef ARDUINO_ARCH_SAM
+	return DWT->CYCCNT;
+#else
+	return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * @brief Returns the number of ticks in one microsecond.
+ *
+ * @return 84 on the Due (core clock in MHz), 1000 on the host.
+ */
+uint32_t ticksPerMicrosecond(void) {
+#ifdef ARDUINO_ARCH_SAM
+	return SystemCoreClock / 1000000;
+#else
+	return 1000;
+#endif
+}
+
+/**
+ * @brief Converts an elapsed tick count to microseconds.
+ *
+ * @param elapsed The elapsed number of ticks.
+ * @return The elapsed time in microseconds.
+ */
+double ticksToMicros(uint32_t elapsed) {
+	return (double) elapsed / ticksPerMicrosecond();
+}
+
+/**
+ * @brief Returns the histogram bin for a duration.
+ *
+ * Bins are logarithmic: bin 0 holds durations under 1 us, bin b holds durations in [2^(b-1), 2^b) us and the last
+ * bin holds everything from 2^(kHistogramBins-2) us upwards.
+ *
+ * @param micros The duration in whole microseconds.
+ * @return The histogram bin index.
+ */
+uint8_t histogramBin(uint32_t micros) {
+	uint8_t bin = 0;
+	while (micros > 0 && bin < kHistogramBins - 1) {
+		micros >>= 1;
+		bin++;
+	}
+	return bin;
+}
+
+/**
+ * @brief Adds one measurement to the counter of an operation.
+ *
+ * Updates count, minimum, maximum, running total and histogram. The update is a handful of integer operations so it can
+ * be called from every SPI frame without distorting the measurement.
+ *
+ * @param op The instrumented operation.
+ * @param elapsed The duration of the operation in ticks.
+ */
+void record(Operation op, uint32_t elapsed) {
+	Counter& c = _counters[op];
+
+	if (c.count == 0 || elapsed < c.min) {c.min = elapsed;}
+	if (elapsed > c.max) {c.max = elapsed;}
+
+	c.count++;
+	c.total += elapsed;
+	c.histogram[histogramBin(elapsed / ticksPerMicrosecond())]++;
+}
+
+/**
+ * @brief Returns the counter of an operation.
+ *
+ * @param op The instrumented operation.
+ * @return A reference to the counter.
+ */
+const Counter& counter(Operation op) {
+	return _counters[op];
+}
+
+/**
+ * @brief Returns the name printed by STATS? for an operation.
+ *
+ * @param op The instrumented operation.
+ * @return The operation name.
+ */
+const char* operationName(Operation op) {
+	return _operationNames[op];
+}
+
+/**
+ * @brief Clears every counter.
+ */
+void reset(void) {
+	for (uint8_t op = 0; op < N_OPERATIONS; op++) {
+		Counter& c = _counters[op];
+		c.count = 0;
+		c.min = 0;
+		c.max = 0;
+		c.total = 0;
+		for (uint8_t bin = 0; bin < kHistogramBins; bin++) {
+			c.histogram[bin] = 0;
+		}
+	}
+}
+
+/**
+ * @brief Prints all counters to the serial port.
+ *
+ * Prints one line per operation with the format STATS,name,count,min_us,mean_us,max_us,hist_0,...,hist_15 and ends
+ * with EndOfStats. Times are in microseconds with three decimals; an operation that never ran prints zeros.
+ */
+void report(void) {
+	for (uint8_t op = 0; op < N_OPERATIONS; op++) {
+		const Counter& c = _counters[op];
+		double mean = (c.count > 0) ? ticksToMicros(1) * ((double) c.total / c.count) : 0;
+
+		Serial.print("STATS,");
+		Serial.print(_operationNames[op]);
+		Serial.print(",");
+		Serial.print(c.count);
+		Serial.print(",");
+		Serial.print(ticksToMicros(c.min), 3);
+		Serial.print(",");
+		Serial.print(mean, 3);
+		Serial.print(",");
+		Serial.print(ticksToMicros(c.max), 3);
+
+		for (uint8_t bin = 0; bin < kHistogramBins; bin++) {
+			Serial.print(",");
+			Serial.print(c.histogram[bin]);
+		}
+		Serial.println("");
+	}
+	Serial.println("EndOfStats");
+}
+
+}
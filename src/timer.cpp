@@ -0,0 +1,144 @@
+#include "../include/timer.h"
+#include "../include/stats.h"
+#include <stdint.h>
+#include <Arduino.h>
+using namespace std;
+
+namespace timer_utils {
+
+static Callback _onUpdate = 0;
+static Callback _onSample = 0;
+static volatile bool _running = false;
+
+#ifdef ARDUINO_ARCH_SAM
+
+// TC2 channel 2 counts at MCK/2
+static const uint32_t kTimerTicksPerMicrosecond = VARIANT_MCK / 2 / 1000000;
+
+/**
+ * @brief Interrupt handler of timer channel TC8.
+ *
+ * Reading the status register clears the compare flags. The RC compare (update) is handled before the RA compare
+ * (sample) in case both are pending.
+ */
+static void handleInterrupt(void) {
+	uint32_t status = TC_GetStatus(TC2, 2);
+
+	if ((status & TC_SR_CPCS) && _onUpdate) {_onUpdate();}
+	if ((status & TC_SR_CPAS) && _onSample) {_onSample();}
+}
+
+#else
+
+static uint32_t _period = 0;
+static uint32_t _offset = 0;
+static uint32_t _nextUpdate = 0;
+static uint32_t _nextSample = 0;
+static bool _samplePending = false;
+
+#endif
+
+/**
+ * @brief Starts the step timer.
+ *
+ * On the Due this enables the peripheral clock of TC8, configures the channel in waveform mode counting up to RC
+ * (period) with RA at the sample offset, enables the RC and RA compare interrupts and starts the counter. On the host
+ * build it records the schedule used by service().
+ *
+ * @param periodUs The period between update events in microseconds.
+ * @param offsetUs The delay from each update event to the sample event in microseconds, smaller than the period.
+ * @param onUpdate Called at the start of every period.
+ * @param onSample Called offsetUs after every update event.
+ * @return 0 if successful, 1 if the period or offset is invalid.
+ */
+uint8_t begin(uint32_t periodUs, uint32_t offsetUs, Callback onUpdate, Callback onSample) {
+
+	if (periodUs == 0 || offsetUs >= periodUs) {return 1;}
+
+	stop();
+	_onUpdate = onUpdate;
+	_onSample = onSample;
+
+#ifdef ARDUINO_ARCH_SAM
+	pmc_set_writeprotect(false);
+	pmc_enable_periph_clk(ID_TC8);
+
+	TC_Configure(TC2, 2, TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC | TC_CMR_TCCLKS_TIMER_CLOCK1);
+	TC_SetRC(TC2, 2, periodUs * kTimerTicksPerMicrosecond);
+	TC_SetRA(TC2, 2, (offsetUs > 0 ? offsetUs : 1) * kTimerTicksPerMicrosecond);
+
+	TC2->TC_CHANNEL[2].TC_IER = TC_IER_CPCS | TC_IER_CPAS;
+	TC2->TC_CHANNEL[2].TC_IDR = ~(TC_IER_CPCS | TC_IER_CPAS);
+
+	NVIC_ClearPendingIRQ(TC8_IRQn);
+	NVIC_EnableIRQ(TC8_IRQn);
+
+	_running = true;
+	TC_Start(TC2, 2);
+#else
+	_period = periodUs * stats_utils::ticksPerMicrosecond();
+	_offset = offsetUs * stats_utils::ticksPerMicrosecond();
+	_nextUpdate = stats_utils::ticks() + _period;
+	_samplePending = false;
+	_running = true;
+#endif
+	return 0;
+}
+
+/**
+ * @brief Stops the step timer and disables its interrupt.
+ */
+void stop(void) {
+#ifdef ARDUINO_ARCH_SAM
+	if (_running) {
+		TC_Stop(TC2, 2);
+		NVIC_DisableIRQ(TC8_IRQn);
+	}
+#endif
+	_running = false;
+}
+
+/**
+ * @brief Returns whether the step timer is running.
+ *
+ * @return True between begin() and stop().
+ */
+bool running(void) {
+	return _running;
+}
+
+/**
+ * @brief Generates due timer events on the host build.
+ *
+ * Fires the update event when its scheduled time has passed and the sample event offset later, keeping the schedule
+ * anchored to the start time. Update events missed by more than a period are dropped rather than fired late. Must be
+ * called from every loop that waits on the timer. Does nothing on the Due, where the events come from the TC8 interrupt.
+ */
+void service(void) {
+#ifndef ARDUINO_ARCH_SAM
+	if (!_running) {return;}
+
+	uint32_t now = stats_utils::ticks();
+
+	if (_samplePending && (int32_t) (now - _nextSample) >= 0) {
+		_samplePending = false;
+		if (_onSample) {_onSample();}
+	}
+	if ((int32_t) (now - _nextUpdate) >= 0) {
+		// Events that passed while nobody serviced the timer are lost, as on the Due
+		while ((int32_t) (now - (_nextUpdate + _period)) >= 0) {_nextUpdate += _period;}
+		_nextSample = _nextUpdate + _offset;
+		_nextUpdate += _period;
+		_samplePending = true;
+		if (_onUpdate) {_onUpdate();}
+	}
+#endif
+}
+
+}
+
+#ifdef ARDUINO_ARCH_SAM
+void TC8_Handler(void) {
+	timer_utils::handleInterrupt();
+}
+#endif